@@ -6,6 +6,7 @@
 #include "2D.hpp"
 #include "graphics/gl/vao.hpp"
 #include "graphics/gl/shader.hpp"
+#include "graphics/gl/uniform_block.hpp"
 #include "graphics/mesh.hpp"
 #include "model.hpp"
 #include "audio/sound.hpp"
@@ -34,11 +35,12 @@ int main()
 	window_t main_window("foton test", 1920, 1080);
 	main_window.set_clear_color(0.1f, 0.1f, 0.1f);
 	main_window.fps_counter = fps_counter_t(250ms, print_fps);
-	auto shader_with_paths = shader::shader_with_paths_t::guess_filetypes({ "resources/shaders/test2.frag", "resources/shaders/test2.vert"});
+	shader::program_cache_t program_cache; //linked binaries in shader_cache/ next to the exe, a rerun with unchanged shaders skips compiling
+	shader::shader_compiler_t shader_compiler; //programs build in the background, the first frames run before the shader is linked
+	auto shader_with_paths = shader::shader_with_paths_t::guess_filetypes({ "resources/shaders/test2.frag", "resources/shaders/test2.vert"}, shader_compiler, &program_cache);
 	auto& shader = shader_with_paths.shader();
-	std::this_thread::sleep_for(.5s);
 	GL::check_gl_errors("after shader_load");
-	shader::uniform_t<float> time_uniform = shader.get_uniform<float>("time");
+	GL::uniform_block_t<GL::frame_block_t> frame_uniforms(GL::uniform_bindings::FRAME); //every program's frame_block reads this
 	GL::check_gl_errors("before vao");
 	foton::GL::vao_t vao;
 	vao.bind().emplace_vertex_attribute<vec3f>(0, 0, 0, std::initializer_list<vec3f>{ {-.75,-.75, 0 }, {0, .75, 0}, {.75, -.75, .75} });
@@ -60,9 +62,8 @@ int main()
 			if (last_shader_reload_time + 500ms > current_time()) //Timeout on shader creation
 				return;
 			std::cout << "reloading shaders!\n";
-			shader_with_paths.reload_shader();
-			std::cout << "done!\n";
-			GL::check_gl_errors("after reloading shaders");
+			shader_with_paths.reload_async(shader_compiler);
+			last_shader_reload_time = current_time();
 		}
 		if (key == GLFW_KEY_S && action == GLFW_PRESS) {
 			//window.camera().view.position + vec3f(0, 0, -.1f);
@@ -72,8 +73,24 @@ int main()
 	std::cout << "start!"; //This gets overwritten by the fps_counter
 	camera::camera_t camera;
 	while (!main_window.should_close()) {
+		camera.recalculate();
+		frame_uniforms.data.view_mat = camera.view_matrix;
+		frame_uniforms.data.projection_mat = camera.projection_matrix;
+		frame_uniforms.data.view_projection_mat = camera.projection_matrix * camera.view_matrix;
+		frame_uniforms.data.time = std::chrono::duration<float, std::ratio<1>>(main_window.fps_counter.runtime()).count();
+		frame_uniforms.upload(); //one write for all of them
+		shader_compiler.poll();
+		try {
+			if (shader_with_paths.update()) {
+				std::cout << "shader ready!\n";
+				GL::check_gl_errors("after loading shaders");
+				GL::check_uniform_block<GL::frame_block_t>(shader.program_id(), GL::uniform_bindings::FRAME_BLOCK);
+			}
+		}
+		catch (const shader::shader_error_t& error) {
+			std::cout << "shader reload failed, keeping the old one\n" << error.what() << '\n';
+		}
 		main_window.render_with(camera);
-		time_uniform = std::chrono::duration<float, std::ratio<1>>(main_window.fps_counter.runtime()).count(); //update uniform
 		glfwPollEvents();
 	}
 }
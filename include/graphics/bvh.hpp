@@ -0,0 +1,451 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <span>
+#include <vector>
+#include "camera.hpp"
+#include "frustum_culler.hpp"
+#include "../model.hpp"
+#include "../utility/thread_pool.hpp"
+namespace foton {
+	/*
+		bounding volume hierarchy over a set of boxes, item ids are indices into the span build() was given
+
+		nodes live in one flat vector, 32 bytes each. a leaf (count != 0) owns items[first, first + count),
+		an inner node's children are the pair nodes[first], nodes[first + 1], always stored after their parent
+		splits pick the lowest surface area heuristic cost over BINS centroid bins on each axis
+
+		the top of the tree is split on the calling thread until there are a few subtrees per thread,
+		those get built in parallel into their own vectors and spliced in after
+		refit() keeps the topology and only resizes boxes, fine for things that move around a bit.
+		queries stay correct however far things move, they just get slower until the next build()
+	*/
+	struct bvh_t {
+		struct node_t {
+			model::aabb_t bounds;
+			uint32_t first = 0;
+			uint32_t count = 0; //0 for inner nodes
+			bool leaf() const {
+				return count != 0;
+			}
+		};
+		static_assert(sizeof(node_t) == 32);
+		struct hit_t {
+			uint32_t item = INVALID;
+			float distance = std::numeric_limits<float>::infinity();
+			bool hit() const {
+				return item != INVALID;
+			}
+		};
+		static constexpr uint32_t INVALID = static_cast<uint32_t>(-1);
+		static constexpr uint32_t BINS = 16;
+		static constexpr uint32_t MAX_LEAF_ITEMS = 4;
+		static constexpr uint32_t PARALLEL_MIN = 1024; //smaller ranges aren't worth a task
+		std::vector<node_t> nodes;
+		std::vector<uint32_t> items;
+
+		size_t size() const {
+			return _bounds.size();
+		}
+		void build(std::span<const model::aabb_t> boxes, thread_pool_t& pool = thread_pool_t::shared()) {
+			const uint32_t count = static_cast<uint32_t>(boxes.size());
+			_bounds.assign(boxes.begin(), boxes.end());
+			_centroids.resize(count);
+			for (uint32_t i = 0; i < count; i++)
+				_centroids[i] = _bounds[i].empty() ? vec3f::Zero() : _bounds[i].center();
+			items.resize(count);
+			std::iota(items.begin(), items.end(), 0u);
+			nodes.clear();
+			if (count == 0) {
+				_parents.clear();
+				_leaf_of.clear();
+				return;
+			}
+			nodes.push_back(make_node(0, count));
+			//top levels here, every node still a leaf afterwards is a task
+			uint32_t depth = 0;
+			while ((size_t(1) << depth) < pool.thread_count() * 4)
+				depth++;
+			std::vector<uint32_t> tasks;
+			split_nodes(nodes, 0, depth, PARALLEL_MIN, &tasks);
+			std::vector<std::vector<node_t>> subtrees(tasks.size());
+			pool.parallel_for(tasks.size(), [&](size_t t) {
+				subtrees[t].push_back(nodes[tasks[t]]);
+				split_nodes(subtrees[t], 0, UINT32_MAX, 0, nullptr);
+			});
+			for (size_t t = 0; t < tasks.size(); t++) {
+				const uint32_t base = static_cast<uint32_t>(nodes.size());
+				auto relocate = [base](node_t node) { //local index k > 0 ends up at base + k - 1
+					if (!node.leaf())
+						node.first = base + node.first - 1;
+					return node;
+				};
+				nodes[tasks[t]] = relocate(subtrees[t].front());
+				for (size_t k = 1; k < subtrees[t].size(); k++)
+					nodes.push_back(relocate(subtrees[t][k]));
+			}
+			_parents.assign(nodes.size(), INVALID);
+			_leaf_of.assign(count, INVALID);
+			for (uint32_t n = 0; n < nodes.size(); n++) {
+				if (nodes[n].leaf()) {
+					for (uint32_t i = nodes[n].first; i < nodes[n].first + nodes[n].count; i++)
+						_leaf_of[items[i]] = n;
+				}
+				else
+					_parents[nodes[n].first] = _parents[nodes[n].first + 1] = n;
+			}
+		}
+		//'changed' items take their new box from 'boxes', walks up from their leaves until a box stops changing
+		void refit(std::span<const uint32_t> changed, std::span<const model::aabb_t> boxes) {
+			for (const uint32_t item : changed)
+				_bounds[item] = boxes[item];
+			for (const uint32_t item : changed) {
+				for (uint32_t n = _leaf_of[item]; n != INVALID; n = _parents[n]) {
+					const model::aabb_t bounds = node_bounds(nodes[n]);
+					if (bounds == nodes[n].bounds)
+						break;
+					nodes[n].bounds = bounds;
+				}
+			}
+		}
+		//every box changed, children come after their parents so one backwards pass does it
+		void refit(std::span<const model::aabb_t> boxes) {
+			_bounds.assign(boxes.begin(), boxes.end());
+			for (size_t n = nodes.size(); n-- > 0;)
+				nodes[n].bounds = node_bounds(nodes[n]);
+		}
+		/*
+			writes the items whose boxes touch 'frustum' into 'visible'
+			planes a node is fully inside of aren't tested again below it, subtrees inside all of them are taken without tests,
+			items in leaves that straddle a plane get tested together through 'culler'
+		*/
+		frustum_culler_t::stats_t cull(const camera::frustum_t& frustum, std::vector<uint32_t>& visible, frustum_culler_t& culler) const {
+			visible.clear();
+			culler.clear();
+			std::vector<uint32_t> candidates;
+			struct entry_t {
+				uint32_t node;
+				uint32_t planes; //bit per plane still worth testing
+			};
+			std::vector<entry_t> stack;
+			if (!nodes.empty())
+				stack.push_back(entry_t{ 0, (1u << camera::frustum_t::count) - 1 });
+			while (!stack.empty()) {
+				const entry_t e = stack.back();
+				stack.pop_back();
+				const node_t& node = nodes[e.node];
+				if (node.bounds.empty())
+					continue;
+				const vec3f center = node.bounds.center();
+				const vec3f extent = node.bounds.extent();
+				uint32_t planes = e.planes;
+				bool outside = false;
+				for (uint32_t p = 0; p < camera::frustum_t::count && !outside; p++) {
+					if (!(planes & (1u << p)))
+						continue;
+					const vec4f& plane = frustum.planes[p];
+					const float d = plane.head<3>().dot(center) + plane.w();
+					const float r = plane.head<3>().cwiseAbs().dot(extent);
+					if (d + r < 0.f)
+						outside = true;
+					else if (d - r >= 0.f)
+						planes &= ~(1u << p);
+				}
+				if (outside)
+					continue;
+				if (planes == 0)
+					collect(e.node, visible);
+				else if (node.leaf()) {
+					for (uint32_t i = node.first; i < node.first + node.count; i++) {
+						culler.push(_bounds[items[i]].center(), _bounds[items[i]].extent());
+						candidates.push_back(items[i]);
+					}
+				}
+				else {
+					stack.push_back(entry_t{ node.first, planes });
+					stack.push_back(entry_t{ node.first + 1, planes });
+				}
+			}
+			std::vector<uint32_t> passed;
+			culler.cull(frustum, passed);
+			for (const uint32_t c : passed)
+				visible.push_back(candidates[c]);
+			frustum_culler_t::stats_t stats;
+			stats.visible = visible.size();
+			stats.culled = size() - visible.size();
+			return stats;
+		}
+		/*
+			closest item along origin + t * direction for t in [0, max_distance]
+			'hit(item, box_distance)' returns the item's real distance or infinity for a miss (box_distance if the box is enough),
+			the nearer child is visited first so most of the tree behind the first hit gets skipped
+		*/
+		template<class HitF>
+		hit_t raycast(const vec3f& origin, const vec3f& direction, float max_distance, HitF&& hit) const {
+			hit_t best;
+			best.distance = max_distance;
+			if (nodes.empty())
+				return best;
+			const vec3f inverse = direction.cwiseInverse();
+			std::vector<uint32_t> stack{ 0 };
+			while (!stack.empty()) {
+				const node_t& node = nodes[stack.back()];
+				stack.pop_back();
+				if (ray_distance(node.bounds, origin, inverse, best.distance) > best.distance)
+					continue;
+				if (node.leaf()) {
+					for (uint32_t i = node.first; i < node.first + node.count; i++) {
+						const float box_distance = ray_distance(_bounds[items[i]], origin, inverse, best.distance);
+						if (box_distance > best.distance)
+							continue;
+						const float distance = hit(items[i], box_distance);
+						if (std::isfinite(distance) && distance <= best.distance) {
+							best.item = items[i];
+							best.distance = distance;
+						}
+					}
+					continue;
+				}
+				const float left = ray_distance(nodes[node.first].bounds, origin, inverse, best.distance);
+				const float right = ray_distance(nodes[node.first + 1].bounds, origin, inverse, best.distance);
+				const bool left_first = left <= right;
+				if (std::max(left, right) <= best.distance)
+					stack.push_back(left_first ? node.first + 1 : node.first);
+				if (std::min(left, right) <= best.distance)
+					stack.push_back(left_first ? node.first : node.first + 1);
+			}
+			if (!best.hit())
+				best.distance = std::numeric_limits<float>::infinity();
+			return best;
+		}
+		hit_t raycast(const vec3f& origin, const vec3f& direction, float max_distance = std::numeric_limits<float>::infinity()) const {
+			return raycast(origin, direction, max_distance, [](uint32_t, float box_distance) { return box_distance; });
+		}
+		//appends every item whose box overlaps 'box'
+		void overlap(const model::aabb_t& box, std::vector<uint32_t>& out) const {
+			if (nodes.empty())
+				return;
+			std::vector<uint32_t> stack{ 0 };
+			while (!stack.empty()) {
+				const node_t& node = nodes[stack.back()];
+				stack.pop_back();
+				if (!node.bounds.overlaps(box))
+					continue;
+				if (node.leaf()) {
+					for (uint32_t i = node.first; i < node.first + node.count; i++) {
+						if (_bounds[items[i]].overlaps(box))
+							out.push_back(items[i]);
+					}
+				}
+				else {
+					stack.push_back(node.first);
+					stack.push_back(node.first + 1);
+				}
+			}
+		}
+		//item closest to 'point' within max_distance, 'distance(item, box_distance)' works like raycast's 'hit'
+		template<class DistanceF>
+		hit_t nearest(const vec3f& point, float max_distance, DistanceF&& distance) const {
+			hit_t best;
+			best.distance = max_distance;
+			if (nodes.empty())
+				return best;
+			std::vector<uint32_t> stack{ 0 };
+			while (!stack.empty()) {
+				const node_t& node = nodes[stack.back()];
+				stack.pop_back();
+				if (node.leaf()) {
+					for (uint32_t i = node.first; i < node.first + node.count; i++) {
+						const float box_distance = point_distance(_bounds[items[i]], point);
+						if (box_distance > best.distance)
+							continue;
+						const float d = distance(items[i], box_distance);
+						if (std::isfinite(d) && d <= best.distance) {
+							best.item = items[i];
+							best.distance = d;
+						}
+					}
+					continue;
+				}
+				const float left = point_distance(nodes[node.first].bounds, point);
+				const float right = point_distance(nodes[node.first + 1].bounds, point);
+				const bool left_first = left <= right;
+				if (std::max(left, right) <= best.distance)
+					stack.push_back(left_first ? node.first + 1 : node.first);
+				if (std::min(left, right) <= best.distance)
+					stack.push_back(left_first ? node.first : node.first + 1);
+			}
+			if (!best.hit())
+				best.distance = std::numeric_limits<float>::infinity();
+			return best;
+		}
+		hit_t nearest(const vec3f& point, float max_distance = std::numeric_limits<float>::infinity()) const {
+			return nearest(point, max_distance, [](uint32_t, float box_distance) { return box_distance; });
+		}
+		//entry distance of the ray into 'box' (0 when it starts inside), infinity on a miss or past 'max_distance'
+		static float ray_distance(const model::aabb_t& box, const vec3f& origin, const vec3f& inverse_direction, float max_distance) {
+			if (box.empty())
+				return std::numeric_limits<float>::infinity();
+			const vec3f t0 = (box.min - origin).cwiseProduct(inverse_direction);
+			const vec3f t1 = (box.max - origin).cwiseProduct(inverse_direction);
+			const float enter = std::max(t0.cwiseMin(t1).maxCoeff(), 0.f);
+			const float exit = std::min(t0.cwiseMax(t1).minCoeff(), max_distance);
+			return enter <= exit ? enter : std::numeric_limits<float>::infinity();
+		}
+		static float point_distance(const model::aabb_t& box, const vec3f& point) {
+			if (box.empty())
+				return std::numeric_limits<float>::infinity();
+			return (point - point.cwiseMax(box.min).cwiseMin(box.max)).norm();
+		}
+	private:
+		void collect(uint32_t root, std::vector<uint32_t>& out) const {
+			std::vector<uint32_t> stack{ root };
+			while (!stack.empty()) {
+				const node_t& node = nodes[stack.back()];
+				stack.pop_back();
+				if (node.leaf()) {
+					for (uint32_t i = node.first; i < node.first + node.count; i++) {
+						if (!_bounds[items[i]].empty())
+							out.push_back(items[i]);
+					}
+				}
+				else {
+					stack.push_back(node.first);
+					stack.push_back(node.first + 1);
+				}
+			}
+		}
+		model::aabb_t range_bounds(uint32_t begin, uint32_t end) const {
+			model::aabb_t out;
+			for (uint32_t i = begin; i < end; i++)
+				out.add(_bounds[items[i]]);
+			return out;
+		}
+		node_t make_node(uint32_t begin, uint32_t end) const {
+			node_t out;
+			out.bounds = range_bounds(begin, end);
+			out.first = begin;
+			out.count = end - begin;
+			return out;
+		}
+		model::aabb_t node_bounds(const node_t& node) const {
+			if (node.leaf())
+				return range_bounds(node.first, node.first + node.count);
+			model::aabb_t out = nodes[node.first].bounds;
+			out.add(nodes[node.first + 1].bounds);
+			return out;
+		}
+		/*
+			splits leaves of 'tree' starting at 'root' (index into 'tree') down to 'max_depth' levels, leaves with fewer
+			than 'min_items' stay whole. with 'tasks' every leaf that could still be split gets listed there instead
+		*/
+		void split_nodes(std::vector<node_t>& tree, uint32_t root, uint32_t max_depth, uint32_t min_items, std::vector<uint32_t>* tasks) {
+			struct entry_t {
+				uint32_t node;
+				uint32_t depth;
+			};
+			std::vector<entry_t> stack{ entry_t{ root, 0 } };
+			while (!stack.empty()) {
+				const entry_t e = stack.back();
+				stack.pop_back();
+				const uint32_t begin = tree[e.node].first;
+				const uint32_t end = begin + tree[e.node].count;
+				if (e.depth >= max_depth || end - begin < min_items) {
+					if (tasks)
+						tasks->push_back(e.node);
+					continue;
+				}
+				uint32_t mid;
+				if (!split(begin, end, tree[e.node].bounds, mid))
+					continue;
+				const uint32_t left = static_cast<uint32_t>(tree.size());
+				tree.push_back(make_node(begin, mid));
+				tree.push_back(make_node(mid, end));
+				tree[e.node].first = left;
+				tree[e.node].count = 0;
+				stack.push_back(entry_t{ left + 1, e.depth + 1 });
+				stack.push_back(entry_t{ left, e.depth + 1 });
+			}
+		}
+		//partitions items[begin, end) around 'mid', false when a leaf is cheaper than any split
+		bool split(uint32_t begin, uint32_t end, const model::aabb_t& bounds, uint32_t& mid) {
+			const uint32_t count = end - begin;
+			if (count <= 1)
+				return false;
+			model::aabb_t centroid_bounds;
+			for (uint32_t i = begin; i < end; i++)
+				centroid_bounds.add(_centroids[items[i]]);
+			struct bin_t {
+				model::aabb_t bounds;
+				uint32_t count = 0;
+			};
+			float best_cost = std::numeric_limits<float>::infinity();
+			int best_axis = -1;
+			uint32_t best_bin = 0;
+			for (int axis = 0; axis < 3; axis++) {
+				const float low = centroid_bounds.min[axis];
+				const float extent = centroid_bounds.max[axis] - low;
+				if (!(extent > 0.f))
+					continue;
+				const float scale = BINS / extent;
+				bin_t bins[BINS];
+				for (uint32_t i = begin; i < end; i++) {
+					bin_t& bin = bins[bin_index(_centroids[items[i]][axis], low, scale)];
+					bin.bounds.add(_bounds[items[i]]);
+					bin.count++;
+				}
+				float right_area[BINS - 1];
+				uint32_t right_count[BINS - 1];
+				model::aabb_t right;
+				uint32_t right_items = 0;
+				for (uint32_t b = BINS - 1; b > 0; b--) {
+					right.add(bins[b].bounds);
+					right_items += bins[b].count;
+					right_area[b - 1] = right.area();
+					right_count[b - 1] = right_items;
+				}
+				model::aabb_t left;
+				uint32_t left_items = 0;
+				for (uint32_t b = 0; b < BINS - 1; b++) {
+					left.add(bins[b].bounds);
+					left_items += bins[b].count;
+					if (left_items == 0 || right_count[b] == 0)
+						continue;
+					const float cost = left.area() * left_items + right_area[b] * right_count[b];
+					if (cost < best_cost) {
+						best_cost = cost;
+						best_axis = axis;
+						best_bin = b;
+					}
+				}
+			}
+			if (best_axis < 0) { //every centroid in the same spot, nothing to sort by
+				if (count <= MAX_LEAF_ITEMS)
+					return false;
+				mid = begin + count / 2;
+				return true;
+			}
+			//a traversal step costs about as much as testing one item
+			const float parent_area = bounds.area();
+			if (count <= MAX_LEAF_ITEMS && parent_area + best_cost >= parent_area * count)
+				return false;
+			const float low = centroid_bounds.min[best_axis];
+			const float scale = BINS / (centroid_bounds.max[best_axis] - low);
+			const auto middle = std::partition(items.begin() + begin, items.begin() + end, [&](uint32_t item) {
+				return bin_index(_centroids[item][best_axis], low, scale) <= best_bin;
+			});
+			mid = static_cast<uint32_t>(middle - items.begin());
+			return true;
+		}
+		static uint32_t bin_index(float value, float low, float scale) {
+			return std::min(static_cast<uint32_t>((value - low) * scale), BINS - 1);
+		}
+		std::vector<model::aabb_t> _bounds; //by item id
+		std::vector<vec3f> _centroids; //by item id, only used while building
+		std::vector<uint32_t> _parents; //by node, INVALID for the root
+		std::vector<uint32_t> _leaf_of; //by item id
+	};
+}
@@ -18,7 +18,7 @@ namespace foton {
 			}
 			mat4f as_mat() const {
 				//Thank you eigen for reference
-				mat4f mat;
+				mat4f mat = mat4f::Zero();
 				float theta = 0.5f * fov_vertical;
 				float r = range();
 				float invtan = 1.f / tan(theta);
@@ -41,6 +41,44 @@ namespace foton {
 				return mat4f(mat.matrix());
 			}
 		};
+		/*
+			the 6 planes of a view projection matrix (Gribb & Hartmann), normals point inwards and are normalized
+			so plane.dot(point, 1) is the signed distance
+		*/
+		struct frustum_t {
+			enum side_t {
+				left, right, bottom, top, front, back, count //front/back are near/far, windows.h eats those names
+			};
+			vec4f planes[count];
+			static frustum_t from_matrix(const mat4f& m) {
+				frustum_t out;
+				out.planes[left] = m.row(3) + m.row(0);
+				out.planes[right] = m.row(3) - m.row(0);
+				out.planes[bottom] = m.row(3) + m.row(1);
+				out.planes[top] = m.row(3) - m.row(1);
+				out.planes[front] = m.row(3) + m.row(2);
+				out.planes[back] = m.row(3) - m.row(2);
+				for (vec4f& plane : out.planes)
+					plane /= plane.head<3>().norm();
+				return out;
+			}
+			//moves the planes into the space 'world_from_local' maps from, only rigid + uniform scale keeps distances meaningful
+			frustum_t to_local(const mat4f& world_from_local) const {
+				frustum_t out;
+				for (size_t i = 0; i < count; i++) {
+					out.planes[i] = world_from_local.transpose() * planes[i];
+					out.planes[i] /= out.planes[i].head<3>().norm();
+				}
+				return out;
+			}
+			bool intersects_sphere(const vec3f& center, float radius) const {
+				for (const vec4f& plane : planes) {
+					if (plane.head<3>().dot(center) + plane.w() < -radius)
+						return false;
+				}
+				return true;
+			}
+		};
 		struct camera_t {
 			struct camera_bind_t : GL::fbo_t::fbo_bind_t {
 				camera_bind_t(camera_t& camera_parent, GL::fbo_t::fbo_bind_t&& bind) :
@@ -66,6 +104,10 @@ namespace foton {
 				view_matrix = view.as_mat();
 				projection_matrix = projection.as_mat();
 			}
+			//uses the matrices from the last recalculate()
+			frustum_t frustum() const {
+				return frustum_t::from_matrix(projection_matrix * view_matrix);
+			}
 			void apply_viewport() {
 				viewport.apply();
 			}
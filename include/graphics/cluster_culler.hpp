@@ -0,0 +1,147 @@
+#pragma once
+#include <span>
+#include <vector>
+#include "camera.hpp"
+#include "gl/indirect.hpp"
+#include "../model/meshlet.hpp"
+#include "../utility/thread_pool.hpp"
+namespace foton {
+	/*
+		CPU side meshlet culling, frustum (bounding sphere) and backface (normal cone)
+
+		every instance gets culled in its own model space (the frustum and camera get moved into it)
+		so meshlet bounds never need transforming, instances are split across the thread pool
+		the result is either glMultiDrawElementsIndirect commands into the instance's existing ebo or compacted index lists
+	*/
+	struct cluster_culler_t {
+		using command_t = GL::draw_elements_indirect_command_t;
+		struct instance_t {
+			const model::meshlet::meshlets_t* meshlets;
+			std::span<const model::index_t> indices; //the model's indices after meshlet::build, only cull_to_indices reads them
+			mat4f model_matrix = mat4f::Identity(); //rigid + uniform scale
+			GLuint first_index = 0; //where the model's indices start in the ebo
+			GLint base_vertex = 0;
+			GLuint base_instance = 0;
+		};
+		struct stats_t {
+			size_t instances_culled = 0; //whole instance outside the frustum
+			size_t meshlets_tested = 0;
+			size_t frustum_culled = 0;
+			size_t cone_culled = 0;
+			size_t visible_meshlets = 0;
+			size_t visible_triangles = 0;
+			stats_t& operator+=(const stats_t& o) {
+				instances_culled += o.instances_culled;
+				meshlets_tested += o.meshlets_tested;
+				frustum_culled += o.frustum_culled;
+				cone_culled += o.cone_culled;
+				visible_meshlets += o.visible_meshlets;
+				visible_triangles += o.visible_triangles;
+				return *this;
+			}
+		};
+		bool frustum_culling = true;
+		bool cone_culling = true;
+		stats_t stats; //from the last cull
+
+		explicit cluster_culler_t(thread_pool_t& pool = thread_pool_t::shared()) : _pool(&pool) {}
+
+		/*
+			one command per run of consecutive visible meshlets, instance i's commands are
+			[command_offsets[i], command_offsets[i + 1]) if 'command_offsets' is given
+		*/
+		void cull_to_commands(std::span<const instance_t> instances, const camera::frustum_t& frustum, const vec3f& camera_position,
+			std::vector<command_t>& commands, std::vector<uint32_t>* command_offsets = nullptr) {
+			_prepare(instances.size());
+			_pool->parallel_for(instances.size(), [&](size_t i) {
+				std::vector<command_t>& out = _commands[i];
+				out.clear();
+				const instance_t& instance = instances[i];
+				_stats[i] = _cull(instance, frustum, camera_position, [&](const model::meshlet::meshlet_t& meshlet) {
+					const GLuint first = instance.first_index + meshlet.first_index;
+					if (!out.empty() && out.back().first_index + out.back().count == first)
+						out.back().count += meshlet.index_count();
+					else
+						out.push_back(command_t{ meshlet.index_count(), 1, first, instance.base_vertex, instance.base_instance });
+				});
+			});
+			const std::vector<size_t> offsets = _gather_stats_and_offsets(_commands);
+			commands.resize(offsets.back());
+			_pool->parallel_for(instances.size(), [&](size_t i) {
+				std::copy(_commands[i].begin(), _commands[i].end(), commands.begin() + offsets[i]);
+			});
+			if (command_offsets)
+				command_offsets->assign(offsets.begin(), offsets.end());
+		}
+		void cull_to_commands(std::span<const instance_t> instances, const camera::camera_t& camera,
+			std::vector<command_t>& commands, std::vector<uint32_t>* command_offsets = nullptr) {
+			cull_to_commands(instances, camera.frustum(), camera.view.position, commands, command_offsets);
+		}
+		//visible triangles of every instance copied into indices[i], for drivers without multi draw indirect
+		void cull_to_indices(std::span<const instance_t> instances, const camera::frustum_t& frustum, const vec3f& camera_position,
+			std::vector<std::vector<model::index_t>>& indices) {
+			_prepare(instances.size());
+			indices.resize(instances.size());
+			_pool->parallel_for(instances.size(), [&](size_t i) {
+				std::vector<model::index_t>& out = indices[i];
+				out.clear();
+				const instance_t& instance = instances[i];
+				_stats[i] = _cull(instance, frustum, camera_position, [&](const model::meshlet::meshlet_t& meshlet) {
+					const auto first = instance.indices.begin() + meshlet.first_index;
+					out.insert(out.end(), first, first + meshlet.index_count());
+				});
+			});
+			_gather_stats_and_offsets(indices);
+		}
+		void cull_to_indices(std::span<const instance_t> instances, const camera::camera_t& camera,
+			std::vector<std::vector<model::index_t>>& indices) {
+			cull_to_indices(instances, camera.frustum(), camera.view.position, indices);
+		}
+	private:
+		template<class F>
+		stats_t _cull(const instance_t& instance, const camera::frustum_t& world_frustum, const vec3f& camera_position, F&& visible) const {
+			stats_t out;
+			const model::meshlet::meshlets_t& meshlets = *instance.meshlets;
+			const camera::frustum_t frustum = world_frustum.to_local(instance.model_matrix);
+			if (frustum_culling && !frustum.intersects_sphere(meshlets.center, meshlets.radius)) {
+				out.instances_culled = 1;
+				return out;
+			}
+			const vec3f local_camera = (instance.model_matrix.inverse() * camera_position.homogeneous()).head<3>();
+			for (const model::meshlet::meshlet_t& meshlet : meshlets.meshlets) {
+				out.meshlets_tested++;
+				if (frustum_culling && !frustum.intersects_sphere(meshlet.bounds.center, meshlet.bounds.radius)) {
+					out.frustum_culled++;
+					continue;
+				}
+				if (cone_culling && meshlet.bounds.backfacing_from(local_camera)) {
+					out.cone_culled++;
+					continue;
+				}
+				out.visible_meshlets++;
+				out.visible_triangles += meshlet.triangle_count;
+				visible(meshlet);
+			}
+			return out;
+		}
+		void _prepare(size_t instance_count) {
+			_stats.assign(instance_count, stats_t{});
+			if (_commands.size() < instance_count)
+				_commands.resize(instance_count);
+		}
+		//sums the per instance stats, returns where every instance's output starts when concatenated
+		template<class ListsT>
+		std::vector<size_t> _gather_stats_and_offsets(const ListsT& lists) {
+			stats = {};
+			std::vector<size_t> offsets(_stats.size() + 1, 0);
+			for (size_t i = 0; i < _stats.size(); i++) {
+				stats += _stats[i];
+				offsets[i + 1] = offsets[i] + lists[i].size();
+			}
+			return offsets;
+		}
+		thread_pool_t* _pool;
+		std::vector<stats_t> _stats;
+		std::vector<std::vector<command_t>> _commands; //per instance, kept around for their capacity
+	};
+}
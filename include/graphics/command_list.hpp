@@ -0,0 +1,74 @@
+#pragma once
+#include <algorithm>
+#include <vector>
+#include "render_queue.hpp"
+#include "../utility/thread_pool.hpp"
+namespace foton {
+	/*
+		draws recorded by one thread without touching GL
+
+		a worker fills a command_list_t (matrices, culling, keys all happen here),
+		the context thread later appends every list into a render_queue_t and submits it
+		recording never locks anything, only submit() does
+	*/
+	struct command_list_t {
+		using draw_t = render_queue_t::draw_t;
+		void clear() {
+			_keys.clear();
+			_draws.clear();
+		}
+		size_t size() const {
+			return _draws.size();
+		}
+		//same as render_queue_t::push
+		void push(const draw_t& draw, float depth, bool translucent = false) {
+			_keys.push_back(render_queue_t::make_key(draw, depth, translucent));
+			_draws.push_back(draw);
+		}
+		void append_to(render_queue_t& queue) const {
+			for (size_t i = 0; i < _draws.size(); i++)
+				queue.push_keyed(_keys[i], _draws[i]);
+		}
+	private:
+		std::vector<uint64_t> _keys;
+		std::vector<draw_t> _draws;
+	};
+	/*
+		records 'count' items across the thread pool, one command list per chunk of items
+
+		lists get appended in chunk order and the queue's sort is stable, so the submitted frame is the same
+		no matter which thread recorded what. the lists are kept between frames for their capacity
+	*/
+	struct parallel_recorder_t {
+		static constexpr size_t CHUNKS_PER_THREAD = 4; //some slack so uneven items still balance
+		explicit parallel_recorder_t(thread_pool_t& pool = thread_pool_t::shared()) : _pool(&pool) {}
+		//calls record(list, i) for every i in [0, count), from any thread
+		template<class F>
+		void record(size_t count, F&& record) {
+			const size_t chunks = std::min(count, _pool->thread_count() * CHUNKS_PER_THREAD);
+			if (_lists.size() < chunks)
+				_lists.resize(chunks);
+			_used = chunks;
+			_pool->parallel_for(chunks, [&](size_t chunk) {
+				command_list_t& list = _lists[chunk];
+				list.clear();
+				const size_t end = count * (chunk + 1) / chunks;
+				for (size_t i = count * chunk / chunks; i < end; i++)
+					record(list, i);
+			});
+		}
+		//context thread only
+		void append_to(render_queue_t& queue) const {
+			size_t total = queue.size();
+			for (size_t i = 0; i < _used; i++)
+				total += _lists[i].size();
+			queue.reserve(total);
+			for (size_t i = 0; i < _used; i++)
+				_lists[i].append_to(queue);
+		}
+	private:
+		thread_pool_t* _pool;
+		std::vector<command_list_t> _lists;
+		size_t _used = 0;
+	};
+}
@@ -0,0 +1,128 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "camera.hpp"
+#include "../model.hpp"
+#if defined(__AVX__)
+#include <immintrin.h>
+#define FOTON_CULL_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <xmmintrin.h>
+#define FOTON_CULL_SSE
+#endif
+namespace foton {
+	/*
+		world space AABBs against the 6 frustum planes, many boxes per instruction
+
+		boxes are kept as SoA (center x/y/z, extent x/y/z) so one register holds the same component of 4 (SSE) or 8 (AVX) boxes
+		a box is outside when for some plane  dot(n, center) + d + dot(|n|, extent) < 0
+		which is exact for the plane but conservative for the frustum (boxes near a corner can pass)
+	*/
+	struct frustum_culler_t {
+		struct stats_t {
+			size_t visible = 0;
+			size_t culled = 0;
+		};
+		stats_t stats; //from the last cull()
+
+		void clear() {
+			_center[0].clear(); _center[1].clear(); _center[2].clear();
+			_extent[0].clear(); _extent[1].clear(); _extent[2].clear();
+		}
+		size_t size() const {
+			return _center[0].size();
+		}
+		void reserve(size_t count) {
+			for (int axis = 0; axis < 3; axis++) {
+				_center[axis].reserve(count + LANES);
+				_extent[axis].reserve(count + LANES);
+			}
+		}
+		void push(const vec3f& center, const vec3f& extent) {
+			for (int axis = 0; axis < 3; axis++) {
+				_center[axis].push_back(center[axis]);
+				_extent[axis].push_back(extent[axis]);
+			}
+		}
+		//'local' box moved by a rigid transform, the result is the world box around the rotated box
+		void push(const model::aabb_t& local, const mat3f& rotation, const vec3f& translation) {
+			push(rotation * local.center() + translation, rotation.cwiseAbs() * local.extent());
+		}
+		//writes the indices (in push order) of every box that's at least partly inside 'frustum'
+		void cull(const camera::frustum_t& frustum, std::vector<uint32_t>& visible) {
+			visible.clear();
+			const size_t count = size();
+			const size_t padded = (count + LANES - 1) / LANES * LANES;
+			for (int axis = 0; axis < 3; axis++) { //pad with empty boxes at infinity so the last block needs no tail loop
+				_center[axis].resize(padded, -std::numeric_limits<float>::infinity());
+				_extent[axis].resize(padded, 0.f);
+			}
+			size_t i = 0;
+#if defined(FOTON_CULL_AVX)
+			for (; i < padded; i += 8) {
+				__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+				const __m256 cx = _mm256_loadu_ps(&_center[0][i]), cy = _mm256_loadu_ps(&_center[1][i]), cz = _mm256_loadu_ps(&_center[2][i]);
+				const __m256 ex = _mm256_loadu_ps(&_extent[0][i]), ey = _mm256_loadu_ps(&_extent[1][i]), ez = _mm256_loadu_ps(&_extent[2][i]);
+				for (const vec4f& plane : frustum.planes) {
+					const __m256 nx = _mm256_set1_ps(plane.x()), ny = _mm256_set1_ps(plane.y()), nz = _mm256_set1_ps(plane.z());
+					const __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, cx), _mm256_mul_ps(ny, cy)), _mm256_add_ps(_mm256_mul_ps(nz, cz), _mm256_set1_ps(plane.w())));
+					const __m256 r = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(std::abs(plane.x())), ex),
+						_mm256_mul_ps(_mm256_set1_ps(std::abs(plane.y())), ey)), _mm256_mul_ps(_mm256_set1_ps(std::abs(plane.z())), ez));
+					inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(d, r), _mm256_setzero_ps(), _CMP_GE_OQ));
+				}
+				emit(static_cast<uint32_t>(_mm256_movemask_ps(inside)), i, count, visible);
+			}
+#elif defined(FOTON_CULL_SSE)
+			for (; i < padded; i += 4) {
+				__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+				const __m128 cx = _mm_loadu_ps(&_center[0][i]), cy = _mm_loadu_ps(&_center[1][i]), cz = _mm_loadu_ps(&_center[2][i]);
+				const __m128 ex = _mm_loadu_ps(&_extent[0][i]), ey = _mm_loadu_ps(&_extent[1][i]), ez = _mm_loadu_ps(&_extent[2][i]);
+				for (const vec4f& plane : frustum.planes) {
+					const __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x()), cx), _mm_mul_ps(_mm_set1_ps(plane.y()), cy)),
+						_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z()), cz), _mm_set1_ps(plane.w())));
+					const __m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(std::abs(plane.x())), ex),
+						_mm_mul_ps(_mm_set1_ps(std::abs(plane.y())), ey)), _mm_mul_ps(_mm_set1_ps(std::abs(plane.z())), ez));
+					inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(d, r), _mm_setzero_ps()));
+				}
+				emit(static_cast<uint32_t>(_mm_movemask_ps(inside)), i, count, visible);
+			}
+#else
+			for (; i < padded; i++) {
+				const vec3f center(_center[0][i], _center[1][i], _center[2][i]);
+				const vec3f extent(_extent[0][i], _extent[1][i], _extent[2][i]);
+				bool inside = true;
+				for (const vec4f& plane : frustum.planes)
+					inside = inside && plane.head<3>().dot(center) + plane.w() + plane.head<3>().cwiseAbs().dot(extent) >= 0.f;
+				emit(inside ? 1u : 0u, i, count, visible);
+			}
+#endif
+			for (int axis = 0; axis < 3; axis++) {
+				_center[axis].resize(count);
+				_extent[axis].resize(count);
+			}
+			stats.visible = visible.size();
+			stats.culled = count - visible.size();
+		}
+	private:
+#if defined(FOTON_CULL_AVX)
+		static constexpr size_t LANES = 8;
+#elif defined(FOTON_CULL_SSE)
+		static constexpr size_t LANES = 4;
+#else
+		static constexpr size_t LANES = 1;
+#endif
+		static void emit(uint32_t mask, size_t first, size_t count, std::vector<uint32_t>& visible) {
+			for (; mask != 0; mask &= mask - 1) {
+				size_t lane = 0;
+				while (!(mask & (1u << lane)))
+					lane++;
+				if (first + lane < count)
+					visible.push_back(static_cast<uint32_t>(first + lane));
+			}
+		}
+		std::vector<float> _center[3];
+		std::vector<float> _extent[3];
+	};
+}
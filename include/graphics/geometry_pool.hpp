@@ -0,0 +1,231 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+#include "gl/indirect.hpp"
+#include "gl/ring_buffer.hpp"
+#include "gl/shader.hpp"
+#include "gl/vao.hpp"
+#include "gl/vbo.hpp"
+#include "gl/vertex_format.hpp"
+#include "../model.hpp"
+#include "../model/layout.hpp"
+#include "../utility/range_allocator.hpp"
+namespace foton {
+	/*
+		static meshes suballocated out of a few big vertex and index buffers, so a whole scene draws with a handful of
+		glMultiDrawElementsIndirect calls instead of a vao bind and a draw per mesh
+
+		a page is one vao with one vbo of vertex_t and one uint32_t ebo, indices stay relative to their mesh
+		(base_vertex adds the offset). a model goes into the first page with room, a new page gets made when none has any
+
+		per frame: push() every visible mesh with its program and transform, submit() sorts the draws by program and page,
+		uploads all commands and transforms once and issues one multi draw per (program, page)
+		the transform reaches the shader as the per instance 'in mat4 instance_transform' (like render_queue_t's instancing),
+		every command's base_instance points at its own
+	*/
+	struct geometry_pool_t {
+		struct geometry_pool_error_t : std::runtime_error {
+			geometry_pool_error_t(const char* what) : std::runtime_error(what) {}
+		};
+		using handle_t = uint32_t;
+		static constexpr handle_t INVALID = static_cast<handle_t>(-1);
+		//where a model lives, offsets are in vertices/indices of its page
+		struct allocation_t {
+			uint32_t page = INVALID;
+			uint32_t first_vertex = 0;
+			uint32_t vertex_count = 0;
+			uint32_t first_index = 0;
+			uint32_t index_count = 0;
+		};
+		struct stats_t {
+			size_t draws = 0;
+			size_t multi_draws = 0; //GL calls those draws went out in
+		};
+		stats_t stats; //from the last submit()
+		GL::ring_buffer_t* stream = nullptr; //same as render_queue_t::stream, only the transforms go there
+
+		//no GL work until the first add()
+		explicit geometry_pool_t(uint32_t vertices_per_page = 1 << 20, uint32_t indices_per_page = 3 << 20)
+			: _vertices_per_page(vertices_per_page), _indices_per_page(indices_per_page) {}
+		geometry_pool_t(const geometry_pool_t&) = delete;
+		geometry_pool_t& operator=(const geometry_pool_t&) = delete;
+
+		handle_t add(const model::model_t& model) {
+			const std::vector<vertex_t> vertices = model::interleave(model);
+			const uint32_t vertex_count = static_cast<uint32_t>(vertices.size());
+			const uint32_t index_count = static_cast<uint32_t>(model.indices.size());
+			if (vertex_count == 0 || index_count == 0)
+				throw geometry_pool_error_t("empty model");
+			if (vertex_count > _vertices_per_page || index_count > _indices_per_page)
+				throw geometry_pool_error_t("model is bigger than a geometry pool page");
+			allocation_t a;
+			a.vertex_count = vertex_count;
+			a.index_count = index_count;
+			for (uint32_t p = 0; p < _pages.size() && a.page == INVALID; p++) {
+				if (try_allocate(*_pages[p], a))
+					a.page = p;
+			}
+			if (a.page == INVALID) {
+				_pages.push_back(std::make_unique<page_t>(_vertices_per_page, _indices_per_page));
+				if (!try_allocate(*_pages.back(), a))
+					throw geometry_pool_error_t("empty geometry pool page can't fit the model");
+				a.page = static_cast<uint32_t>(_pages.size() - 1);
+			}
+			page_t& page = *_pages[a.page];
+			page.vertices->upload_sub(vertices.data(), static_cast<GLsizei>(vertex_count), a.first_vertex);
+			{
+				auto bind = page.vao.bind();
+				bind.upload_indices(model.indices.data(), static_cast<GLsizei>(index_count), a.first_index);
+			}
+			GL::check_gl_errors("after geometry_pool_t::add");
+			handle_t handle;
+			if (_free_handles.empty()) {
+				handle = static_cast<handle_t>(_allocations.size());
+				_allocations.push_back(a);
+			}
+			else {
+				handle = _free_handles.back();
+				_free_handles.pop_back();
+				_allocations[handle] = a;
+			}
+			return handle;
+		}
+		//the space gets reused by later add()s, don't push() the handle after this
+		void remove(handle_t handle) {
+			allocation_t& a = _allocations[handle];
+			if (a.page == INVALID)
+				return;
+			_pages[a.page]->vertex_space.free(a.first_vertex, a.vertex_count);
+			_pages[a.page]->index_space.free(a.first_index, a.index_count);
+			a = allocation_t{};
+			_free_handles.push_back(handle);
+		}
+		const allocation_t& allocation(handle_t handle) const {
+			return _allocations[handle];
+		}
+		size_t page_count() const {
+			return _pages.size();
+		}
+
+		void clear_draws() {
+			_draws.clear();
+		}
+		//'instance_location' is the program's instance_transform attribute
+		void push(handle_t mesh, GLuint program, GLint instance_location, const mat4f& transform) {
+			const allocation_t& a = _allocations[mesh];
+			draw_t draw;
+			draw.key = (uint64_t(program) << 32) | a.page;
+			draw.instance_location = instance_location;
+			draw.command = command_t{ a.index_count, 1, a.first_index, static_cast<GLint>(a.first_vertex), 0 };
+			draw.transform = GL::instance_matrix_t::from(transform);
+			_draws.push_back(draw);
+		}
+		//draws everything pushed since clear_draws(), unbinds program and vao afterwards only when state_cache_t::UNBIND_ON_EXIT
+		void submit() {
+			stats = {};
+			stats.draws = _draws.size();
+			if (_draws.empty())
+				return;
+			std::stable_sort(_draws.begin(), _draws.end(), [](const draw_t& a, const draw_t& b) {
+				return a.key < b.key;
+			});
+			_commands.resize(_draws.size());
+			_instances.resize(_draws.size());
+			for (size_t i = 0; i < _draws.size(); i++) {
+				_commands[i] = _draws[i].command;
+				_commands[i].base_instance = static_cast<GLuint>(i);
+				_instances[i] = _draws[i].transform;
+			}
+			if (!_indirect)
+				_indirect.emplace();
+			_indirect->upload(_commands.data(), static_cast<GLsizei>(_commands.size()), GL_STREAM_DRAW);
+			GLuint instance_source = 0;
+			size_t instance_offset = 0;
+			if (stream) {
+				if (const auto allocation = stream->push<GL::instance_matrix_t>(_instances)) {
+					instance_source = stream->buffer_id();
+					instance_offset = static_cast<size_t>(allocation.offset);
+				}
+			}
+			if (instance_source == 0) {
+				if (!_instance_buffer)
+					_instance_buffer.emplace();
+				_instance_buffer->upload(_instances.data(), static_cast<GLsizei>(_instances.size()), GL_STREAM_DRAW);
+				instance_source = _instance_buffer->buffer_id();
+			}
+			std::scoped_lock locks(shader::shader_t::shader_bind_t::mutex(), GL::vao_t::vao_bind_t::_mutex);
+			GL::state_cache_t& state = GL::state_cache_t::current();
+			GLuint program = 0;
+			for (size_t first = 0; first < _draws.size();) {
+				size_t end = first + 1;
+				while (end < _draws.size() && _draws[end].key == _draws[first].key)
+					end++;
+				const GLuint group_program = static_cast<GLuint>(_draws[first].key >> 32);
+				if (first == 0 || group_program != program) {
+					state.use_program(group_program);
+					program = group_program;
+				}
+				state.bind_vertex_array(_pages[_draws[first].key & 0xffffffff]->vao.id());
+				if (_draws[first].instance_location >= 0) {
+					std::lock_guard<thread_mutex_t> lock(GL::buffer_locks::vertex_attributes);
+					state.bind_buffer(GL_ARRAY_BUFFER, instance_source);
+					GL::instance_matrix_attributes(_draws[first].instance_location, instance_offset);
+					state.unbind_buffer(GL_ARRAY_BUFFER);
+				}
+				_indirect->multi_draw_elements(GL_TRIANGLES, GL_UNSIGNED_INT, static_cast<GLsizei>(end - first), first);
+				stats.multi_draws++;
+				first = end;
+			}
+			if (GL::state_cache_t::UNBIND_ON_EXIT) {
+				state.bind_vertex_array(0);
+				state.use_program(0);
+			}
+			GL::check_gl_errors("after geometry_pool_t::submit");
+		}
+	private:
+		using command_t = GL::draw_elements_indirect_command_t;
+		struct page_t {
+			GL::vao_t vao;
+			GL::vbo_t<vertex_t>* vertices;
+			range_allocator_t vertex_space;
+			range_allocator_t index_space;
+			page_t(uint32_t vertex_capacity, uint32_t index_capacity) : vertex_space(vertex_capacity), index_space(index_capacity) {
+				auto bind = vao.bind();
+				vertices = &bind.emplace_vertices<vertex_t>(nullptr, static_cast<GLsizei>(vertex_capacity));
+				bind.emplace_index_storage<uint32_t>(static_cast<GLsizei>(index_capacity));
+			}
+		};
+		struct draw_t {
+			uint64_t key; //program, page
+			GLint instance_location;
+			command_t command;
+			GL::instance_matrix_t transform;
+		};
+		static bool try_allocate(page_t& page, allocation_t& a) {
+			a.first_vertex = page.vertex_space.allocate(a.vertex_count);
+			if (a.first_vertex == range_allocator_t::INVALID)
+				return false;
+			a.first_index = page.index_space.allocate(a.index_count);
+			if (a.first_index == range_allocator_t::INVALID) {
+				page.vertex_space.free(a.first_vertex, a.vertex_count);
+				return false;
+			}
+			return true;
+		}
+		uint32_t _vertices_per_page;
+		uint32_t _indices_per_page;
+		std::vector<std::unique_ptr<page_t>> _pages;
+		std::vector<allocation_t> _allocations;
+		std::vector<handle_t> _free_handles;
+		std::vector<draw_t> _draws;
+		std::vector<command_t> _commands;
+		std::vector<GL::instance_matrix_t> _instances;
+		std::optional<GL::indirect_buffer_t> _indirect;
+		std::optional<GL::vbo_t<GL::instance_matrix_t>> _instance_buffer;
+	};
+}
@@ -1,18 +1,25 @@
 #pragma once
 #include "../../mutex.hpp"
 #include "../../exceptions.hpp"
+#include "../../types.hpp"
+#include "../../utility/half.hpp"
+#include "state_cache.hpp"
 #include "glew/glew.h"
 #include <stdexcept>
+#include <span>
+#include <utility>
 #include <string>
 namespace foton {
 	namespace GL {
 		void check_gl_errors(const char* message) {
-			if constexpr (_DEBUG) { //Should probably use a macro but this is cleaner for now
-				auto err = glGetError();
-				if (err != GL_NO_ERROR) {
-					throw exceptions::gl_error_t(err, message);
-				}
+#ifdef _DEBUG
+			auto err = glGetError();
+			if (err != GL_NO_ERROR) {
+				throw exceptions::gl_error_t(err, message);
 			}
+#else
+			(void)message;
+#endif
 		}
 		void clear_gl_errors(bool throw_on_no_error = true) {
 			auto err = glGetError();
@@ -28,16 +35,60 @@ namespace foton {
 		};
 		static constexpr size_t gl_type_size(GLenum type) {
 			switch (type) {
+			case GL_BYTE:
+			case GL_UNSIGNED_BYTE:
+				static_assert(sizeof(GLbyte) == 1 && sizeof(GLubyte) == 1);
+				return 1;
+			case GL_SHORT:
+			case GL_UNSIGNED_SHORT:
+			case GL_HALF_FLOAT:
+				static_assert(sizeof(GLshort) == 2 && sizeof(GLushort) == 2 && sizeof(GLhalf) == 2);
+				return 2;
 			case GL_INT:
 			case GL_FLOAT:
 			case GL_UNSIGNED_INT:
+			case GL_INT_2_10_10_10_REV:
+			case GL_UNSIGNED_INT_2_10_10_10_REV:
 				static_assert(sizeof(GLint) == 4 && sizeof(GLfloat) == 4 && sizeof(GLuint) == 4);
 				return 4;
+			case GL_DOUBLE:
+				static_assert(sizeof(GLdouble) == 8);
+				return 8;
 			default:
 				//implement more types here
 				throw wrong_enum_error_t(type);
 			}
 		}
+		/*
+			GL component type and component count of a C++ type, for vertex attributes and typed buffers
+			scalars are 1 component, vectors are their length
+		*/
+		template<class T>
+		struct gl_type_traits_t;
+		template<GLenum Type, GLint Components>
+		struct gl_type_traits_base_t {
+			static constexpr GLenum type = Type;
+			static constexpr GLint components = Components;
+		};
+		template<> struct gl_type_traits_t<int8_t> : gl_type_traits_base_t<GL_BYTE, 1> {};
+		template<> struct gl_type_traits_t<uint8_t> : gl_type_traits_base_t<GL_UNSIGNED_BYTE, 1> {};
+		template<> struct gl_type_traits_t<int16_t> : gl_type_traits_base_t<GL_SHORT, 1> {};
+		template<> struct gl_type_traits_t<uint16_t> : gl_type_traits_base_t<GL_UNSIGNED_SHORT, 1> {};
+		template<> struct gl_type_traits_t<int32_t> : gl_type_traits_base_t<GL_INT, 1> {};
+		template<> struct gl_type_traits_t<uint32_t> : gl_type_traits_base_t<GL_UNSIGNED_INT, 1> {};
+		template<> struct gl_type_traits_t<half_t> : gl_type_traits_base_t<GL_HALF_FLOAT, 1> {};
+		template<> struct gl_type_traits_t<float> : gl_type_traits_base_t<GL_FLOAT, 1> {};
+		template<> struct gl_type_traits_t<double> : gl_type_traits_base_t<GL_DOUBLE, 1> {};
+		template<class T, uint_t Length>
+		struct gl_type_traits_t<vec_t<T, Length>> : gl_type_traits_base_t<gl_type_traits_t<T>::type, static_cast<GLint>(Length)> {};
+		template<class T, int Rows, int Options, int MaxRows, int MaxCols>
+		struct gl_type_traits_t<Eigen::Matrix<T, Rows, 1, Options, MaxRows, MaxCols>> : gl_type_traits_base_t<gl_type_traits_t<T>::type, Rows> {};
+		template<class T, size_t Length>
+		struct gl_type_traits_t<T[Length]> : gl_type_traits_base_t<gl_type_traits_t<T>::type, static_cast<GLint>(Length)> {};
+		template<class T>
+		static constexpr std::pair<GLenum, GLint> T_gl_type() {
+			return { gl_type_traits_t<T>::type, gl_type_traits_t<T>::components };
+		}
 		namespace buffer_locks {
 			thread_mutex_t vertex_attributes;
 			thread_mutex_t atomic_counter;
@@ -115,16 +166,15 @@ namespace foton {
 				};
 
 				buffer_bind_t(buffer_t& parent) : _lock(*parent._target_mutex), _parent(&parent) {
-					glBindBuffer(target(), buffer_id());
+					state_cache_t::current().bind_buffer(target(), buffer_id());
 				};
 				buffer_bind_t(const buffer_bind_t&) = delete;
 				buffer_bind_t(buffer_bind_t&& other) : _lock(std::move(other._lock)), _parent(other._parent) {
 					other._parent = nullptr;
 				}
 				~buffer_bind_t() {
-					if (buffer_id() > 0) {
-						glBindBuffer(target(), 0); //unbind itself
-					}
+					if (_parent != nullptr && buffer_id() > 0)
+						state_cache_t::current().unbind_buffer(target()); //only in debug (and for pixel buffers), see state_cache_t
 				}
 				GLsizei buffer_id() const {
 					return parent().buffer_id();
@@ -136,6 +186,12 @@ namespace foton {
 					glBufferData(_parent->_target, size_in_bytes, data, usage);
 					_parent->_size = static_cast<GLsizei>(size_in_bytes);
 				}
+				//overwrites part of the storage upload_data() made, nothing gets reallocated
+				void upload_sub_data(const byte_t* data, size_t offset_in_bytes, size_t size_in_bytes) {
+					if (offset_in_bytes + size_in_bytes > static_cast<size_t>(_parent->_size))
+						throw std::out_of_range("buffer sub data past the end of the buffer");
+					glBufferSubData(_parent->_target, offset_in_bytes, size_in_bytes, data);
+				}
 				buffer_t& parent() {
 					return *_parent;
 				}
@@ -165,8 +221,10 @@ namespace foton {
 				other._size = 0;
 			}
 			~buffer_t() {
-				if (_buffer_id != 0)
+				if (_buffer_id != 0) {
 					glDeleteBuffers(1, &_buffer_id);
+					state_cache_t::current().forget_buffer(_buffer_id);
+				}
 			}
 			/*
 				**WARNING**
@@ -223,7 +281,7 @@ namespace foton {
 				return T_gl_type<T>();
 			}
 			static constexpr size_t bytes_per_element() {
-				return sizeof(T) * amount_per_element();
+				return sizeof(T); //T already holds every component
 			}
 			size_t count() const {
 				return size() / bytes_per_element();
@@ -231,6 +289,13 @@ namespace foton {
 			void upload(const T* data, GLsizei count, GLenum usage = GL_STATIC_DRAW) {
 				bind().upload_data(reinterpret_cast<const uint8_t*>(data), sizeof(T) * count, usage);
 			}
+			void upload(std::span<const T> data, GLenum usage = GL_STATIC_DRAW) {
+				upload(data.data(), static_cast<GLsizei>(data.size()), usage);
+			}
+			//'count' elements starting at element 'first', the buffer has to be big enough already
+			void upload_sub(const T* data, GLsizei count, size_t first) {
+				bind().upload_sub_data(reinterpret_cast<const uint8_t*>(data), sizeof(T) * first, sizeof(T) * count);
+			}
 		private:
 
 		};
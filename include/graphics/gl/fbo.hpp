@@ -4,7 +4,7 @@ namespace foton::GL {
 		struct fbo_t {
 			struct fbo_bind_t {
 				fbo_bind_t(fbo_t& parent) : _parent(&parent), _lock(_mutex) {
-					glBindFramebuffer(_target, parent.id());
+					state_cache_t::current().bind_framebuffer(_target, parent.id());
 				}
 				fbo_bind_t(fbo_bind_t&& other) : _parent(other._parent), _lock(std::move(other._lock)) {
 					other._parent = nullptr;
@@ -40,8 +40,8 @@ namespace foton::GL {
 					glReadPixels(x, y, width, height, )
 				}
 				~fbo_bind_t() {
-					if (valid())
-						glBindFramebuffer(_target, 0);
+					if (_parent != nullptr && valid())
+						state_cache_t::current().bind_framebuffer(_target, 0); //always, rendering would keep going into the fbo
 				}
 			private:
 				fbo_t* _parent;
@@ -51,8 +51,10 @@ namespace foton::GL {
 				glGenFramebuffers(1, &_id);
 			}
 			~fbo_t() {
-				if (_id != 0)
+				if (_id != 0) {
 					glDeleteFramebuffers(1, &_id);
+					state_cache_t::current().forget_framebuffer(_id);
+				}
 			}
 			GLuint id() const {
 				return _id;
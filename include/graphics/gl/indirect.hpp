@@ -0,0 +1,33 @@
+#pragma once
+#include "buffer.hpp"
+namespace foton {
+	namespace GL {
+		//one draw of glMultiDrawElementsIndirect, the layout is fixed by the spec
+		struct draw_elements_indirect_command_t {
+			GLuint count;
+			GLuint instance_count;
+			GLuint first_index;
+			GLint base_vertex;
+			GLuint base_instance;
+		};
+		static_assert(sizeof(draw_elements_indirect_command_t) == 20);
+		struct indirect_buffer_t : typed_buffer_t<draw_elements_indirect_command_t> {
+			using command_t = draw_elements_indirect_command_t;
+			indirect_buffer_t() : typed_buffer_t<command_t>(GL_DRAW_INDIRECT_BUFFER) {}
+			size_t command_count() const {
+				return static_cast<size_t>(size()) / sizeof(command_t);
+			}
+			/*
+				draws 'draw_count' commands starting at 'first_command'
+				the vao (with its ebo) has to be bound already, 'index_type' is the ebo's gl_type()
+			*/
+			void multi_draw_elements(GLenum mode, GLenum index_type, GLsizei draw_count, size_t first_command = 0) {
+				if (first_command + draw_count > command_count())
+					throw std::out_of_range("indirect draw past the end of the command buffer");
+				auto b = bind();
+				glMultiDrawElementsIndirect(mode, index_type, reinterpret_cast<const void*>(first_command * sizeof(command_t)), draw_count, 0);
+				check_gl_errors("after glMultiDrawElementsIndirect");
+			}
+		};
+	}
+}
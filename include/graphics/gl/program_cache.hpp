@@ -0,0 +1,222 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "../../glew/glew.h"
+#include "../../utility/hash.hpp"
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+namespace foton {
+	namespace shader {
+		namespace filesystem = std::filesystem;
+		/*
+			linked program binaries on disk, so a program that was built before loads with one glProgramBinary
+			instead of compiling and linking every stage again
+
+			the key hashes every stage's source (with its stage), the defines and the driver's vendor/renderer/version
+			strings, so a driver update or a different GPU never even tries an old binary. the driver can still refuse one
+			(its format list changed, or it just does), load() treats that as a miss, deletes the file and the caller compiles
+
+			one file per key: header_t then the binary. programs meant for store() need
+			GL_PROGRAM_BINARY_RETRIEVABLE_HINT before they link (shader_t's retrievable_binary)
+			context thread only
+		*/
+		struct program_cache_t {
+			static constexpr std::array<char, 4> MAGIC = { 'F', 'C', 'P', 'B' };
+			static constexpr uint32_t VERSION = 1;
+			struct header_t {
+				std::array<char, 4> magic = MAGIC;
+				uint32_t version = VERSION;
+				uint64_t key = 0;
+				uint64_t driver = 0; //hash of the driver strings, in the key too but checked on its own for a clearer miss
+				uint32_t format = 0; //binaryFormat from glGetProgramBinary
+				uint32_t size = 0;
+			};
+			static_assert(std::is_trivially_copyable_v<header_t> && sizeof(header_t) % 8 == 0);
+			struct stats_t {
+				size_t hits = 0;
+				size_t misses = 0;
+				size_t rejected = 0; //files the driver or the header check turned down
+				size_t stored = 0;
+			};
+			stats_t stats;
+			filesystem::path directory;
+
+			explicit program_cache_t(filesystem::path directory = default_directory()) : directory(std::move(directory)) {}
+			//'shader_cache' next to the executable
+			static filesystem::path default_directory() {
+#ifdef _WIN32
+				wchar_t path[MAX_PATH];
+				const DWORD length = GetModuleFileNameW(nullptr, path, MAX_PATH);
+				if (length > 0 && length < MAX_PATH)
+					return filesystem::path(std::wstring(path, length)).parent_path() / "shader_cache";
+#else
+				std::error_code error;
+				const filesystem::path executable = filesystem::read_symlink("/proc/self/exe", error);
+				if (!error)
+					return executable.parent_path() / "shader_cache";
+#endif
+				return filesystem::current_path() / "shader_cache";
+			}
+			//false when the driver has no binary formats, load() always misses and store() does nothing
+			bool enabled() {
+				if (!_formats_queried) {
+					_formats_queried = true;
+					GLint count = 0;
+					glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &count);
+					_binary_formats.resize(static_cast<size_t>(std::max(count, 0)));
+					if (!_binary_formats.empty())
+						glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, _binary_formats.data());
+				}
+				return !_binary_formats.empty();
+			}
+			//'stages' pairs a shader type with its source (after defines were added), empty sources are skipped
+			uint64_t key(std::initializer_list<std::pair<GLenum, std::string_view>> stages, const std::vector<std::string>& defines) {
+				uint64_t h = hash::combine(driver_hash(), VERSION);
+				for (const auto& [stage, source] : stages) {
+					if (!source.empty())
+						h = hash::combine(hash::combine(h, stage), hash::string(source));
+				}
+				for (const std::string& define : defines)
+					h = hash::combine(h, hash::string(define));
+				return h;
+			}
+			filesystem::path path(uint64_t key) const {
+				char name[17];
+				std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+				return directory / (std::string(name) + ".bin");
+			}
+			//a linked program, or 0 on a miss
+			GLuint load(uint64_t key) {
+				if (!enabled()) {
+					stats.misses++;
+					return 0;
+				}
+				const filesystem::path file = path(key);
+				std::ifstream in(file, std::ios::binary);
+				if (!in) {
+					stats.misses++;
+					return 0;
+				}
+				header_t header;
+				in.read(reinterpret_cast<char*>(&header), sizeof(header));
+				std::error_code error;
+				const uintmax_t file_size = filesystem::file_size(file, error);
+				//the size is checked against the file before allocating, and a format the driver doesn't list would be GL_INVALID_ENUM
+				std::vector<char> binary;
+				if (in && !error && header.magic == MAGIC && header.version == VERSION && header.key == key && header.driver == driver_hash()
+					&& header.size > 0 && file_size == sizeof(header) + uintmax_t(header.size)
+					&& std::find(_binary_formats.begin(), _binary_formats.end(), static_cast<GLint>(header.format)) != _binary_formats.end()) {
+					binary.resize(header.size);
+					in.read(binary.data(), static_cast<std::streamsize>(binary.size()));
+				}
+				const bool read = in && !binary.empty();
+				in.close();
+				if (!read) {
+					reject(file);
+					return 0;
+				}
+				const GLuint program = glCreateProgram();
+				glProgramBinary(program, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+				GLint linked = GL_FALSE;
+				glGetProgramiv(program, GL_LINK_STATUS, &linked); //a binary the driver refuses fails to link, without a GL error
+				if (!linked) {
+					glDeleteProgram(program);
+					reject(file);
+					return 0;
+				}
+				stats.hits++;
+				return program;
+			}
+			//writes 'program' (linked, with the retrievable hint) under 'key', temporary file + rename like the cooked formats
+			void store(uint64_t key, GLuint program) {
+				if (!enabled())
+					return;
+				GLint linked = GL_FALSE, length = 0;
+				glGetProgramiv(program, GL_LINK_STATUS, &linked);
+				glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+				if (!linked || length <= 0)
+					return;
+				std::vector<char> binary(static_cast<size_t>(length));
+				header_t header;
+				header.key = key;
+				header.driver = driver_hash();
+				GLenum format = 0;
+				GLsizei written = 0;
+				glGetProgramBinary(program, length, &written, &format, binary.data());
+				header.format = format;
+				header.size = static_cast<uint32_t>(written);
+				std::error_code error;
+				filesystem::create_directories(directory, error);
+				const filesystem::path file = path(key);
+				filesystem::path temporary = file;
+				temporary += ".tmp";
+				{
+					std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+					out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+					out.write(binary.data(), written);
+					if (!out)
+						return; //a cache that can't be written is just a cache that always misses
+				}
+				filesystem::rename(temporary, file, error);
+				if (!error)
+					stats.stored++;
+			}
+		private:
+			uint64_t driver_hash() {
+				if (_driver == 0) {
+					for (const GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+						const GLubyte* text = glGetString(name);
+						_driver = hash::combine(_driver, text ? hash::string(reinterpret_cast<const char*>(text)) : 0);
+					}
+				}
+				return _driver;
+			}
+			void reject(const filesystem::path& file) {
+				stats.rejected++;
+				stats.misses++;
+				std::error_code error;
+				filesystem::remove(file, error);
+			}
+			uint64_t _driver = 0;
+			bool _formats_queried = false;
+			std::vector<GLint> _binary_formats; //GL_PROGRAM_BINARY_FORMATS
+		};
+		//puts '#define <define>' lines right after the #version line, then a #line so compile errors still point at the file's lines
+		inline std::string add_defines(std::string_view source, const std::vector<std::string>& defines) {
+			if (defines.empty() || source.empty())
+				return std::string(source);
+			size_t insert = 0, line = 1;
+			const size_t version = source.find("#version");
+			if (version != std::string_view::npos) {
+				const size_t end = source.find('\n', version);
+				insert = end == std::string_view::npos ? source.size() : end + 1;
+				line += std::count(source.begin(), source.begin() + insert, '\n');
+			}
+			std::string out(source.substr(0, insert));
+			if (!out.empty() && out.back() != '\n')
+				out += '\n';
+			for (const std::string& define : defines)
+				out += "#define " + define + '\n';
+			out += "#line " + std::to_string(line) + '\n';
+			out += source.substr(insert);
+			return out;
+		}
+	}
+}
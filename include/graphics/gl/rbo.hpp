@@ -2,12 +2,13 @@
 #include "../../types.hpp"
 #include "../../glew/glew.h"
 #include "../../mutex.hpp"
+#include "state_cache.hpp"
 
 namespace foton::GL {
 	struct rbo_t {
 		struct rbo_bind_t {
 			rbo_bind_t(rbo_t& parent) : _parent(&parent), _lock(_mutex) {
-				glBindRenderbuffer(_target, parent.id());
+				state_cache_t::current().bind_renderbuffer(parent.id());
 			}
 			rbo_bind_t(rbo_bind_t&& other) : _parent(other._parent), _lock(std::move(other._lock)) {
 				other._parent = nullptr;
@@ -31,8 +32,8 @@ namespace foton::GL {
 				return parent().target();
 			}
 			~rbo_bind_t() {
-				if (valid())
-					glBindRenderbuffer(parent().target(), 0);
+				if (state_cache_t::UNBIND_ON_EXIT && _parent != nullptr && valid())
+					state_cache_t::current().bind_renderbuffer(0);
 			}
 		private:
 			rbo_t* _parent;
@@ -43,8 +44,10 @@ namespace foton::GL {
 			glGenRenderbuffers(1, &_id);
 		}
 		~rbo_t() {
-			if (_id != 0)
+			if (_id != 0) {
 				glDeleteRenderbuffers(1, &_id);
+				state_cache_t::current().forget_renderbuffer(_id);
+			}
 		}
 		rbo_bind_t bind() {
 			return rbo_bind_t(*this);
@@ -0,0 +1,166 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include "buffer.hpp"
+namespace foton {
+	namespace GL {
+		/*
+			per frame streaming memory (uniform blocks, dynamic vertices, instance data) without glBufferData or glMapBuffer stalls
+
+			one glBufferStorage allocation split into FRAMES regions, mapped once (persistent + coherent) for the buffer's lifetime
+			writes go straight into the mapping, the GPU sees them without any flush or unmap
+			begin_frame() moves to the next region and waits on its fence first, end_frame() fences the current one,
+			so the CPU only ever writes a region the GPU finished reading FRAMES - 1 frames ago
+
+			allocate() is a single atomic bump so any number of recording threads can suballocate at once,
+			begin_frame()/end_frame() belong to the context thread
+		*/
+		struct ring_buffer_t : buffer_t {
+			struct ring_buffer_error_t : std::runtime_error {
+				ring_buffer_error_t(const char* what) : std::runtime_error(what) {}
+			};
+			//one suballocation, 'data' is nullptr when the frame's region ran out
+			template<class T>
+			struct allocation_t {
+				std::span<T> data;
+				GLintptr offset = 0; //in bytes from the start of the buffer, for glBindBufferRange / attribute pointers
+				explicit operator bool() const {
+					return data.data() != nullptr;
+				}
+				GLsizeiptr size_bytes() const {
+					return static_cast<GLsizeiptr>(data.size_bytes());
+				}
+			};
+			struct stats_t {
+				size_t bytes = 0; //allocated in the last frame
+				size_t failed = 0; //allocations that didn't fit in the last frame
+				size_t fence_waits = 0; //begin_frame() calls that had to wait on the GPU, since construction
+				std::chrono::nanoseconds fence_wait_time{ 0 };
+			};
+			static constexpr uint32_t FRAMES = 3;
+			static constexpr GLbitfield MAP_FLAGS = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+			ring_buffer_t(GLenum target, size_t bytes_per_frame) : buffer_t(target), _bytes_per_frame(bytes_per_frame) {
+				if (!glBufferStorage)
+					throw ring_buffer_error_t("glBufferStorage isn't available (needs GL 4.4 or ARB_buffer_storage)");
+				if (target == GL_UNIFORM_BUFFER) {
+					GLint alignment = 0;
+					glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+					_min_alignment = std::max<size_t>(_min_alignment, alignment);
+				}
+				else if (target == GL_SHADER_STORAGE_BUFFER) {
+					GLint alignment = 0;
+					glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+					_min_alignment = std::max<size_t>(_min_alignment, alignment);
+				}
+				_bytes_per_frame = align_up(bytes_per_frame, _min_alignment); //keeps every region's start aligned too
+				const size_t total = _bytes_per_frame * FRAMES;
+				auto b = bind();
+				glBufferStorage(target, static_cast<GLsizeiptr>(total), nullptr, MAP_FLAGS);
+				_mapped = static_cast<byte_t*>(glMapBufferRange(target, 0, static_cast<GLsizeiptr>(total), MAP_FLAGS));
+				if (!_mapped)
+					throw ring_buffer_error_t("couldn't persistently map the ring buffer");
+				_size = static_cast<GLsizei>(total);
+				check_gl_errors("after creating ring_buffer_t");
+			}
+			ring_buffer_t(const ring_buffer_t&) = delete;
+			~ring_buffer_t() {
+				for (GLsync& fence : _fences) {
+					if (fence)
+						glDeleteSync(fence);
+				}
+				//deleting the buffer unmaps it
+			}
+			//context thread, before anything allocates for the frame
+			void begin_frame() {
+				_frame = (_frame + 1) % FRAMES;
+				if (GLsync fence = _fences[_frame]) {
+					const auto start = std::chrono::steady_clock::now();
+					GLenum result = glClientWaitSync(fence, 0, 0);
+					if (result == GL_TIMEOUT_EXPIRED) {
+						stats.fence_waits++;
+						do { //flush once so the fence can signal at all, then keep waiting
+							result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+						} while (result == GL_TIMEOUT_EXPIRED);
+					}
+					stats.fence_wait_time += std::chrono::steady_clock::now() - start;
+					glDeleteSync(fence);
+					_fences[_frame] = nullptr;
+					if (result == GL_WAIT_FAILED)
+						throw ring_buffer_error_t("glClientWaitSync failed");
+				}
+				_head.store(0, std::memory_order_relaxed);
+				_failed.store(0, std::memory_order_relaxed);
+			}
+			//context thread, after the last draw reading this frame's region was issued
+			void end_frame() {
+				if (_fences[_frame])
+					glDeleteSync(_fences[_frame]);
+				_fences[_frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+				stats.bytes = _head.load(std::memory_order_relaxed);
+				stats.failed = _failed.load(std::memory_order_relaxed);
+			}
+			//'size' bytes aligned to 'alignment' (and the target's offset alignment), any thread
+			allocation_t<byte_t> allocate_bytes(size_t size, size_t alignment = 16) {
+				alignment = std::max(alignment, _min_alignment);
+				size_t head = _head.load(std::memory_order_relaxed);
+				size_t start;
+				do {
+					start = align_up(head, alignment);
+					if (start + size > _bytes_per_frame) {
+						_failed.fetch_add(1, std::memory_order_relaxed);
+						return {};
+					}
+				} while (!_head.compare_exchange_weak(head, start + size, std::memory_order_relaxed));
+				const size_t offset = _frame * _bytes_per_frame + start;
+				return allocation_t<byte_t>{ std::span<byte_t>(_mapped + offset, size), static_cast<GLintptr>(offset) };
+			}
+			//'count' T to write into, e.g. dynamic vertices or instance matrices
+			template<class T>
+			allocation_t<T> allocate(size_t count) {
+				static_assert(std::is_trivially_copyable_v<T>, "only trivially copyable objects can go to the GPU");
+				const allocation_t<byte_t> bytes = allocate_bytes(sizeof(T) * count, alignof(T));
+				if (!bytes)
+					return {};
+				return allocation_t<T>{ std::span<T>(reinterpret_cast<T*>(bytes.data.data()), count), bytes.offset };
+			}
+			//one uniform block, bind it with bind_range
+			template<class BlockT>
+			allocation_t<BlockT> allocate_uniform() {
+				return allocate<BlockT>(1);
+			}
+			//copies 'values' in, the allocation is empty if they didn't fit
+			template<class T>
+			allocation_t<T> push(std::span<const T> values) {
+				allocation_t<T> out = allocate<T>(values.size());
+				if (out)
+					std::copy(values.begin(), values.end(), out.data.begin());
+				return out;
+			}
+			//binds an allocation to an indexed target (uniform/shader storage block binding 'index')
+			template<class T>
+			void bind_range(GLuint index, const allocation_t<T>& allocation) const {
+				state_cache_t::current().bind_buffer_range(target(), index, buffer_id(), allocation.offset, allocation.size_bytes());
+			}
+			size_t bytes_per_frame() const {
+				return _bytes_per_frame;
+			}
+			stats_t stats;
+		private:
+			static size_t align_up(size_t value, size_t alignment) {
+				return (value + alignment - 1) / alignment * alignment;
+			}
+			byte_t* _mapped = nullptr;
+			size_t _bytes_per_frame;
+			size_t _min_alignment = 16;
+			uint32_t _frame = 0;
+			std::atomic<size_t> _head = 0;
+			std::atomic<size_t> _failed = 0;
+			GLsync _fences[FRAMES] = {};
+		};
+	}
+}
@@ -1,4 +1,5 @@
 #pragma once
+#include <optional>
 #include <string>
 #include <stdexcept>
 #include <shared_mutex>
@@ -8,6 +9,9 @@
 #include "glew/glew.h"
 #include "Eigen/Geometry"
 #include "../../mutex.hpp"
+#include "program_cache.hpp"
+#include "shader_compiler.hpp"
+#include "uniform_block.hpp"
 namespace foton {
 	namespace shader {
 		namespace filesystem = std::filesystem; //why is this still in experimental?
@@ -143,7 +147,7 @@ namespace foton {
 			struct shader_bind_t {
 				const GLuint program = 0;
 				_Acquires_lock_(_master_shader_mutex) shader_bind_t(GLuint program) : program(program), lock(_master_shader_mutex) {
-					glUseProgram(program);
+					GL::state_cache_t::current().use_program(program);
 				}
 				shader_bind_t(const shader_bind_t&) = delete;
 				shader_bind_t(shader_bind_t&& other) noexcept : program(other.program), lock(std::move(other.lock)) {
@@ -151,13 +155,18 @@ namespace foton {
 				}
 				void unuse() {
 					if (lock.owns_lock()) {
-						glUseProgram(0);
-						lock.release();
+						if (GL::state_cache_t::UNBIND_ON_EXIT)
+							GL::state_cache_t::current().use_program(0);
+						lock.unlock();
 					}
 				}
 				~shader_bind_t() {
 					unuse();
 				}
+				//for code that binds programs itself for a whole pass (render_queue_t) instead of per draw
+				static thread_mutex_t& mutex() {
+					return _master_shader_mutex;
+				}
 			private:
 				static thread_mutex_t _master_shader_mutex;
 				std::unique_lock<thread_mutex_t> lock;
@@ -197,7 +206,8 @@ namespace foton {
 
 			GLuint id = INVALID_SHADER_ID;
 		public:
-			shader_t(GLuint vertex_shader, GLuint fragment_shader, GLuint geometry_shader) {
+			//'retrievable_binary' lets program_cache_t::store() read the linked program back
+			shader_t(GLuint vertex_shader, GLuint fragment_shader, GLuint geometry_shader, bool retrievable_binary = false) {
 				if (vertex_shader == INVALID_SHADER_ID || fragment_shader == INVALID_SHADER_ID) {
 					throw shader_error_t("shader requires a valid vertex AND fragment shader atleast");
 				}
@@ -207,18 +217,30 @@ namespace foton {
 				glAttachShader(id, fragment_shader);
 				if (geometry_shader != INVALID_SHADER_ID)
 					glAttachShader(id, geometry_shader);
+				if (retrievable_binary)
+					glProgramParameteri(id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 				glLinkProgram(id);
 				//the shaders should be linked to the program so we can release our hold on the memory
 				glDeleteShader(vertex_shader);
 				glDeleteShader(fragment_shader);
 				if (geometry_shader != INVALID_SHADER_ID)
 					glDeleteShader(geometry_shader);
+				bind_standard_blocks();
 
 				if (auto err = glGetError(); err != GL_NO_ERROR)
 					throw shader_error_t(std::string("glError after shader_t construction: ") + std::to_string(err));
 			};
-			shader_t(const char* vertex_source, const char* fragment_source, const char* geometry_source) :
-				shader_t(load_shader(vertex_source, GL_VERTEX_SHADER), load_shader(fragment_source, GL_FRAGMENT_SHADER), load_shader(geometry_source, GL_GEOMETRY_SHADER)) {};
+			shader_t(const char* vertex_source, const char* fragment_source, const char* geometry_source, bool retrievable_binary = false) :
+				shader_t(load_shader(vertex_source, GL_VERTEX_SHADER), load_shader(fragment_source, GL_FRAGMENT_SHADER), load_shader(geometry_source, GL_GEOMETRY_SHADER), retrievable_binary) {};
+			//takes ownership of an already linked program (program_cache_t::load), block bindings don't survive glProgramBinary so they get set again
+			//no program, program_id() is 0 until update_from() (a shader still compiling through shader_compiler_t)
+			shader_t() = default;
+			static shader_t from_program(GLuint program) {
+				shader_t out;
+				out.id = program;
+				out.bind_standard_blocks();
+				return out;
+			}
 			shader_t(const shader_t&) = delete;
 			shader_t operator=(const shader_t&) = delete;
 			shader_t(shader_t&& other) noexcept : id(other.id) {
@@ -244,57 +266,143 @@ namespace foton {
 			shader_bind_t use() {
 				return shader_bind_t(id);
 			}
+			GLuint program_id() const {
+				return id;
+			}
+			//-1 when the program has no active attribute called 'name'
+			GLint attribute_location(const char* name) const {
+				return id == INVALID_SHADER_ID ? -1 : glGetAttribLocation(id, name);
+			}
+			//GL_INVALID_INDEX when the program has no active uniform block called 'name'
+			GLuint uniform_block_index(const char* name) const {
+				return id == INVALID_SHADER_ID ? GL_INVALID_INDEX : glGetUniformBlockIndex(id, name);
+			}
+			bool has_uniform_block(const char* name) const {
+				return uniform_block_index(name) != GL_INVALID_INDEX;
+			}
+			//points the block at binding point 'binding', where GL::uniform_block_t::upload() puts its data. false if there's no such block
+			bool bind_uniform_block(const char* name, GLuint binding) {
+				const GLuint index = uniform_block_index(name);
+				if (index == GL_INVALID_INDEX)
+					return false;
+				glUniformBlockBinding(id, index, binding);
+				return true;
+			}
 			void update_from(shader_t&& other) {
 				shader_bind_t lock = use(); //bind the shader state so we can mess with it
 				lock.unuse(); //unuse so opengl isn't using the resources anymore
 				if (id > 0) {
 					glDeleteProgram(id);
+					GL::state_cache_t::current().forget_program(id);
 				}
 				id = other.id;
 				other.id = 0;
 			}
 			private:
+				void bind_standard_blocks() {
+					bind_uniform_block(GL::uniform_bindings::FRAME_BLOCK, GL::uniform_bindings::FRAME);
+					bind_uniform_block(GL::uniform_bindings::OBJECT_BLOCK, GL::uniform_bindings::OBJECT);
+				}
 				void delete_program() {
 					if (id > 0) {
 						glDeleteProgram(id);
+						GL::state_cache_t::current().forget_program(id);
 						id = INVALID_SHADER_ID;
 					}
 				}
 		};
+		/*
+			a program built from files, reload_shader() rebuilds it from whatever is on disk now
+			with a program_cache_t, unchanged sources + defines load the last linked binary instead of compiling
+			'defines' go in after each stage's #version line (see add_defines), one entry per permutation switch, eg "SHADOWS" or "LIGHTS 4"
+			reload_async() hands the compile to a shader_compiler_t instead, the old program keeps drawing until update() swaps the new one in
+			built with a compiler it starts out empty (program_id() 0, render_queue_t draws it with its fallback) and the first update() that
+			finds the program linked swaps it in
+		*/
 		struct shader_with_paths_t {
 			const filesystem::path vertex_path;
 			const filesystem::path fragment_path;
 			const filesystem::path geometry_path;
-			shader_with_paths_t(const filesystem::path& vertex_path, const filesystem::path& fragment_path, const filesystem::path& geometry_path) 
-				: vertex_path(vertex_path), fragment_path(fragment_path), geometry_path(geometry_path), _shader(load_new_shader()) {
+			const std::vector<std::string> defines;
+			program_cache_t* const cache;
+			shader_with_paths_t(const filesystem::path& vertex_path, const filesystem::path& fragment_path, const filesystem::path& geometry_path,
+				program_cache_t* cache = nullptr, std::vector<std::string> defines = {})
+				: vertex_path(vertex_path), fragment_path(fragment_path), geometry_path(geometry_path), defines(std::move(defines)), cache(cache),
+				_shader(load_new_shader()) {
+			}
+			shader_with_paths_t(const filesystem::path& vertex_path, const filesystem::path& fragment_path, const filesystem::path& geometry_path,
+				shader_compiler_t& compiler, program_cache_t* cache = nullptr, std::vector<std::string> defines = {})
+				: vertex_path(vertex_path), fragment_path(fragment_path), geometry_path(geometry_path), defines(std::move(defines)), cache(cache) {
+				reload_async(compiler);
 			}
 			void reload_shader() {
+				_pending = {};
 				_shader.update_from(load_new_shader());
 			}
-			static shader_with_paths_t guess_filetypes(std::initializer_list<const filesystem::path> paths) {
-				using path = filesystem::path;
-				auto find_path = [&](std::string extension, bool no_throw = false) {
-					for (const path& p : paths) {
-						if (p.extension() == extension)
-							return p;
+			//a cache hit still swaps on the next update(), so callers only handle a new program in one place
+			void reload_async(shader_compiler_t& compiler) {
+				sources_t sources = load_sources();
+				if (cache) {
+					if (const GLuint program = cache->load(sources.key)) {
+						_pending = {};
+						_loaded.emplace(shader_t::from_program(program));
+						return;
 					}
-					if (no_throw)
-						return path();
-					throw file_not_found_error_t((extension + " shader file not found").c_str());
-				};
-				const path vertex_path = find_path(".vert");
-				const path fragment_path = find_path(".frag");
-				const path geometry_path = find_path(".geom", true);
-				return shader_with_paths_t(vertex_path, fragment_path, geometry_path);
+				}
+				_loaded.reset();
+				_pending = compiler.submit(sources.vertex, sources.fragment, sources.geometry, cache, sources.key);
+			}
+			//after shader_compiler_t::poll(), true when a new program was swapped in and uniform locations need looking up again
+			//a reload that failed to build throws shader_error_t with its logs, once, and leaves the old program in place
+			bool update() {
+				if (_loaded) {
+					_shader.update_from(std::move(*_loaded));
+					_loaded.reset();
+					return true;
+				}
+				if (_pending.ready()) {
+					_shader.update_from(shader_t::from_program(_pending.take()));
+					return true;
+				}
+				if (_pending.failed()) {
+					const std::string error = _pending.error();
+					_pending = {};
+					throw shader_error_t(error);
+				}
+				return false;
+			}
+			bool compiling() const {
+				return _pending.valid();
+			}
+			static shader_with_paths_t guess_filetypes(std::initializer_list<const filesystem::path> paths, program_cache_t* cache = nullptr,
+				std::vector<std::string> defines = {}) {
+				return shader_with_paths_t(find_path(paths, ".vert"), find_path(paths, ".frag"), find_path(paths, ".geom", true), cache, std::move(defines));
+			}
+			//same, built through 'compiler'
+			static shader_with_paths_t guess_filetypes(std::initializer_list<const filesystem::path> paths, shader_compiler_t& compiler,
+				program_cache_t* cache = nullptr, std::vector<std::string> defines = {}) {
+				return shader_with_paths_t(find_path(paths, ".vert"), find_path(paths, ".frag"), find_path(paths, ".geom", true), compiler, cache, std::move(defines));
 			}
 			shader_t& shader() {
 				return _shader;
 			}
 		private:
-			shader_t load_new_shader() {
-				if (auto err = glGetError(); err != GL_NO_ERROR)
-					throw shader_error_t(std::string("trying to load new shader while glError is ") + std::to_string(err));
-			
+			static filesystem::path find_path(std::initializer_list<const filesystem::path> paths, const std::string& extension, bool no_throw = false) {
+				for (const filesystem::path& p : paths) {
+					if (p.extension() == extension)
+						return p;
+				}
+				if (no_throw)
+					return filesystem::path();
+				throw file_not_found_error_t((extension + " shader file not found").c_str());
+			}
+			struct sources_t {
+				std::string vertex;
+				std::string fragment;
+				std::string geometry;
+				uint64_t key = 0; //0 without a cache
+			};
+			sources_t load_sources() {
 				auto load_file = [](const filesystem::path& filename) {
 					if (filename.empty()) {
 						return std::string();
@@ -308,14 +416,32 @@ namespace foton {
 						return std::string(file_iter(input), file_iter());
 					}
 				};
-				std::string vertex_source = load_file(vertex_path);
-				std::string fragment_source = load_file(fragment_path);
-				std::string geometry_source = load_file(geometry_path);
-				return shader_t(vertex_source.empty() ? nullptr : vertex_source.c_str(),
-					fragment_source.empty() ? nullptr : fragment_source.c_str(),
-					geometry_source.empty() ? nullptr : geometry_source.c_str());
+				sources_t sources;
+				sources.vertex = add_defines(load_file(vertex_path), defines);
+				sources.fragment = add_defines(load_file(fragment_path), defines);
+				sources.geometry = add_defines(load_file(geometry_path), defines);
+				if (cache)
+					sources.key = cache->key({ { GL_VERTEX_SHADER, sources.vertex }, { GL_FRAGMENT_SHADER, sources.fragment }, { GL_GEOMETRY_SHADER, sources.geometry } }, defines);
+				return sources;
+			}
+			shader_t load_new_shader() {
+				if (auto err = glGetError(); err != GL_NO_ERROR)
+					throw shader_error_t(std::string("trying to load new shader while glError is ") + std::to_string(err));
+				const sources_t sources = load_sources();
+				if (cache) {
+					if (const GLuint program = cache->load(sources.key))
+						return shader_t::from_program(program);
+				}
+				shader_t shader(sources.vertex.empty() ? nullptr : sources.vertex.c_str(),
+					sources.fragment.empty() ? nullptr : sources.fragment.c_str(),
+					sources.geometry.empty() ? nullptr : sources.geometry.c_str(), cache != nullptr);
+				if (cache)
+					cache->store(sources.key, shader.program_id());
+				return shader;
 			}
 			shader_t _shader;
+			shader_compiler_t::program_future_t _pending;
+			std::optional<shader_t> _loaded; //cache hit from reload_async(), waiting for update()
 		};
 		/*
 		struct shader_transform_uniforms_t {
@@ -0,0 +1,236 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../../glew/glew.h"
+#include "program_cache.hpp"
+namespace foton {
+	namespace shader {
+		/*
+			shader programs built without waiting on them
+
+			submit() creates, compiles and links every stage right away and never asks GL how it went, any status query
+			would make the driver finish the compile on the spot. poll() (once a frame) asks GL_COMPLETION_STATUS_KHR
+			instead, which doesn't wait, and only looks at link status and logs for programs that are done
+			with KHR/ARB_parallel_shader_compile the driver compiles on its own threads (glMaxShaderCompilerThreadsKHR),
+			without it the first status query blocks, so poll() finishes at most one program a frame to keep the hitch small
+
+			fallback_program() is a flat magenta program for whatever has nothing linked yet (render_queue_t::fallback)
+			context thread only, futures included
+		*/
+		struct shader_compiler_t {
+			enum class state_t {
+				compiling,
+				ready,
+				failed,
+				taken
+			};
+			struct job_t {
+				GLuint program = 0;
+				std::vector<GLuint> shaders;
+				state_t state = state_t::compiling;
+				std::string error;
+				program_cache_t* cache = nullptr;
+				uint64_t key = 0;
+				job_t() = default;
+				job_t(const job_t&) = delete;
+				~job_t() {
+					for (const GLuint shader : shaders)
+						glDeleteShader(shader);
+					if (program != 0)
+						glDeleteProgram(program);
+				}
+			};
+			//what submit() hands back, copies share the job. a program nobody takes gets deleted with its last future
+			struct program_future_t {
+				program_future_t() = default;
+				bool valid() const {
+					return _job != nullptr;
+				}
+				//an empty future (default constructed or taken) reports taken
+				state_t state() const {
+					return valid() ? _job->state : state_t::taken;
+				}
+				bool ready() const {
+					return valid() && _job->state == state_t::ready;
+				}
+				bool failed() const {
+					return valid() && _job->state == state_t::failed;
+				}
+				//compile and link logs when failed()
+				const std::string& error() const {
+					static const std::string none;
+					return valid() ? _job->error : none;
+				}
+				//the linked program, the caller owns it from here (shader_t::from_program)
+				GLuint take() {
+					if (!ready())
+						throw std::logic_error("taking a program that isn't ready");
+					const GLuint program = _job->program;
+					_job->program = 0;
+					_job->state = state_t::taken;
+					_job.reset();
+					return program;
+				}
+			private:
+				explicit program_future_t(std::shared_ptr<job_t> job) : _job(std::move(job)) {}
+				std::shared_ptr<job_t> _job;
+				friend shader_compiler_t;
+			};
+			struct stats_t {
+				size_t submitted = 0;
+				size_t linked = 0;
+				size_t failed = 0;
+				size_t blocked = 0; //programs poll() had to wait on, only without parallel_shader_compile
+			};
+			static constexpr GLuint ALL_THREADS = 0xFFFFFFFF; //lets the driver pick
+			stats_t stats;
+
+			explicit shader_compiler_t(GLuint threads = ALL_THREADS) {
+				if (GLEW_KHR_parallel_shader_compile) {
+					glMaxShaderCompilerThreadsKHR(threads);
+					_parallel = true;
+				}
+				else if (GLEW_ARB_parallel_shader_compile) {
+					glMaxShaderCompilerThreadsARB(threads);
+					_parallel = true;
+				}
+			}
+			shader_compiler_t(const shader_compiler_t&) = delete;
+			shader_compiler_t& operator=(const shader_compiler_t&) = delete;
+			bool parallel() const {
+				return _parallel;
+			}
+			size_t pending() const {
+				return _jobs.size();
+			}
+			//empty geometry source for none. with a cache the program gets the retrievable hint and is stored under 'key' once it links
+			program_future_t submit(std::string_view vertex_source, std::string_view fragment_source, std::string_view geometry_source = {},
+				program_cache_t* cache = nullptr, uint64_t key = 0) {
+				auto job = std::make_shared<job_t>();
+				job->cache = cache;
+				job->key = key;
+				job->program = glCreateProgram();
+				for (const auto& [stage, source] : { std::pair{ GL_VERTEX_SHADER, vertex_source }, std::pair{ GL_FRAGMENT_SHADER, fragment_source },
+					std::pair{ GL_GEOMETRY_SHADER, geometry_source } }) {
+					if (source.empty())
+						continue;
+					const GLuint shader = glCreateShader(stage);
+					const GLchar* text = source.data();
+					const GLint length = static_cast<GLint>(source.size());
+					glShaderSource(shader, 1, &text, &length);
+					glCompileShader(shader);
+					glAttachShader(job->program, shader);
+					job->shaders.push_back(shader);
+				}
+				if (cache)
+					glProgramParameteri(job->program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+				glLinkProgram(job->program); //queued behind the compiles, nothing waits here
+				_jobs.push_back(job);
+				stats.submitted++;
+				return program_future_t(std::move(job));
+			}
+			//once a frame, moves finished programs to ready or failed
+			void poll() {
+				bool blocked = false;
+				for (const std::shared_ptr<job_t>& job : _jobs) {
+					if (_parallel) {
+						GLint done = GL_FALSE;
+						glGetProgramiv(job->program, GL_COMPLETION_STATUS_KHR, &done);
+						if (!done)
+							continue;
+					}
+					else {
+						if (blocked)
+							continue;
+						blocked = true;
+						stats.blocked++;
+					}
+					finish(*job);
+				}
+				_jobs.erase(std::remove_if(_jobs.begin(), _jobs.end(), [](const std::shared_ptr<job_t>& job) {
+					return job->state != state_t::compiling;
+				}), _jobs.end());
+			}
+			//built (blocking, it's tiny) on first use. reads 'in vec3' at location 0 and 'uniform mat4 transform'
+			GLuint fallback_program() {
+				if (!_fallback) {
+					program_future_t future = submit(FALLBACK_VERTEX, FALLBACK_FRAGMENT);
+					_jobs.pop_back();
+					finish(*future._job);
+					if (!future.ready())
+						throw std::runtime_error("fallback program didn't link: " + future.error());
+					_fallback_program = future.take();
+					_fallback_transform = glGetUniformLocation(_fallback_program, "transform");
+					_fallback = true;
+				}
+				return _fallback_program;
+			}
+			GLint fallback_transform_location() {
+				fallback_program();
+				return _fallback_transform;
+			}
+			~shader_compiler_t() {
+				if (_fallback)
+					glDeleteProgram(_fallback_program);
+			}
+		private:
+			static constexpr const char* FALLBACK_VERTEX =
+				"#version 330 core\n"
+				"layout(location = 0) in vec3 position;\n"
+				"uniform mat4 transform;\n"
+				"void main() { gl_Position = transform * vec4(position, 1.0); }\n";
+			static constexpr const char* FALLBACK_FRAGMENT =
+				"#version 330 core\n"
+				"out vec4 color;\n"
+				"void main() { color = vec4(1.0, 0.0, 1.0, 1.0); }\n";
+			void finish(job_t& job) {
+				GLint linked = GL_FALSE;
+				glGetProgramiv(job.program, GL_LINK_STATUS, &linked);
+				if (linked) {
+					if (job.cache)
+						job.cache->store(job.key, job.program);
+					job.state = state_t::ready;
+					stats.linked++;
+				}
+				else {
+					for (const GLuint shader : job.shaders) {
+						GLint compiled = GL_FALSE;
+						glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+						if (!compiled)
+							job.error += "shader error:\n" + info_log(shader, glGetShaderiv, glGetShaderInfoLog);
+					}
+					job.error += "link error:\n" + info_log(job.program, glGetProgramiv, glGetProgramInfoLog);
+					glDeleteProgram(job.program);
+					job.program = 0;
+					job.state = state_t::failed;
+					stats.failed++;
+				}
+				for (const GLuint shader : job.shaders)
+					glDeleteShader(shader); //linked or not they're no use now
+				job.shaders.clear();
+			}
+			template<class GetT, class LogT>
+			static std::string info_log(GLuint object, GetT get, LogT log) {
+				GLint length = 0;
+				get(object, GL_INFO_LOG_LENGTH, &length);
+				std::string out(static_cast<size_t>(std::max(length, 1)), '\0');
+				GLsizei written = 0;
+				log(object, static_cast<GLsizei>(out.size()), &written, out.data());
+				out.resize(static_cast<size_t>(written));
+				if (!out.empty() && out.back() != '\n')
+					out += '\n';
+				return out;
+			}
+			bool _parallel = false;
+			std::vector<std::shared_ptr<job_t>> _jobs;
+			bool _fallback = false;
+			GLuint _fallback_program = 0;
+			GLint _fallback_transform = -1;
+		};
+	}
+}
@@ -0,0 +1,293 @@
+#pragma once
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include "../../glew/glew.h"
+namespace foton::GL {
+	/*
+		shadow copy of the bindings of the context current on this thread, every glBind*, glActiveTexture and glUseProgram
+		in foton goes through it so binding what's already bound costs nothing (counted in stats_t::elided)
+
+		the *_bind_t wrappers only bind back to 0 on scope exit when UNBIND_ON_EXIT (debug builds), in release the last thing bound
+		stays bound until something else replaces it, so drawing N objects costs N binds per type instead of 2N
+		except where a leftover binding changes what later GL calls do: framebuffers (rendering would keep going to the fbo)
+		and pixel pack/unpack buffers (client pointers would turn into buffer offsets) always get unbound,
+		and binding an element array buffer with no vao_bind_t open unbinds the leftover vao first so it can't take the buffer
+
+		the shadow starts out unknown, so the first bind of everything always goes through
+		deleting something bound unbinds it in GL, the wrappers' destructors call forget_*() to match,
+		code outside foton that binds things itself needs an invalidate() afterwards
+		validate_binds checks every elided bind against glGet* and throws if the shadow was wrong, it's slow (a sync per bind), for debugging
+	*/
+	struct state_cache_t {
+		struct state_cache_error_t : std::logic_error {
+			state_cache_error_t(const std::string& what) : std::logic_error(what) {}
+		};
+		struct stats_t {
+			size_t binds = 0; //reached GL
+			size_t elided = 0; //already bound, dropped
+		};
+		static constexpr GLuint UNKNOWN = static_cast<GLuint>(-1);
+#ifdef _DEBUG
+		static constexpr bool UNBIND_ON_EXIT = true;
+#else
+		static constexpr bool UNBIND_ON_EXIT = false;
+#endif
+		static constexpr GLuint TEXTURE_UNITS = 32;
+		stats_t stats;
+		bool validate_binds = false;
+
+		state_cache_t() {
+			invalidate();
+		}
+
+		//the cache of the context current on this thread, one context per thread like GL itself
+		static state_cache_t& current() {
+			thread_local state_cache_t cache;
+			return cache;
+		}
+		void use_program(GLuint program) {
+			if (!elide(_program, program, GL_CURRENT_PROGRAM))
+				glUseProgram(program);
+		}
+		void bind_vertex_array(GLuint vao) {
+			if (elide(_vertex_array, vao, GL_VERTEX_ARRAY_BINDING))
+				return;
+			glBindVertexArray(vao);
+			_buffers[buffer_slot(GL_ELEMENT_ARRAY_BUFFER)] = UNKNOWN; //belongs to the vao
+		}
+		void bind_buffer(GLenum target, GLuint buffer) {
+			if (target == GL_ELEMENT_ARRAY_BUFFER && _vertex_array_scopes == 0 && _vertex_array != 0)
+				bind_vertex_array(0);
+			const int slot = buffer_slot(target);
+			if (slot < 0) {
+				stats.binds++;
+				glBindBuffer(target, buffer);
+				return;
+			}
+			if (!elide(_buffers[slot], buffer, buffer_binding_query(target)))
+				glBindBuffer(target, buffer);
+		}
+		//scope exit of a buffer_bind_t
+		void unbind_buffer(GLenum target) {
+			if (UNBIND_ON_EXIT || target == GL_PIXEL_PACK_BUFFER || target == GL_PIXEL_UNPACK_BUFFER)
+				bind_buffer(target, 0);
+		}
+		//never elided (the range is part of the indexed binding), the generic binding it also changes gets tracked
+		void bind_buffer_range(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+			stats.binds++;
+			glBindBufferRange(target, index, buffer, offset, size);
+			if (const int slot = buffer_slot(target); slot >= 0)
+				_buffers[slot] = buffer;
+		}
+		void active_texture(GLuint unit) {
+			if (unit >= TEXTURE_UNITS)
+				throw state_cache_error_t("texture unit " + std::to_string(unit) + " is past the ones the cache tracks");
+			if (!elide(_active_unit, unit, GL_ACTIVE_TEXTURE, GL_TEXTURE0))
+				glActiveTexture(GL_TEXTURE0 + unit);
+		}
+		//on the active unit
+		void bind_texture(GLenum target, GLuint texture) {
+			const int slot = texture_slot(target);
+			if (slot < 0 || _active_unit == UNKNOWN) {
+				stats.binds++;
+				glBindTexture(target, texture);
+				return;
+			}
+			if (!elide(_textures[_active_unit][slot], texture, texture_binding_query(target)))
+				glBindTexture(target, texture);
+		}
+		void bind_texture(GLuint unit, GLenum target, GLuint texture) {
+			active_texture(unit);
+			bind_texture(target, texture);
+		}
+		//GL_FRAMEBUFFER sets both the draw and the read binding
+		void bind_framebuffer(GLenum target, GLuint framebuffer) {
+			if (target == GL_DRAW_FRAMEBUFFER) {
+				if (!elide(_draw_framebuffer, framebuffer, GL_DRAW_FRAMEBUFFER_BINDING))
+					glBindFramebuffer(target, framebuffer);
+				return;
+			}
+			if (target == GL_READ_FRAMEBUFFER) {
+				if (!elide(_read_framebuffer, framebuffer, GL_READ_FRAMEBUFFER_BINDING))
+					glBindFramebuffer(target, framebuffer);
+				return;
+			}
+			if (_read_framebuffer == framebuffer && elide(_draw_framebuffer, framebuffer, GL_DRAW_FRAMEBUFFER_BINDING))
+				return;
+			_draw_framebuffer = _read_framebuffer = framebuffer;
+			stats.binds++;
+			glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		}
+		void bind_renderbuffer(GLuint renderbuffer) {
+			if (!elide(_renderbuffer, renderbuffer, GL_RENDERBUFFER_BINDING))
+				glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+		}
+		//vao_bind_t lifetimes, element array binds inside one are meant for that vao
+		void enter_vertex_array_scope() {
+			_vertex_array_scopes++;
+		}
+		void leave_vertex_array_scope() {
+			_vertex_array_scopes--;
+		}
+
+		//after glDelete*, GL drops the deleted name from every binding of the current context and can hand it out again
+		void forget_program(GLuint program) {
+			if (_program == program)
+				_program = UNKNOWN; //a program in use stays in use until something else is
+		}
+		void forget_vertex_array(GLuint vao) {
+			if (_vertex_array == vao)
+				_vertex_array = 0;
+		}
+		void forget_buffer(GLuint buffer) {
+			for (GLuint& bound : _buffers) {
+				if (bound == buffer)
+					bound = 0;
+			}
+		}
+		void forget_texture(GLuint texture) {
+			for (auto& unit : _textures) {
+				for (GLuint& bound : unit) {
+					if (bound == texture)
+						bound = 0;
+				}
+			}
+		}
+		void forget_framebuffer(GLuint framebuffer) {
+			if (_draw_framebuffer == framebuffer)
+				_draw_framebuffer = 0;
+			if (_read_framebuffer == framebuffer)
+				_read_framebuffer = 0;
+		}
+		void forget_renderbuffer(GLuint renderbuffer) {
+			if (_renderbuffer == renderbuffer)
+				_renderbuffer = 0;
+		}
+		//everything unknown again, for after code that binds behind the cache's back
+		void invalidate() {
+			_program = _vertex_array = _active_unit = _draw_framebuffer = _read_framebuffer = _renderbuffer = UNKNOWN;
+			for (GLuint& bound : _buffers)
+				bound = UNKNOWN;
+			for (auto& unit : _textures) {
+				for (GLuint& bound : unit)
+					bound = UNKNOWN;
+			}
+		}
+		//compares every known binding with glGet*, throws on the first mismatch. leaves the active texture unit as it found it
+		void validate() const {
+			check(_program, GL_CURRENT_PROGRAM);
+			check(_vertex_array, GL_VERTEX_ARRAY_BINDING);
+			for (int slot = 0; slot < BUFFER_TARGETS; slot++)
+				check(_buffers[slot], buffer_binding_query(BUFFER_TARGET_LIST[slot]));
+			check(_draw_framebuffer, GL_DRAW_FRAMEBUFFER_BINDING);
+			check(_read_framebuffer, GL_READ_FRAMEBUFFER_BINDING);
+			check(_renderbuffer, GL_RENDERBUFFER_BINDING);
+			if (_active_unit == UNKNOWN)
+				return;
+			check(_active_unit, GL_ACTIVE_TEXTURE, GL_TEXTURE0);
+			for (GLuint unit = 0; unit < TEXTURE_UNITS; unit++) {
+				glActiveTexture(GL_TEXTURE0 + unit);
+				for (int slot = 0; slot < TEXTURE_TARGETS; slot++)
+					check(_textures[unit][slot], texture_binding_query(TEXTURE_TARGET_LIST[slot]));
+			}
+			glActiveTexture(GL_TEXTURE0 + _active_unit);
+		}
+	private:
+		static constexpr int BUFFER_TARGETS = 13;
+		static constexpr GLenum BUFFER_TARGET_LIST[BUFFER_TARGETS] = {
+			GL_ARRAY_BUFFER, GL_ATOMIC_COUNTER_BUFFER, GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, GL_DISPATCH_INDIRECT_BUFFER,
+			GL_DRAW_INDIRECT_BUFFER, GL_ELEMENT_ARRAY_BUFFER, GL_PIXEL_PACK_BUFFER, GL_PIXEL_UNPACK_BUFFER, GL_SHADER_STORAGE_BUFFER,
+			GL_TEXTURE_BUFFER, GL_TRANSFORM_FEEDBACK_BUFFER, GL_UNIFORM_BUFFER
+		};
+		static constexpr int TEXTURE_TARGETS = 4;
+		static constexpr GLenum TEXTURE_TARGET_LIST[TEXTURE_TARGETS] = { GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_3D };
+		//-1 for targets the cache doesn't know, those always reach GL
+		static int buffer_slot(GLenum target) {
+			for (int slot = 0; slot < BUFFER_TARGETS; slot++) {
+				if (BUFFER_TARGET_LIST[slot] == target)
+					return slot;
+			}
+			return -1;
+		}
+		static int texture_slot(GLenum target) {
+			for (int slot = 0; slot < TEXTURE_TARGETS; slot++) {
+				if (TEXTURE_TARGET_LIST[slot] == target)
+					return slot;
+			}
+			return -1;
+		}
+		static GLenum buffer_binding_query(GLenum target) {
+			switch (target) {
+			case GL_ARRAY_BUFFER:
+				return GL_ARRAY_BUFFER_BINDING;
+			case GL_ATOMIC_COUNTER_BUFFER:
+				return GL_ATOMIC_COUNTER_BUFFER_BINDING;
+			case GL_COPY_READ_BUFFER:
+				return GL_COPY_READ_BUFFER_BINDING;
+			case GL_COPY_WRITE_BUFFER:
+				return GL_COPY_WRITE_BUFFER_BINDING;
+			case GL_DISPATCH_INDIRECT_BUFFER:
+				return GL_DISPATCH_INDIRECT_BUFFER_BINDING;
+			case GL_DRAW_INDIRECT_BUFFER:
+				return GL_DRAW_INDIRECT_BUFFER_BINDING;
+			case GL_ELEMENT_ARRAY_BUFFER:
+				return GL_ELEMENT_ARRAY_BUFFER_BINDING;
+			case GL_PIXEL_PACK_BUFFER:
+				return GL_PIXEL_PACK_BUFFER_BINDING;
+			case GL_PIXEL_UNPACK_BUFFER:
+				return GL_PIXEL_UNPACK_BUFFER_BINDING;
+			case GL_SHADER_STORAGE_BUFFER:
+				return GL_SHADER_STORAGE_BUFFER_BINDING;
+			case GL_TEXTURE_BUFFER:
+				return GL_TEXTURE_BUFFER_BINDING;
+			case GL_TRANSFORM_FEEDBACK_BUFFER:
+				return GL_TRANSFORM_FEEDBACK_BUFFER_BINDING;
+			default:
+				return GL_UNIFORM_BUFFER_BINDING;
+			}
+		}
+		static GLenum texture_binding_query(GLenum target) {
+			switch (target) {
+			case GL_TEXTURE_2D_ARRAY:
+				return GL_TEXTURE_BINDING_2D_ARRAY;
+			case GL_TEXTURE_CUBE_MAP:
+				return GL_TEXTURE_BINDING_CUBE_MAP;
+			case GL_TEXTURE_3D:
+				return GL_TEXTURE_BINDING_3D;
+			default:
+				return GL_TEXTURE_BINDING_2D;
+			}
+		}
+		//true when 'value' is already bound, otherwise records it and the caller makes the GL call
+		bool elide(GLuint& shadow, GLuint value, GLenum query, GLuint query_base = 0) {
+			if (shadow == value) {
+				stats.elided++;
+				if (validate_binds)
+					check(shadow, query, query_base);
+				return true;
+			}
+			shadow = value;
+			stats.binds++;
+			return false;
+		}
+		static void check(GLuint shadow, GLenum query, GLuint query_base = 0) {
+			if (shadow == UNKNOWN)
+				return;
+			GLint actual = 0;
+			glGetIntegerv(query, &actual);
+			if (static_cast<GLuint>(actual) - query_base != shadow)
+				throw state_cache_error_t("state cache thinks binding " + std::to_string(query) + " is " + std::to_string(shadow)
+					+ ", GL has " + std::to_string(static_cast<GLuint>(actual) - query_base));
+		}
+		GLuint _program = UNKNOWN;
+		GLuint _vertex_array = UNKNOWN;
+		GLuint _buffers[BUFFER_TARGETS];
+		GLuint _active_unit = UNKNOWN;
+		GLuint _textures[TEXTURE_UNITS][TEXTURE_TARGETS];
+		GLuint _draw_framebuffer = UNKNOWN;
+		GLuint _read_framebuffer = UNKNOWN;
+		GLuint _renderbuffer = UNKNOWN;
+		int _vertex_array_scopes = 0;
+	};
+}
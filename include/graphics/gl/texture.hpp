@@ -1,42 +1,87 @@
 #pragma once
+#include <algorithm>
 #include "../../glew/glew.h"
 #include "../../mutex.hpp"
 #include "../../exceptions.hpp"
+#include "state_cache.hpp"
+#include "../../texture/image.hpp"
 namespace foton::GL {
 	struct texture_t {
 		struct texture_bind_t {
 
 			static void activate_unit(GLsizei unit) {
-				glActiveTexture(GL_TEXTURE0 + unit);
+				state_cache_t::current().active_texture(unit);
 			}
 			texture_t& parent() {
 				return *_parent;
 			}
 			texture_bind_t(texture_t& parent) : _parent(&parent), _lock(_mutex) {
-				glBindTexture(_target, parent._id);
+				state_cache_t::current().bind_texture(_target, parent._id);
 			}
 			bool valid() const {
 				return _parent != nullptr && _lock.owns_lock();
 			}
 			~texture_bind_t() {
-				if (_parent != nullptr && valid())
-					glBindTexture(_target, 0);
+				if (state_cache_t::UNBIND_ON_EXIT && _parent != nullptr && valid())
+					state_cache_t::current().bind_texture(_target, 0);
 			}
 			void dont_unbind() {
 				_parent = nullptr;
 			}
+			//for code that binds textures itself for a whole pass (render_queue_t) instead of per draw
+			static thread_mutex_t& mutex() {
+				return _mutex;
+			}
+			//mutable level 0 only, a texture with allocate_storage() can't be re-specified
 			void upload(const uint8_t* pixels, GLsizei width, GLsizei height, GLint internal_format = GL_RGB, GLint format = GL_RGB, GLenum type = GL_FLOAT) {
+#ifdef _DEBUG
+				if (parent()._immutable)
+					throw exceptions::gl_error_t(0, "upload() on a texture with immutable storage");
+#endif
 				glTexImage2D(_target, 0, internal_format, width, height, 0, format, type, pixels);
 				parent().width() = width;
 				parent().height() = height;
+				parent()._levels = 1;
+			}
+			/*
+				immutable storage, every level allocated once with a sized internal format (GL_RGBA8, GL_SRGB8_ALPHA8,
+				a compressed format...), the driver never has to check the chain for completeness again
+				levels 0 means the full chain down to 1x1
+			*/
+			void allocate_storage(GLsizei width, GLsizei height, GLenum internal_format = GL_RGBA8, GLsizei levels = 0) {
+				if (parent()._immutable)
+					throw exceptions::gl_error_t(0, "texture storage is already allocated");
+				if (levels == 0)
+					levels = static_cast<GLsizei>(texture::mip_levels(static_cast<uint32_t>(width), static_cast<uint32_t>(height)));
+				glTexStorage2D(_target, levels, internal_format, width, height);
+				glTexParameteri(_target, GL_TEXTURE_MAX_LEVEL, levels - 1);
+				parent().width() = width;
+				parent().height() = height;
+				parent()._levels = levels;
+				parent()._immutable = true;
+			}
+			void upload_level(GLint level, const void* pixels, GLsizei width, GLsizei height, GLenum format = GL_RGBA, GLenum type = GL_UNSIGNED_BYTE) {
+				glTexSubImage2D(_target, level, 0, 0, width, height, format, type, pixels);
+			}
+			//'format' is the internal format the storage was allocated with, 'data' is whole blocks
+			void upload_compressed_level(GLint level, GLenum format, GLsizei width, GLsizei height, GLsizei size, const void* data) {
+				glCompressedTexSubImage2D(_target, level, 0, 0, width, height, format, size, data);
+			}
+			//fills levels 1+ from level 0 on the GPU, not for compressed formats
+			void generate_mipmaps() {
+				glGenerateMipmap(_target);
+			}
+			void set_filter(GLint min_filter = GL_LINEAR_MIPMAP_LINEAR, GLint mag_filter = GL_LINEAR) {
+				glTexParameteri(_target, GL_TEXTURE_MIN_FILTER, min_filter);
+				glTexParameteri(_target, GL_TEXTURE_MAG_FILTER, mag_filter);
 			}
 		protected:
 			texture_bind_t(texture_t& parent, std::unique_lock<thread_mutex_t> lock) :
 				_parent(&parent), _lock(std::move(lock)) {
-				if constexpr (_DEBUG) {
-					if (lock.mutex() != &_mutex && lock)
-						throw exceptions::gl_error_t(0, "texture bind created from invalid mutex");
-				}
+#ifdef _DEBUG
+				if (lock.mutex() != &_mutex && lock)
+					throw exceptions::gl_error_t(0, "texture bind created from invalid mutex");
+#endif
 			}
 
 			static constexpr GLenum _target = GL_TEXTURE_2D;
@@ -51,6 +96,12 @@ namespace foton::GL {
 		GLuint& height() {
 			return _height;
 		}
+		GLsizei levels() const {
+			return _levels;
+		}
+		bool immutable() const {
+			return _immutable;
+		}
 		texture_bind_t bind() {
 			return texture_bind_t(*this);
 		}
@@ -60,18 +111,21 @@ namespace foton::GL {
 		bool valid() const {
 			return _id != 0;
 		}
+		GLuint id() const {
+			return _id;
+		}
 
 		texture_bind_t activate(GLsizei texture_unit) {
 			if (texture_unit > 32)
 				throw exceptions::gl_error_t(texture_unit, "texture_unit too high");
 			auto lock = std::unique_lock<foton::thread_mutex_t>(texture_bind_t::_mutex);
-			glActiveTexture(GL_TEXTURE + texture_unit);
-			glBindTexture(GL_TEXTURE_2D, _id);
+			state_cache_t::current().bind_texture(texture_unit, GL_TEXTURE_2D, _id);
 			return texture_bind_t(*this, std::move(lock));
 		}
 		~texture_t() {
 			if (valid()) {
 				glDeleteTextures(1, &_id);
+				state_cache_t::current().forget_texture(_id);
 				_id = 0;
 			}
 		}
@@ -79,6 +133,8 @@ namespace foton::GL {
 		GLuint _id = 0;
 		GLuint _width = 0;
 		GLuint _height = 0;
+		GLsizei _levels = 0;
+		bool _immutable = false;
 	};
 }
 
@@ -0,0 +1,81 @@
+#pragma once
+#include <mutex>
+#include "buffer.hpp"
+#include "state_cache.hpp"
+#include "texture.hpp"
+namespace foton::GL {
+	/*
+		GL_TEXTURE_2D_ARRAY with immutable storage, 'layers' same sized images behind one texture name
+
+		a shader samples it as  uniform sampler2DArray  with texture(sampler, vec3(uv, layer)),
+		so draws that only differ in which layer they read can share every bind (see texture_pool_t)
+		binds go through the state cache under texture_t's bind mutex, same as every other texture
+	*/
+	struct texture_array_t {
+		static constexpr GLenum TARGET = GL_TEXTURE_2D_ARRAY;
+		texture_array_t(GLsizei width, GLsizei height, GLsizei layers, GLenum internal_format = GL_RGBA8, GLsizei levels = 1)
+			: _width(width), _height(height), _layers(layers), _levels(levels) {
+			glGenTextures(1, &_id);
+			std::lock_guard<thread_mutex_t> lock(texture_t::texture_bind_t::mutex());
+			state_cache_t& state = state_cache_t::current();
+			state.bind_texture(TARGET, _id);
+			glTexStorage3D(TARGET, levels, internal_format, width, height, layers);
+			glTexParameteri(TARGET, GL_TEXTURE_MAX_LEVEL, levels - 1);
+			glTexParameteri(TARGET, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+			glTexParameteri(TARGET, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(TARGET, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(TARGET, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			if (state_cache_t::UNBIND_ON_EXIT)
+				state.bind_texture(TARGET, 0);
+			check_gl_errors("after creating texture_array_t");
+		}
+		texture_array_t(const texture_array_t&) = delete;
+		texture_array_t& operator=(const texture_array_t&) = delete;
+		~texture_array_t() {
+			if (_id != 0) {
+				glDeleteTextures(1, &_id);
+				state_cache_t::current().forget_texture(_id);
+			}
+		}
+		//a sub rectangle of one layer at one level
+		void upload(GLint layer, GLint x, GLint y, GLsizei width, GLsizei height, const void* pixels, GLint level = 0,
+			GLenum format = GL_RGBA, GLenum type = GL_UNSIGNED_BYTE) {
+			std::lock_guard<thread_mutex_t> lock(texture_t::texture_bind_t::mutex());
+			state_cache_t& state = state_cache_t::current();
+			state.bind_texture(TARGET, _id);
+			glTexSubImage3D(TARGET, level, x, y, layer, width, height, 1, format, type, pixels);
+			if (state_cache_t::UNBIND_ON_EXIT)
+				state.bind_texture(TARGET, 0);
+		}
+		//every layer's chain from its level 0, blends neighbouring atlas rects unless they were packed mip safe
+		void generate_mipmaps() {
+			std::lock_guard<thread_mutex_t> lock(texture_t::texture_bind_t::mutex());
+			state_cache_t& state = state_cache_t::current();
+			state.bind_texture(TARGET, _id);
+			glGenerateMipmap(TARGET);
+			if (state_cache_t::UNBIND_ON_EXIT)
+				state.bind_texture(TARGET, 0);
+		}
+		GLuint id() const {
+			return _id;
+		}
+		GLsizei width() const {
+			return _width;
+		}
+		GLsizei height() const {
+			return _height;
+		}
+		GLsizei layers() const {
+			return _layers;
+		}
+		GLsizei levels() const {
+			return _levels;
+		}
+	private:
+		GLuint _id = 0;
+		GLsizei _width;
+		GLsizei _height;
+		GLsizei _layers;
+		GLsizei _levels;
+	};
+}
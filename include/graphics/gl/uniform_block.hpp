@@ -0,0 +1,307 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "buffer.hpp"
+#include "ring_buffer.hpp"
+#include "../../types.hpp"
+//compile time check that a block member sits where std140 (or the reflected layout) puts it
+#define FOTON_STD140_OFFSET(block, member, offset) \
+	static_assert(offsetof(block, member) == (offset), #block "::" #member " isn't at its std140 offset")
+namespace foton {
+	namespace GL {
+		/*
+			C++ side of std140 uniform blocks
+			scalars are plain float/int32_t/uint32_t (bool is a uint32_t), vectors and matrices below carry their std140 alignment,
+			so a struct written with them in GLSL order has the GLSL offsets without any manual padding
+
+			exceptions that still need a hand: a vec3_t always takes 16 bytes, GLSL packs a following scalar into its last 4
+			(use a vec4_t or let generate_std140_struct() emit the packed version), and arrays need array_t so each element is 16 aligned
+			put FOTON_STD140_OFFSET after a block to pin every member at compile time, generate_std140_struct() writes those too
+		*/
+		namespace std140 {
+			struct alignas(8) vec2_t {
+				float x = 0.f, y = 0.f;
+				vec2_t& operator=(const vec2f& v) {
+					x = v.x();
+					y = v.y();
+					return *this;
+				}
+			};
+			struct alignas(16) vec3_t {
+				float x = 0.f, y = 0.f, z = 0.f;
+				vec3_t& operator=(const vec3f& v) {
+					x = v.x();
+					y = v.y();
+					z = v.z();
+					return *this;
+				}
+			};
+			struct alignas(16) vec4_t {
+				float x = 0.f, y = 0.f, z = 0.f, w = 0.f;
+				vec4_t& operator=(const vec4f& v) {
+					x = v.x();
+					y = v.y();
+					z = v.z();
+					w = v.w();
+					return *this;
+				}
+			};
+			//column major like Eigen's default and GLSL
+			struct alignas(16) mat4_t {
+				float columns[16] = {};
+				mat4_t& operator=(const mat4f& m) {
+					std::copy(m.data(), m.data() + 16, columns);
+					return *this;
+				}
+			};
+			//every column padded to a vec4
+			struct alignas(16) mat3_t {
+				float columns[12] = {};
+				mat3_t& operator=(const mat3f& m) {
+					for (int c = 0; c < 3; c++)
+						std::copy(m.data() + 3 * c, m.data() + 3 * c + 3, columns + 4 * c);
+					return *this;
+				}
+			};
+			//array elements are rounded up to 16 bytes, whatever the element type
+			template<class T>
+			struct alignas(16) array_element_t {
+				T value;
+			};
+			template<class T, size_t N>
+			struct array_t {
+				array_element_t<T> elements[N];
+				T& operator[](size_t i) {
+					return elements[i].value;
+				}
+				const T& operator[](size_t i) const {
+					return elements[i].value;
+				}
+			};
+			static_assert(sizeof(vec2_t) == 8 && sizeof(vec3_t) == 16 && sizeof(vec4_t) == 16);
+			static_assert(sizeof(mat3_t) == 48 && sizeof(mat4_t) == 64);
+			static_assert(sizeof(array_t<float, 4>) == 64);
+			//what uniform_block_t accepts, the layout itself is up to FOTON_STD140_OFFSET
+			template<class BlockT>
+			static constexpr bool is_block_v = std::is_trivially_copyable_v<BlockT> && std::is_standard_layout_v<BlockT>;
+		}
+		//binding points shared by every program, shader_t binds blocks with these names to them after linking
+		namespace uniform_bindings {
+			static constexpr GLuint FRAME = 0;
+			static constexpr GLuint OBJECT = 1;
+			static constexpr const char* FRAME_BLOCK = "frame_block";
+			static constexpr const char* OBJECT_BLOCK = "object_block";
+		}
+		/*
+			layout(std140) uniform frame_block {
+				mat4 view_mat;
+				mat4 projection_mat;
+				mat4 view_projection_mat;
+				float time;
+			};
+		*/
+		struct frame_block_t {
+			std140::mat4_t view_mat;
+			std140::mat4_t projection_mat;
+			std140::mat4_t view_projection_mat;
+			float time = 0.f;
+		};
+		FOTON_STD140_OFFSET(frame_block_t, view_mat, 0);
+		FOTON_STD140_OFFSET(frame_block_t, projection_mat, 64);
+		FOTON_STD140_OFFSET(frame_block_t, view_projection_mat, 128);
+		FOTON_STD140_OFFSET(frame_block_t, time, 192);
+		/*
+			layout(std140) uniform object_block {
+				mat4 transform;
+			};
+			transform is model to world on every path (render_queue_t and object_t::draw_call), shaders take view_projection_mat from the frame_block
+		*/
+		struct object_block_t {
+			std140::mat4_t transform;
+		};
+		FOTON_STD140_OFFSET(object_block_t, transform, 0);
+
+		struct uniform_block_error_t : std::logic_error {
+			uniform_block_error_t(const std::string& what) : std::logic_error(what) {}
+		};
+		//an active uniform block of a linked program, as the driver laid it out
+		struct uniform_block_info_t {
+			struct member_t {
+				std::string name;
+				GLenum type = 0;
+				GLint offset = 0;
+				GLint array_size = 1;
+				GLint array_stride = 0;
+				GLint matrix_stride = 0;
+			};
+			std::string name;
+			GLuint index = GL_INVALID_INDEX;
+			GLint binding = 0;
+			GLint data_size = 0;
+			std::vector<member_t> members; //by offset
+		};
+		static std::vector<uniform_block_info_t> reflect_uniform_blocks(GLuint program) {
+			std::vector<uniform_block_info_t> out;
+			GLint block_count = 0;
+			glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &block_count);
+			char name[256];
+			for (GLuint b = 0; b < static_cast<GLuint>(block_count); b++) {
+				uniform_block_info_t block;
+				block.index = b;
+				GLsizei length = 0;
+				glGetActiveUniformBlockName(program, b, sizeof(name), &length, name);
+				block.name.assign(name, length);
+				glGetActiveUniformBlockiv(program, b, GL_UNIFORM_BLOCK_BINDING, &block.binding);
+				glGetActiveUniformBlockiv(program, b, GL_UNIFORM_BLOCK_DATA_SIZE, &block.data_size);
+				GLint member_count = 0;
+				glGetActiveUniformBlockiv(program, b, GL_UNIFORM_BLOCK_ACTIVE_UNIFORMS, &member_count);
+				std::vector<GLint> indices(member_count);
+				if (member_count > 0)
+					glGetActiveUniformBlockiv(program, b, GL_UNIFORM_BLOCK_ACTIVE_UNIFORM_INDICES, indices.data());
+				const std::vector<GLuint> uniforms(indices.begin(), indices.end());
+				auto query = [&](GLenum what) {
+					std::vector<GLint> values(member_count);
+					if (member_count > 0)
+						glGetActiveUniformsiv(program, member_count, uniforms.data(), what, values.data());
+					return values;
+				};
+				const std::vector<GLint> types = query(GL_UNIFORM_TYPE);
+				const std::vector<GLint> offsets = query(GL_UNIFORM_OFFSET);
+				const std::vector<GLint> sizes = query(GL_UNIFORM_SIZE);
+				const std::vector<GLint> array_strides = query(GL_UNIFORM_ARRAY_STRIDE);
+				const std::vector<GLint> matrix_strides = query(GL_UNIFORM_MATRIX_STRIDE);
+				for (GLint m = 0; m < member_count; m++) {
+					uniform_block_info_t::member_t member;
+					glGetActiveUniformName(program, uniforms[m], sizeof(name), &length, name);
+					member.name.assign(name, length);
+					if (const size_t bracket = member.name.find('['); bracket != std::string::npos)
+						member.name.resize(bracket); //arrays are reported as "name[0]"
+					if (const size_t dot = member.name.rfind('.'); dot != std::string::npos)
+						member.name.erase(0, dot + 1); //"block.name" when the block has an instance name
+					member.type = static_cast<GLenum>(types[m]);
+					member.offset = offsets[m];
+					member.array_size = sizes[m];
+					member.array_stride = array_strides[m];
+					member.matrix_stride = matrix_strides[m];
+					block.members.push_back(std::move(member));
+				}
+				std::sort(block.members.begin(), block.members.end(), [](const auto& a, const auto& b) {
+					return a.offset < b.offset;
+				});
+				out.push_back(std::move(block));
+			}
+			return out;
+		}
+		/*
+			C++ source of a struct matching 'block' byte for byte, with a FOTON_STD140_OFFSET per member and a size check
+			meant to be run once against a linked program and pasted into a header, so the layout is checked at compile time from then on
+		*/
+		static std::string generate_std140_struct(const uniform_block_info_t& block, const std::string& struct_name) {
+			struct cpp_type_t {
+				const char* name;
+				GLint size;
+				GLint alignment;
+			};
+			auto cpp_type = [](GLenum type) -> cpp_type_t {
+				switch (type) {
+				case GL_FLOAT:
+					return { "float", 4, 4 };
+				case GL_INT:
+					return { "int32_t", 4, 4 };
+				case GL_UNSIGNED_INT:
+				case GL_BOOL:
+					return { "uint32_t", 4, 4 };
+				case GL_FLOAT_VEC2:
+					return { "std140::vec2_t", 8, 8 };
+				case GL_FLOAT_VEC3:
+					return { "std140::vec3_t", 16, 16 };
+				case GL_FLOAT_VEC4:
+					return { "std140::vec4_t", 16, 16 };
+				case GL_FLOAT_MAT3:
+					return { "std140::mat3_t", 48, 16 };
+				case GL_FLOAT_MAT4:
+					return { "std140::mat4_t", 64, 16 };
+				default:
+					throw uniform_block_error_t("no std140 type for uniform type " + std::to_string(type));
+				}
+			};
+			std::string out = "struct " + struct_name + " {\n";
+			std::string checks;
+			GLint at = 0; //end of the previous member on the C++ side
+			for (size_t m = 0; m < block.members.size(); m++) {
+				const auto& member = block.members[m];
+				const GLint next = m + 1 < block.members.size() ? block.members[m + 1].offset : block.data_size;
+				cpp_type_t type = cpp_type(member.type);
+				std::string declarator = member.name;
+				if (member.array_size > 1)
+					type = { nullptr, member.array_stride * member.array_size, 16 };
+				else if (member.type == GL_FLOAT_VEC3 && next - member.offset < 16) {
+					type = { "float", 12, 4 }; //a scalar lives in its last 4 bytes, the 16 byte vec3_t would push it out
+					declarator += "[3]";
+				}
+				const GLint aligned = (at + type.alignment - 1) / type.alignment * type.alignment;
+				if (member.offset != aligned)
+					out += "\tuint8_t _pad" + std::to_string(at) + "[" + std::to_string(member.offset - at) + "];\n";
+				if (member.array_size > 1)
+					out += "\tstd140::array_t<" + std::string(cpp_type(member.type).name) + ", " + std::to_string(member.array_size) + "> " + declarator + ";\n";
+				else
+					out += "\t" + std::string(type.name) + " " + declarator + ";\n";
+				checks += "FOTON_STD140_OFFSET(" + struct_name + ", " + member.name + ", " + std::to_string(member.offset) + ");\n";
+				at = member.offset + type.size;
+			}
+			if (at < block.data_size)
+				out += "\tuint8_t _pad" + std::to_string(at) + "[" + std::to_string(block.data_size - at) + "];\n";
+			out += "};\n" + checks;
+			out += "static_assert(sizeof(" + struct_name + ") >= " + std::to_string(block.data_size) + ");\n";
+			return out;
+		}
+		//throws when BlockT is smaller than the program's 'name' block, a mismatch the static checks can't see if the GLSL changed
+		template<class BlockT>
+		static void check_uniform_block(GLuint program, const char* name) {
+			const GLuint index = glGetUniformBlockIndex(program, name);
+			if (index == GL_INVALID_INDEX)
+				return;
+			GLint data_size = 0;
+			glGetActiveUniformBlockiv(program, index, GL_UNIFORM_BLOCK_DATA_SIZE, &data_size);
+			if (static_cast<size_t>(data_size) > sizeof(BlockT))
+				throw uniform_block_error_t(std::string("uniform block ") + name + " is " + std::to_string(data_size) + " bytes, the C++ struct only " + std::to_string(sizeof(BlockT)));
+		}
+		/*
+			CPU copy of a block, upload() writes all of it at once and binds it to 'binding' with glBindBufferRange,
+			so changing any number of members costs one buffer write instead of a glProgramUniform each
+
+			with 'stream' set (a GL_UNIFORM_BUFFER ring_buffer_t) every upload() gets its own slice of the frame's region,
+			uploading several times a frame (once per object) is fine. without it the block owns a buffer that gets re-specified,
+			letting the driver hand out new storage rather than wait on draws still reading the old one
+		*/
+		template<class BlockT>
+		struct uniform_block_t {
+			static_assert(std140::is_block_v<BlockT>, "uniform blocks have to be trivially copyable standard layout structs");
+			BlockT data{};
+			GLuint binding;
+			ring_buffer_t* stream = nullptr;
+			explicit uniform_block_t(GLuint binding) : binding(binding) {}
+			void upload() {
+				if (stream) {
+					if (const auto allocation = stream->allocate_uniform<BlockT>()) {
+						allocation.data[0] = data;
+						stream->bind_range(binding, allocation);
+						return;
+					}
+				}
+				if (!_buffer)
+					_buffer.emplace(GL_UNIFORM_BUFFER);
+				_buffer->upload_objects(&data, 1, GL_STREAM_DRAW);
+				state_cache_t::current().bind_buffer_range(GL_UNIFORM_BUFFER, binding, _buffer->buffer_id(), 0, sizeof(BlockT));
+			}
+		private:
+			std::optional<buffer_t> _buffer; //created on first use, needs a context
+		};
+	}
+}
@@ -1,5 +1,11 @@
 #pragma once
+#include <cstddef>
+#include <span>
+#include <vector>
 #include "vbo.hpp"
+#include "vertex_format.hpp"
+#include "../../types.hpp"
+#include "../../model/index_codec.hpp"
 #include "../../containers/dynamic_vector.hpp"
 namespace foton::GL {
 		struct vao_t {
@@ -7,6 +13,7 @@ namespace foton::GL {
 				GLuint offset;
 				GLuint index;
 				GLuint stride;
+				GLuint divisor = 0; //0 advances per vertex, n advances once every n instances
 			};
 			static_assert(std::is_trivially_copyable_v<va_location_t>, "we are putting this in a union, so it gotta be trivally");
 			struct ebo_info_t {
@@ -46,7 +53,7 @@ namespace foton::GL {
 					void draw(GLsizei element_count, GLsizei offset = 0) {
 						if ((element_count + offset) > parent().count())
 							throw ("elements out of range");
-						glDrawElements(parent().draw_shape, element_count, typed_buffer_t<T>::gl_type(), (const void*)(offset));
+						glDrawElements(parent().draw_shape, element_count, typed_buffer_t<T>::gl_type(), (const void*)(offset * sizeof(T)));
 					}
 				};
 				
@@ -59,15 +66,19 @@ namespace foton::GL {
 			struct vao_bind_t {
 				static thread_mutex_t _mutex;
 				vao_bind_t(GLuint id, vao_t& parent) : _id(id), _lock(_mutex), _parent(parent) {
-					glBindVertexArray(id);
+					state_cache_t::current().bind_vertex_array(id);
+					state_cache_t::current().enter_vertex_array_scope();
 				}
 				vao_bind_t(const vao_bind_t&) = delete;
 				vao_bind_t(vao_bind_t&& other) : _id(other._id), _lock(std::move(other._lock)), _parent(other._parent) {
 					other._id = 0;
 				}
 				~vao_bind_t() {
-					if (_id != 0 && _lock.owns_lock())
-						glBindVertexArray(0); //Unbind itself (maybe not needed)
+					if (!_lock.owns_lock())
+						return;
+					state_cache_t::current().leave_vertex_array_scope();
+					if (state_cache_t::UNBIND_ON_EXIT && _id != 0)
+						state_cache_t::current().bind_vertex_array(0);
 				}
 				operator GLuint() const {
 					return _id;
@@ -78,6 +89,7 @@ namespace foton::GL {
 					auto bind = va.bind();
 					glVertexAttribPointer(va.index, va.amount_per_element(), va.gl_type(), GL_FALSE, va.stride, ((const void*)offset)); //cast to void point is on purpose
 					glEnableVertexAttribArray(va.index);
+					glVertexAttribDivisor(va.index, va.divisor);
 					check_gl_errors("after assigning vertex attribute");
 				}
 
@@ -94,6 +106,105 @@ namespace foton::GL {
 					assign_vertex_attribute(va);
 					return va;
 				}
+				/*
+					one vbo of interleaved VertexT feeding the position, normal and texture coord attributes
+					instead of a vbo (and a bind) per attribute, the layout comes from vertex_format_t<VertexT>
+				*/
+				template<class VertexT>
+				vbo_t<VertexT>& emplace_vertices(const VertexT* vertices, GLsizei count, GLenum usage = GL_STATIC_DRAW,
+					GLuint position_index = 0, GLuint normal_index = 1, GLuint texture_coords_index = 2) {
+					_parent._buffers.emplace_back(vao_any_buffer_t{ vbo_t<VertexT>(vertices, count, usage), vao_buffer_info_t{ _parent._draw_shapes, {} } });
+					vbo_t<VertexT>& vbo = *reinterpret_cast<vbo_t<VertexT>*>(&*(_parent._buffers.end() - 1));
+					auto bind = vbo.bind();
+					auto attribute = [](GLuint index, const vertex_attribute_t& a) {
+						glVertexAttribPointer(index, a.components, a.type, a.normalized, sizeof(VertexT), reinterpret_cast<const void*>(a.offset));
+						glEnableVertexAttribArray(index);
+					};
+					using format_t = vertex_format_t<VertexT>;
+					attribute(position_index, format_t::position);
+					attribute(normal_index, format_t::normal);
+					attribute(texture_coords_index, format_t::texture_coords);
+					check_gl_errors("after assigning interleaved vertex attributes");
+					return vbo;
+				}
+				vbo_t<vertex_t>& emplace_interleaved_vertices(const vertex_t* vertices, GLsizei count, GLenum usage = GL_STATIC_DRAW,
+					GLuint position_index = 0, GLuint normal_index = 1, GLuint texture_coords_index = 2) {
+					return emplace_vertices(vertices, count, usage, position_index, normal_index, texture_coords_index);
+				}
+				//16 or 12 byte vertices, the shader has to apply quantization.dequantize_matrix() and unfold the octahedral normals
+				template<class PackedT>
+				vbo_t<PackedT>& emplace_quantized_vertices(const model::quantized_mesh_t<PackedT>& mesh, GLenum usage = GL_STATIC_DRAW,
+					GLuint position_index = 0, GLuint normal_index = 1, GLuint texture_coords_index = 2) {
+					return emplace_vertices(mesh.vertices.data(), static_cast<GLsizei>(mesh.vertices.size()), usage, position_index, normal_index, texture_coords_index);
+				}
+				//a transform per instance at locations first_index..first_index + 3 for draw_elements_instanced
+				vbo_t<instance_matrix_t>& emplace_instance_matrices(const instance_matrix_t* instances, GLsizei count, GLuint first_index, GLenum usage = GL_DYNAMIC_DRAW) {
+					_parent._buffers.emplace_back(vao_any_buffer_t{ vbo_t<instance_matrix_t>(instances, count, usage), vao_buffer_info_t{ _parent._draw_shapes, {} } });
+					vbo_t<instance_matrix_t>& vbo = *reinterpret_cast<vbo_t<instance_matrix_t>*>(&*(_parent._buffers.end() - 1));
+					auto bind = vbo.bind();
+					instance_matrix_attributes(first_index);
+					check_gl_errors("after assigning instance attributes");
+					return vbo;
+				}
+				/*
+					uploads the indices as uint16_t when the vertex count allows it (half the memory and fetch bandwidth)
+					and uint32_t otherwise, draw_elements() then uses whichever type got picked
+				*/
+				GLenum emplace_indices(std::span<const model::index_t> indices, size_t vertex_count, GLenum usage = GL_STATIC_DRAW) {
+					const GLsizei count = static_cast<GLsizei>(indices.size());
+					GLuint ebo_id;
+					if (model::index_codec::fits_16bit(vertex_count)) {
+						const std::vector<uint16_t> narrow = model::index_codec::narrow(indices);
+						ebo_id = emplace_ebo<uint16_t>(typed_buffer_t<uint16_t>(GL_ELEMENT_ARRAY_BUFFER, narrow.data(), count, usage)).buffer_id();
+						_parent._index_type = GL_UNSIGNED_SHORT;
+					}
+					else {
+						ebo_id = emplace_ebo<uint32_t>(typed_buffer_t<uint32_t>(GL_ELEMENT_ARRAY_BUFFER, indices.data(), count, usage)).buffer_id();
+						_parent._index_type = GL_UNSIGNED_INT;
+					}
+					_parent._index_count = count;
+					//the element array binding is vao state, so it gets bound here and left bound (buffer_bind_t would unbind it)
+					std::lock_guard<thread_mutex_t> lock(buffer_locks::element_array);
+					state_cache_t::current().bind_buffer(GL_ELEMENT_ARRAY_BUFFER, ebo_id);
+					check_gl_errors("after attaching indices");
+					return _parent._index_type;
+				}
+				/*
+					an empty ebo of 'capacity' IndexT for filling piece by piece with upload_indices (geometry_pool_t),
+					draw_elements() only sees the indices once _index_count covers them, so it's left at 0
+				*/
+				template<class IndexT>
+				ebo_t<IndexT>& emplace_index_storage(GLsizei capacity, GLenum usage = GL_STATIC_DRAW) {
+					ebo_t<IndexT>& ebo = emplace_ebo<IndexT>(typed_buffer_t<IndexT>(GL_ELEMENT_ARRAY_BUFFER, nullptr, capacity, usage));
+					_parent._index_type = typed_buffer_t<IndexT>::gl_type();
+					_parent._index_count = 0;
+					std::lock_guard<thread_mutex_t> lock(buffer_locks::element_array);
+					state_cache_t::current().bind_buffer(GL_ELEMENT_ARRAY_BUFFER, ebo.buffer_id());
+					check_gl_errors("after attaching index storage");
+					return ebo;
+				}
+				//writes into the attached ebo through the vao's binding (a buffer_bind_t would unbind it from the vao)
+				template<class IndexT>
+				void upload_indices(const IndexT* indices, GLsizei count, size_t first) {
+					std::lock_guard<thread_mutex_t> lock(buffer_locks::element_array);
+					glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, first * sizeof(IndexT), count * sizeof(IndexT), indices);
+				}
+				//'count' indices starting at index 'first' from emplace_indices, count < 0 is everything after 'first'
+				void draw_elements(GLsizei count = -1, GLsizei first = 0) {
+					if (count < 0)
+						count = _parent._index_count - first;
+					if (first < 0 || first + count > _parent._index_count)
+						throw std::out_of_range("elements out of range");
+					glDrawElements(_parent._draw_shapes, count, _parent._index_type, reinterpret_cast<const void*>(first * gl_type_size(_parent._index_type)));
+				}
+				//same as draw_elements, 'instances' times, per instance attributes (divisor != 0) advance between them
+				void draw_elements_instanced(GLsizei instances, GLsizei count = -1, GLsizei first = 0) {
+					if (count < 0)
+						count = _parent._index_count - first;
+					if (first < 0 || first + count > _parent._index_count)
+						throw std::out_of_range("elements out of range");
+					glDrawElementsInstanced(_parent._draw_shapes, count, _parent._index_type, reinterpret_cast<const void*>(first * gl_type_size(_parent._index_type)), instances);
+				}
 				template<class T, class... Args> ebo_t<T>& emplace_ebo(Args&& ... args) {
 					{
 						ebo_t<T> ebo = { std::forward<Args>(args)..., {} };
@@ -114,11 +225,25 @@ namespace foton::GL {
 			vao_t() {
 				glGenVertexArrays(1, &_id);
 			}
+			GLuint id() const {
+				return _id;
+			}
+			//from the last vao_bind_t::emplace_indices
+			GLenum index_type() const {
+				return _index_type;
+			}
+			GLsizei index_count() const {
+				return _index_count;
+			}
 		private:
 			dynamic_vector_t<vao_any_buffer_t> _buffers;
 			GLuint _id;
 			GLenum _draw_shapes = GL_TRIANGLES;
+			GLenum _index_type = GL_UNSIGNED_INT;
+			GLsizei _index_count = 0;
 
 
 		};
 	}
+
+foton::thread_mutex_t foton::GL::vao_t::vao_bind_t::_mutex = {};
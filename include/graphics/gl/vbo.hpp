@@ -9,6 +9,9 @@ namespace foton {
 			vbo_t(const T* data, GLsizei count, GLenum usage = GL_STATIC_DRAW) : vbo_t() {
 				typed_buffer_t<T>::upload(data, count, usage);
 			}
+			vbo_t(std::span<const T> data, GLenum usage = GL_STATIC_DRAW) : vbo_t() {
+				typed_buffer_t<T>::upload(data, usage);
+			}
 			vbo_t(std::initializer_list<T> list, GLenum usage = GL_STATIC_DRAW) : vbo_t() {
 				std::vector<T> buffer(list);
 				typed_buffer_t<T>::upload(buffer.data(), static_cast<GLsizei>(buffer.size()), usage);
@@ -0,0 +1,96 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include "buffer.hpp"
+#include "../../types.hpp"
+#include "../../model/quantize.hpp"
+namespace foton {
+	namespace GL {
+		//one glVertexAttribPointer call
+		struct vertex_attribute_t {
+			GLint components;
+			GLenum type;
+			GLboolean normalized;
+			size_t offset;
+		};
+		/*
+			how an interleaved vertex struct maps onto the position, normal and texture coord attributes
+			specialize it to upload a new vertex type through vao_bind_t::emplace_vertices
+		*/
+		template<class VertexT>
+		struct vertex_format_t;
+		template<>
+		struct vertex_format_t<vertex_t> {
+			static constexpr vertex_attribute_t position{ 3, GL_FLOAT, GL_FALSE, offsetof(vertex_t, position) };
+			static constexpr vertex_attribute_t normal{ 3, GL_FLOAT, GL_FALSE, offsetof(vertex_t, normal) };
+			static constexpr vertex_attribute_t texture_coords{ 2, GL_FLOAT, GL_FALSE, offsetof(vertex_t, texture_coords) };
+		};
+		//position comes out in [0, 1], see quantization_t::dequantize_matrix
+		template<>
+		struct vertex_format_t<model::packed_vertex16_t> {
+			static constexpr vertex_attribute_t position{ 3, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(model::packed_vertex16_t, position) };
+			static constexpr vertex_attribute_t normal{ 2, GL_SHORT, GL_TRUE, offsetof(model::packed_vertex16_t, normal) };
+			static constexpr vertex_attribute_t texture_coords{ 2, GL_HALF_FLOAT, GL_FALSE, offsetof(model::packed_vertex16_t, texture_coords) };
+		};
+		template<>
+		struct vertex_format_t<model::packed_vertex12_t> {
+			static constexpr vertex_attribute_t position{ 3, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(model::packed_vertex12_t, position) };
+			static constexpr vertex_attribute_t normal{ 2, GL_BYTE, GL_TRUE, offsetof(model::packed_vertex12_t, normal) };
+			static constexpr vertex_attribute_t texture_coords{ 2, GL_HALF_FLOAT, GL_FALSE, offsetof(model::packed_vertex12_t, texture_coords) };
+		};
+		/*
+			per instance transform, a mat4 attribute takes 4 consecutive locations (one vec4 column each)
+			the shader declares it as  layout(location = N) in mat4 instance_transform;
+		*/
+		struct instance_matrix_t {
+			float columns[16]; //column major, same as mat4f
+			static instance_matrix_t from(const mat4f& m) {
+				instance_matrix_t out;
+				std::copy(m.data(), m.data() + 16, out.columns);
+				return out;
+			}
+		};
+		static_assert(sizeof(instance_matrix_t) == sizeof(float) * 16 && std::is_trivial_v<instance_matrix_t>);
+		/*
+			points locations first_index..first_index + 3 at instance_matrix_t's starting 'offset' bytes into the bound GL_ARRAY_BUFFER,
+			advancing once per instance. the vao and buffer have to be bound already
+		*/
+		inline void instance_matrix_attributes(GLuint first_index, size_t offset = 0) {
+			for (GLuint column = 0; column < 4; column++) {
+				glVertexAttribPointer(first_index + column, 4, GL_FLOAT, GL_FALSE, sizeof(instance_matrix_t),
+					reinterpret_cast<const void*>(offset + column * 4 * sizeof(float)));
+				glEnableVertexAttribArray(first_index + column);
+				glVertexAttribDivisor(first_index + column, 1);
+			}
+		}
+		/*
+			per instance texture region, for draws sampling a texture_pool_t array
+				layout(location = N) in vec4 instance_uv_rect; //uv offset in xy, scale in zw
+				layout(location = N + 1) in float instance_layer;
+			the shader samples  texture(pool, vec3(uv * instance_uv_rect.zw + instance_uv_rect.xy, instance_layer))
+		*/
+		struct instance_material_t {
+			float uv_rect[4];
+			float layer;
+		};
+		static_assert(sizeof(instance_material_t) == sizeof(float) * 5 && std::is_trivial_v<instance_material_t>);
+		//same as instance_matrix_attributes for instance_material_t, locations first_index and first_index + 1
+		inline void instance_material_attributes(GLuint first_index, size_t offset = 0) {
+			glVertexAttribPointer(first_index, 4, GL_FLOAT, GL_FALSE, sizeof(instance_material_t),
+				reinterpret_cast<const void*>(offset + offsetof(instance_material_t, uv_rect)));
+			glVertexAttribPointer(first_index + 1, 1, GL_FLOAT, GL_FALSE, sizeof(instance_material_t),
+				reinterpret_cast<const void*>(offset + offsetof(instance_material_t, layer)));
+			for (GLuint i = 0; i < 2; i++) {
+				glEnableVertexAttribArray(first_index + i);
+				glVertexAttribDivisor(first_index + i, 1);
+			}
+		}
+		//'material' for every vertex of a non instanced draw, the arrays get disabled so the generic value is what's read
+		inline void constant_material_attributes(GLuint first_index, const instance_material_t& material) {
+			glDisableVertexAttribArray(first_index);
+			glDisableVertexAttribArray(first_index + 1);
+			glVertexAttrib4fv(first_index, material.uv_rect);
+			glVertexAttrib1f(first_index + 1, material.layer);
+		}
+	}
+}
@@ -1,6 +1,9 @@
 #pragma once
 #include <vector>
 #include "gl/texture.hpp"
+#include "gl/vao.hpp"
+#include "texture_pool.hpp"
+#include "../model/layout.hpp"
 #include "drawer.hpp"
 namespace foton {
 	struct mesh_t {
@@ -8,8 +11,17 @@ namespace foton {
 		std::vector<vertex_t> vertices;
 		std::vector<index_t> indices;
 		std::vector<GL::texture_t> textures;
+		texture_pool_t::region_t region; //sampled instead of textures when region.texture isn't 0
+		model::aabb_t bounds;
 		
 		GL::vao_t vao;
+		mesh_t() = default;
+		//interleaves the model and uploads it as a single vbo, the gpu copy of the indices is 16 bit when it fits
+		explicit mesh_t(const model::model_t& model) : vertices(model::interleave(model)), indices(model.indices), bounds(model.bounds) {
+			auto bind = vao.bind();
+			bind.emplace_interleaved_vertices(vertices.data(), static_cast<GLsizei>(vertices.size()));
+			bind.emplace_indices(indices, vertices.size());
+		}
 	private:
 	};
 }
\ No newline at end of file
@@ -0,0 +1,358 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+#include "../types.hpp"
+#include "gl/buffer.hpp"
+#include "gl/ring_buffer.hpp"
+#include "gl/shader.hpp"
+#include "gl/texture.hpp"
+#include "gl/uniform_block.hpp"
+#include "gl/vao.hpp"
+#include "gl/vbo.hpp"
+#include "gl/vertex_format.hpp"
+namespace foton {
+	/*
+		per frame list of draws, sorted by a 64 bit key so draws sharing state end up next to each other
+
+		key layout, most significant bit first:
+			opaque:      0 | program (12) | vao (12) | texture (12) | depth (24, front to back) | 3 unused
+			translucent: 1 | depth (24, back to front) | program (12) | vao (12) | texture (12) | 3 unused
+		ids in the key are the low 12 bits of the GL name, two names sharing bits only cost a bind,
+		submit() compares the real names
+
+		submit() takes the shader, vao and texture locks once for the whole queue and binds directly,
+		a program/vao/texture that's already bound gets skipped (counted in stats_t::binds_skipped)
+
+		instancing: draws whose shader reads its transform from a per instance mat4 attribute (instance_location >= 0)
+		and that end up next to each other after sorting with the same program, vao, texture and index range
+		become one glDrawElementsInstancedBaseVertex. every frame's instance matrices go into one streamed vbo,
+		each batch points the attribute at its slice of it
+
+		draws sampling a texture_pool_t set texture_target to GL_TEXTURE_2D_ARRAY and the pool's id as texture, and pass
+		their region as a per instance GL::instance_material_t (material_location). the material isn't part of
+		instances_with, so draws with different pooled textures still become one instanced draw. draws that aren't
+		instanced set it as a constant attribute value instead
+
+		draws that aren't instanced and whose shader has an object_block (draw_t::object_block) get no glUniformMatrix4fv,
+		submit() writes all their GL::object_block_t in one go (into uniform_stream when set) and each draw binds its slice
+		to uniform_bindings::OBJECT with glBindBufferRange. the block gets draw_t::world, view_projection is the frame_block's
+
+		draws pushed with program 0 (their shader_compiler_t program isn't linked yet) draw with 'fallback' instead,
+		through its transform uniform, so they show up flat instead of vanishing. with no fallback they're dropped
+	*/
+	struct render_queue_t {
+		struct draw_t {
+			GLuint program = 0;
+			GLuint vao = 0;
+			GLuint texture = 0; //unit 0, 0 for none
+			GLenum texture_target = GL_TEXTURE_2D;
+			GLenum mode = GL_TRIANGLES;
+			GLenum index_type = GL_UNSIGNED_INT;
+			GLsizei count = 0;
+			GLsizei first = 0; //in indices
+			GLint base_vertex = 0;
+			GLint transform_location = -1; //-1 skips the upload
+			GLint instance_location = -1; //first location of a per instance mat4 'transform' goes to instead of the uniform, -1 for none
+			GLint material_location = -1; //first location of GL::instance_material_t, per instance when instanced, a constant otherwise
+			bool object_block = false; //'world' goes to the object_block instead of 'transform' to transform_location
+			mat4f transform = mat4f::Identity(); //view_projection * world, for the transform uniform and instance matrices
+			mat4f world = mat4f::Identity(); //model to world, for the object_block
+			GL::instance_material_t material = { { 0.f, 0.f, 1.f, 1.f }, 0.f };
+			//same draw apart from the transform, so both can be one instanced draw
+			bool instances_with(const draw_t& other) const {
+				return instance_location >= 0 && instance_location == other.instance_location && program == other.program
+					&& vao == other.vao && texture == other.texture && texture_target == other.texture_target && mode == other.mode
+					&& index_type == other.index_type && count == other.count && first == other.first && base_vertex == other.base_vertex
+					&& material_location == other.material_location;
+			}
+		};
+		struct stats_t {
+			size_t draws = 0;
+			size_t program_binds = 0;
+			size_t vao_binds = 0;
+			size_t texture_binds = 0;
+			size_t binds_skipped = 0; //state changes avoided vs binding program, vao and texture for every draw
+			size_t draw_calls = 0; //actually issued, less than draws when instancing kicks in
+			size_t instanced_draws = 0; //draws that went out as part of an instanced draw call
+		};
+		static constexpr uint64_t ID_BITS = 12;
+		static constexpr uint64_t DEPTH_BITS = 24;
+		static constexpr uint64_t TRANSLUCENT_BIT = uint64_t(1) << 63;
+		static constexpr size_t RADIX_SORT_MIN = 256;
+		static uint64_t id_bits(GLuint id) {
+			return id & ((uint64_t(1) << ID_BITS) - 1);
+		}
+		//depth in [0, 1] (view depth / far plane), clamped
+		static uint64_t depth_bits(float depth) {
+			const float clamped = std::clamp(depth, 0.f, 1.f);
+			return static_cast<uint64_t>(clamped * static_cast<float>((uint64_t(1) << DEPTH_BITS) - 1));
+		}
+		static uint64_t make_key(const draw_t& draw, float depth, bool translucent) {
+			const uint64_t state = (id_bits(draw.program) << (2 * ID_BITS)) | (id_bits(draw.vao) << ID_BITS) | id_bits(draw.texture);
+			if (translucent) {
+				const uint64_t back_to_front = ((uint64_t(1) << DEPTH_BITS) - 1) - depth_bits(depth);
+				return TRANSLUCENT_BIT | (back_to_front << (63 - DEPTH_BITS)) | (state << 3);
+			}
+			return (state << (63 - 3 * ID_BITS)) | (depth_bits(depth) << 3);
+		}
+
+		stats_t stats; //from the last submit()
+		//when set, instance matrices get written into its mapping instead of re-specifying a vbo, whoever owns it begins/ends frames
+		GL::ring_buffer_t* stream = nullptr;
+		GL::ring_buffer_t* uniform_stream = nullptr; //a GL_UNIFORM_BUFFER ring buffer for the object blocks, same idea as stream
+		struct fallback_t {
+			GLuint program = 0;
+			GLint transform_location = -1;
+		};
+		fallback_t fallback; //shader_compiler_t::fallback_program() and its transform location
+
+		void clear() {
+			_draws.clear();
+			_keys.clear();
+		}
+		size_t size() const {
+			return _draws.size();
+		}
+		void push(const draw_t& draw, float depth, bool translucent = false) {
+			push_keyed(make_key(draw, depth, translucent), draw);
+		}
+		//'key' from make_key, for draws that were keyed somewhere else (command_list_t)
+		void push_keyed(uint64_t key, const draw_t& draw) {
+			if (draw.program == 0) {
+				if (fallback.program == 0)
+					return;
+				//the key keeps program 0, every fallback draw still sorts together
+				draw_t& d = _draws.emplace_back(draw);
+				d.program = fallback.program;
+				d.transform_location = fallback.transform_location;
+				d.instance_location = -1;
+				d.material_location = -1;
+				d.object_block = false;
+			}
+			else
+				_draws.push_back(draw);
+			_keys.push_back(sort_entry_t{ key, static_cast<uint32_t>(_draws.size() - 1) });
+		}
+		void reserve(size_t draw_count) {
+			_keys.reserve(draw_count);
+			_draws.reserve(draw_count);
+		}
+		//LSD radix sort, 16 bits a pass, passes where every key has the same digit get skipped
+		void sort() {
+			if (_keys.size() < RADIX_SORT_MIN) { //clearing the histogram would cost more than sorting
+				std::sort(_keys.begin(), _keys.end(), [](const sort_entry_t& a, const sort_entry_t& b) {
+					return a.key < b.key;
+				});
+				return;
+			}
+			_scratch.resize(_keys.size());
+			for (uint32_t shift = 0; shift < 64; shift += 16) {
+				std::array<uint32_t, 1 << 16>& counts = *_counts;
+				counts.fill(0);
+				for (const sort_entry_t& e : _keys)
+					counts[(e.key >> shift) & 0xffff]++;
+				if (!_keys.empty() && counts[(_keys.front().key >> shift) & 0xffff] == _keys.size())
+					continue;
+				uint32_t sum = 0;
+				for (uint32_t& c : counts) {
+					const uint32_t n = c;
+					c = sum;
+					sum += n;
+				}
+				for (const sort_entry_t& e : _keys)
+					_scratch[counts[(e.key >> shift) & 0xffff]++] = e;
+				_keys.swap(_scratch);
+			}
+		}
+		//sorts and draws everything, program, vao and texture get unbound afterwards when the *_bind_t wrappers would (state_cache_t::UNBIND_ON_EXIT)
+		void submit() {
+			sort();
+			stats = {};
+			stats.draws = _draws.size();
+			if (_draws.empty())
+				return;
+			upload_instances();
+			upload_object_blocks();
+			std::scoped_lock locks(shader::shader_t::shader_bind_t::mutex(), GL::vao_t::vao_bind_t::_mutex, GL::texture_t::texture_bind_t::mutex());
+			GL::state_cache_t& state = GL::state_cache_t::current();
+			GLuint program = 0, vao = 0, texture = 0;
+			GLenum texture_target = GL_TEXTURE_2D;
+			bool first_draw = true;
+			state.active_texture(0);
+			size_t batch = 0, block = 0;
+			for (size_t k = 0; k < _keys.size(); k++) {
+				const draw_t& draw = _draws[_keys[k].index];
+				if (first_draw || draw.program != program) {
+					state.use_program(draw.program);
+					program = draw.program;
+					stats.program_binds++;
+				}
+				else
+					stats.binds_skipped++;
+				if (first_draw || draw.vao != vao) {
+					state.bind_vertex_array(draw.vao);
+					vao = draw.vao;
+					stats.vao_binds++;
+				}
+				else
+					stats.binds_skipped++;
+				if (first_draw || draw.texture != texture || draw.texture_target != texture_target) {
+					if (!first_draw && draw.texture_target != texture_target)
+						state.bind_texture(texture_target, 0);
+					state.bind_texture(draw.texture_target, draw.texture);
+					texture = draw.texture;
+					texture_target = draw.texture_target;
+					stats.texture_binds++;
+				}
+				else
+					stats.binds_skipped++;
+				first_draw = false;
+				const void* indices = reinterpret_cast<const void*>(static_cast<size_t>(draw.first) * GL::gl_type_size(draw.index_type));
+				stats.draw_calls++;
+				if (batch < _batches.size() && _batches[batch].first_key == k) {
+					const batch_t& b = _batches[batch++];
+					{
+						std::lock_guard<thread_mutex_t> lock(GL::buffer_locks::vertex_attributes);
+						state.bind_buffer(GL_ARRAY_BUFFER, _instance_source);
+						GL::instance_matrix_attributes(draw.instance_location, _instance_offset + b.first_instance * sizeof(GL::instance_matrix_t));
+						if (draw.material_location >= 0) {
+							state.bind_buffer(GL_ARRAY_BUFFER, _material_source);
+							GL::instance_material_attributes(draw.material_location, _material_offset + b.first_instance * sizeof(GL::instance_material_t));
+						}
+						state.unbind_buffer(GL_ARRAY_BUFFER);
+					}
+					glDrawElementsInstancedBaseVertex(draw.mode, draw.count, draw.index_type, indices, b.count, draw.base_vertex);
+					stats.instanced_draws += b.count;
+					k += b.count - 1;
+					continue;
+				}
+				if (draw.material_location >= 0) {
+					std::lock_guard<thread_mutex_t> lock(GL::buffer_locks::vertex_attributes);
+					GL::constant_material_attributes(draw.material_location, draw.material);
+				}
+				if (draw.object_block)
+					state.bind_buffer_range(GL_UNIFORM_BUFFER, GL::uniform_bindings::OBJECT, _block_source, _block_offset + block++ * _block_stride, sizeof(GL::object_block_t));
+				else if (draw.transform_location >= 0)
+					glUniformMatrix4fv(draw.transform_location, 1, GL_FALSE, draw.transform.data());
+				glDrawElementsBaseVertex(draw.mode, draw.count, draw.index_type, indices, draw.base_vertex);
+			}
+			if (GL::state_cache_t::UNBIND_ON_EXIT) {
+				state.bind_texture(texture_target, 0);
+				state.bind_vertex_array(0);
+				state.use_program(0);
+			}
+			GL::check_gl_errors("after render_queue_t::submit");
+		}
+	private:
+		struct sort_entry_t {
+			uint64_t key;
+			uint32_t index;
+		};
+		struct batch_t {
+			size_t first_key; //position in _keys
+			GLsizei count;
+			size_t first_instance; //in _instances
+		};
+		//finds the runs of instanceable draws in sorted order and streams their matrices (and materials) in one upload each
+		void upload_instances() {
+			_batches.clear();
+			_instances.clear();
+			_materials.clear();
+			bool materials = false;
+			for (size_t k = 0; k < _keys.size();) {
+				const draw_t& draw = _draws[_keys[k].index];
+				size_t end = k + 1;
+				if (draw.instance_location >= 0) {
+					while (end < _keys.size() && draw.instances_with(_draws[_keys[end].index]))
+						end++;
+					_batches.push_back(batch_t{ k, static_cast<GLsizei>(end - k), _instances.size() });
+					for (size_t i = k; i < end; i++) {
+						_instances.push_back(GL::instance_matrix_t::from(_draws[_keys[i].index].transform));
+						_materials.push_back(_draws[_keys[i].index].material);
+					}
+					materials = materials || draw.material_location >= 0;
+				}
+				k = end;
+			}
+			if (_instances.empty())
+				return;
+			stream_or_upload(_instances, _instance_buffer, _instance_source, _instance_offset);
+			if (materials)
+				stream_or_upload(_materials, _material_buffer, _material_source, _material_offset);
+		}
+		//the blocks of every non instanced object_block draw in sorted order, each on its own GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT boundary
+		void upload_object_blocks() {
+			if (_block_stride == 0) {
+				GLint alignment = 0;
+				glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+				const size_t a = std::max<size_t>(alignment, 16);
+				_block_stride = (sizeof(GL::object_block_t) + a - 1) / a * a;
+			}
+			_blocks.clear();
+			for (const sort_entry_t& e : _keys) {
+				const draw_t& draw = _draws[e.index];
+				if (draw.instance_location >= 0 || !draw.object_block)
+					continue;
+				const size_t at = _blocks.size();
+				_blocks.resize(at + _block_stride);
+				GL::object_block_t object;
+				object.transform = draw.world;
+				std::memcpy(_blocks.data() + at, &object, sizeof(object));
+			}
+			if (_blocks.empty())
+				return;
+			if (uniform_stream) {
+				if (const auto allocation = uniform_stream->allocate_bytes(_blocks.size(), _block_stride)) {
+					std::copy(_blocks.begin(), _blocks.end(), allocation.data.begin());
+					_block_source = uniform_stream->buffer_id();
+					_block_offset = static_cast<size_t>(allocation.offset);
+					return;
+				}
+			}
+			if (!_block_buffer)
+				_block_buffer.emplace(GL_UNIFORM_BUFFER);
+			_block_buffer->upload_objects(_blocks.data(), _blocks.size(), GL_STREAM_DRAW);
+			_block_source = _block_buffer->buffer_id();
+			_block_offset = 0;
+		}
+		template<class T>
+		void stream_or_upload(const std::vector<T>& data, std::optional<GL::vbo_t<T>>& buffer, GLuint& source, size_t& offset) {
+			if (stream) {
+				if (const auto allocation = stream->push<T>(data)) {
+					source = stream->buffer_id();
+					offset = static_cast<size_t>(allocation.offset);
+					return;
+				}
+			}
+			if (!buffer)
+				buffer.emplace();
+			buffer->upload(data.data(), static_cast<GLsizei>(data.size()), GL_STREAM_DRAW); //new storage every frame, no waiting on last frame's draws
+			source = buffer->buffer_id();
+			offset = 0;
+		}
+		std::vector<draw_t> _draws;
+		std::vector<sort_entry_t> _keys;
+		std::vector<sort_entry_t> _scratch;
+		std::unique_ptr<std::array<uint32_t, 1 << 16>> _counts = std::make_unique<std::array<uint32_t, 1 << 16>>();
+		std::vector<batch_t> _batches;
+		std::vector<GL::instance_matrix_t> _instances;
+		std::optional<GL::vbo_t<GL::instance_matrix_t>> _instance_buffer; //created on first use, needs a context
+		GLuint _instance_source = 0; //_instance_buffer or stream
+		size_t _instance_offset = 0; //of this frame's matrices in _instance_source
+		std::vector<GL::instance_material_t> _materials; //parallel to _instances
+		std::optional<GL::vbo_t<GL::instance_material_t>> _material_buffer;
+		GLuint _material_source = 0;
+		size_t _material_offset = 0;
+		std::vector<byte_t> _blocks; //object blocks, _block_stride apart
+		size_t _block_stride = 0; //sizeof(GL::object_block_t) rounded up to the uniform offset alignment, 0 until queried
+		std::optional<GL::buffer_t> _block_buffer;
+		GLuint _block_source = 0;
+		size_t _block_offset = 0;
+	};
+}
@@ -0,0 +1,136 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+#include "gl/texture_array.hpp"
+#include "gl/vertex_format.hpp"
+#include "../texture/atlas_packer.hpp"
+#include "../texture/image.hpp"
+#include "../types.hpp"
+namespace foton {
+	/*
+		many small textures packed into the layers of one GL_TEXTURE_2D_ARRAY
+
+		add() packs an image into the first layer with room (atlas_packer_t per layer) and hands back a region_t,
+		a layer index and the uv rect inside it. meshes keep the region instead of a texture_t, so everything drawn
+		from one pool binds the same texture and render_queue_t can instance draws with different textures together,
+		the region goes to the shader per instance (GL::instance_material_t)
+
+		every rect gets a gutter of 'padding' texels copied from its edge, bilinear filtering at a rect's border
+		reads its own texels instead of the neighbour's. mips are box filtered per image on the CPU and uploaded with it,
+		with mip_safe the rects are also aligned to 2^(levels - 1) and the gutter grows to match, so at every level a rect
+		still starts on a whole texel and keeps at least one texel of gutter. without it, coarse levels can blend
+		neighbours a little
+
+		wrap modes other than clamp can't work inside an atlas, textures that repeat need their own texture_t
+	*/
+	struct texture_pool_t {
+		struct texture_pool_error_t : std::runtime_error {
+			texture_pool_error_t(const char* what) : std::runtime_error(what) {}
+		};
+		struct options_t {
+			uint32_t size = 2048; //width and height of every layer
+			uint32_t layers = 4; //storage is immutable, every layer is allocated up front
+			uint32_t levels = 1;
+			uint32_t padding = 1; //gutter texels on each side
+			bool mip_safe = false;
+		};
+		//where an added image ended up
+		struct region_t {
+			GLuint texture = 0; //the pool's array, 0 for an empty region
+			uint32_t layer = 0;
+			vec4f uv_rect = vec4f(0.f, 0.f, 1.f, 1.f); //offset xy, scale zw
+			GL::instance_material_t material() const {
+				GL::instance_material_t out;
+				std::copy(uv_rect.data(), uv_rect.data() + 4, out.uv_rect);
+				out.layer = static_cast<float>(layer);
+				return out;
+			}
+		};
+
+		//no GL work until the first add()
+		texture_pool_t() : texture_pool_t(options_t()) {}
+		explicit texture_pool_t(options_t options) : _options(options) {
+			if (_options.levels == 0 || _options.levels > texture::mip_levels(_options.size, _options.size))
+				throw texture_pool_error_t("texture pool level count doesn't fit its size");
+			if (_options.mip_safe) {
+				_alignment = 1u << (_options.levels - 1);
+				_options.padding = std::max(_options.padding, _alignment);
+			}
+		}
+		texture_pool_t(const texture_pool_t&) = delete;
+		texture_pool_t& operator=(const texture_pool_t&) = delete;
+
+		region_t add(const texture::image_t& image) {
+			if (!image.valid())
+				throw texture_pool_error_t("adding an empty or truncated image");
+			const uint32_t padded_width = image.width + 2 * _options.padding, padded_height = image.height + 2 * _options.padding;
+			std::optional<texture::atlas_packer_t::rect_t> rect;
+			uint32_t layer = 0;
+			while (layer < _packers.size() && !(rect = _packers[layer].pack(padded_width, padded_height)))
+				layer++;
+			if (!rect) {
+				if (_packers.size() == _options.layers)
+					throw texture_pool_error_t("texture pool is full");
+				_packers.emplace_back(_options.size, _options.size, _alignment);
+				rect = _packers.back().pack(padded_width, padded_height);
+				if (!rect)
+					throw texture_pool_error_t("image is bigger than a texture pool layer");
+			}
+			if (!_array)
+				_array.emplace(_options.size, _options.size, _options.layers, GL_RGBA8, _options.levels);
+			//the gutter fills the whole aligned rect, anything past the image repeats its edge
+			texture::image_t level = padded(image, rect->width, rect->height);
+			for (uint32_t l = 0; l < _options.levels; l++) {
+				if (l > 0)
+					level = texture::downsample(level);
+				_array->upload(static_cast<GLint>(layer), static_cast<GLint>(rect->x >> l), static_cast<GLint>(rect->y >> l),
+					static_cast<GLsizei>(level.width), static_cast<GLsizei>(level.height), level.pixels.data(), static_cast<GLint>(l));
+			}
+			const float size = static_cast<float>(_options.size);
+			region_t region;
+			region.texture = _array->id();
+			region.layer = layer;
+			region.uv_rect = vec4f((rect->x + _options.padding) / size, (rect->y + _options.padding) / size, image.width / size, image.height / size);
+			return region;
+		}
+		//0 until the first add()
+		GLuint id() const {
+			return _array ? _array->id() : 0;
+		}
+		const options_t& options() const {
+			return _options;
+		}
+		size_t layers_used() const {
+			return _packers.size();
+		}
+		//of the used layers, aligned and padded rects count as used
+		float occupancy() const {
+			float sum = 0.f;
+			for (const texture::atlas_packer_t& packer : _packers)
+				sum += packer.occupancy();
+			return _packers.empty() ? 0.f : sum / _packers.size();
+		}
+	private:
+		texture::image_t padded(const texture::image_t& image, uint32_t width, uint32_t height) const {
+			texture::image_t out;
+			out.width = width;
+			out.height = height;
+			out.pixels.resize(out.size_bytes());
+			for (uint32_t y = 0; y < height; y++) {
+				const uint32_t sy = static_cast<uint32_t>(std::clamp<int64_t>(int64_t(y) - _options.padding, 0, image.height - 1));
+				for (uint32_t x = 0; x < width; x++) {
+					const uint32_t sx = static_cast<uint32_t>(std::clamp<int64_t>(int64_t(x) - _options.padding, 0, image.width - 1));
+					std::copy(image.texel(sx, sy), image.texel(sx, sy) + 4, out.pixels.data() + (size_t(y) * width + x) * 4);
+				}
+			}
+			return out;
+		}
+		options_t _options;
+		uint32_t _alignment = 1;
+		std::vector<texture::atlas_packer_t> _packers;
+		std::optional<GL::texture_array_t> _array; //created on first use, needs a context
+	};
+}
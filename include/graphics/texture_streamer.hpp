@@ -0,0 +1,365 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "gl/buffer.hpp"
+#include "gl/state_cache.hpp"
+#include "gl/texture.hpp"
+#include "../mutex.hpp"
+#include "../texture/image.hpp"
+#include "../utility/range_allocator.hpp"
+namespace foton {
+	/*
+		textures that load in the background instead of stalling the frame that asked for them
+
+		request() queues a source (file read + decode, anything returning an image_t) for the decode threads,
+		they build the mip chain and write every level straight into a persistently mapped GL_PIXEL_UNPACK_BUFFER
+		the context thread calls update() once a frame, which
+			- gives decoded textures their storage (every level, nothing in it yet)
+			- copies levels out of the staging buffer with glTexSubImage2D until bytes_per_frame is used up,
+			  the copy is the driver's DMA from the PBO, nothing waits on it
+			- frees staging space once the GPU is done reading it (a fence per frame of uploads)
+
+		levels arrive coarsest first and GL_TEXTURE_BASE_LEVEL follows them, so a texture is usable (blurry) as soon as its 1x1 is in
+		and sharpens frame by frame. set_screen_size() says how many pixels a texture covers, uploads go to the biggest on screen first
+		and levels finer than the screen can show wait until every texture has the levels it needs
+	*/
+	struct texture_streamer_t {
+		struct texture_streamer_error_t : std::runtime_error {
+			texture_streamer_error_t(const char* what) : std::runtime_error(what) {}
+		};
+		using image_t = texture::image_t;
+		using source_t = std::function<image_t()>;
+		using handle_t = uint32_t;
+		static constexpr handle_t INVALID = static_cast<handle_t>(-1);
+		static constexpr uint32_t STAGING_BLOCK = 256; //staging allocation granularity, keeps every level's offset aligned
+		enum class state_t {
+			queued, //waiting for or in a decode thread
+			decoded, //in staging, no GL storage yet
+			streaming, //some levels resident
+			resident, //every level resident
+			failed //the source threw or the image can't fit in staging
+		};
+		struct stats_t {
+			size_t bytes_uploaded = 0; //by the last update()
+			size_t levels_uploaded = 0;
+			size_t pending_levels = 0; //decoded, not uploaded yet
+			std::chrono::nanoseconds update_time{ 0 };
+		};
+		stats_t stats;
+		size_t bytes_per_frame;
+
+		//'staging_bytes' of PBO shared by everything in flight, decode threads wait when it's full
+		explicit texture_streamer_t(size_t staging_bytes = 64 << 20, size_t bytes_per_frame = 4 << 20, size_t decode_threads = 2)
+			: bytes_per_frame(bytes_per_frame), _staging(GL_PIXEL_UNPACK_BUFFER),
+			_staging_space(static_cast<uint32_t>(staging_bytes / STAGING_BLOCK)) {
+			if (!glBufferStorage)
+				throw texture_streamer_error_t("glBufferStorage isn't available (needs GL 4.4 or ARB_buffer_storage)");
+			const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			const size_t size = size_t(_staging_space.capacity()) * STAGING_BLOCK;
+			{
+				auto b = _staging.bind();
+				glBufferStorage(GL_PIXEL_UNPACK_BUFFER, static_cast<GLsizeiptr>(size), nullptr, flags);
+				_mapped = static_cast<uint8_t*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, static_cast<GLsizeiptr>(size), flags));
+			}
+			if (!_mapped)
+				throw texture_streamer_error_t("couldn't persistently map the texture staging buffer");
+			GL::check_gl_errors("after creating texture_streamer_t");
+			for (size_t i = 0; i < std::max<size_t>(decode_threads, 1); i++)
+				_decoders.emplace_back([this] { decode_loop(); });
+		}
+		texture_streamer_t(const texture_streamer_t&) = delete;
+		texture_streamer_t& operator=(const texture_streamer_t&) = delete;
+		~texture_streamer_t() {
+			{
+				std::scoped_lock lock(_mutex, _staging_mutex); //no decode thread is between checking _stopping and waiting
+				_stopping = true;
+			}
+			_wake.notify_all();
+			_space_freed.notify_all();
+			for (std::thread& decoder : _decoders)
+				decoder.join();
+			for (const in_flight_t& frame : _in_flight)
+				glDeleteSync(frame.fence);
+		}
+
+		//any thread, texture(handle) is incomplete (samples black) until its coarsest level is in
+		handle_t request(source_t source, float screen_size = 0.f) {
+			std::lock_guard<mutex_t> lock(_mutex);
+			const handle_t handle = static_cast<handle_t>(_entries.size());
+			_entries.push_back(std::make_unique<entry_t>());
+			_entries.back()->screen_size = screen_size;
+			_queue.push_back(job_t{ handle, std::move(source) });
+			_wake.notify_one();
+			return handle;
+		}
+		//pixels the texture covers along its longer side, decides upload order and which levels are needed
+		void set_screen_size(handle_t handle, float screen_size) {
+			std::lock_guard<mutex_t> lock(_mutex);
+			_entries[handle]->screen_size = screen_size;
+		}
+		//context thread
+		GL::texture_t& texture(handle_t handle) {
+			std::lock_guard<mutex_t> lock(_mutex);
+			return texture_of(*_entries[handle]);
+		}
+		state_t state(handle_t handle) const {
+			std::lock_guard<mutex_t> lock(_mutex);
+			return _entries[handle]->state;
+		}
+		//finest resident level, -1 for none yet
+		int resident_level(handle_t handle) const {
+			std::lock_guard<mutex_t> lock(_mutex);
+			const entry_t& e = *_entries[handle];
+			return e.uploaded == 0 ? -1 : static_cast<int>(e.levels.size() - e.uploaded);
+		}
+
+		//context thread, once a frame
+		void update() {
+			const auto start = std::chrono::steady_clock::now();
+			stats.bytes_uploaded = 0;
+			stats.levels_uploaded = 0;
+			retire();
+			std::lock_guard<mutex_t> lock(_mutex);
+			for (const handle_t handle : _decoded)
+				allocate_storage(*_entries[handle]);
+			_streaming.insert(_streaming.end(), _decoded.begin(), _decoded.end());
+			_decoded.clear();
+			upload();
+			stats.pending_levels = 0;
+			for (const handle_t handle : _streaming)
+				stats.pending_levels += _entries[handle]->levels.size() - _entries[handle]->uploaded;
+			stats.update_time = std::chrono::steady_clock::now() - start;
+		}
+	private:
+		struct level_t {
+			uint32_t width;
+			uint32_t height;
+			uint32_t block; //in staging, STAGING_BLOCK units
+			uint32_t blocks;
+		};
+		struct entry_t {
+			std::optional<GL::texture_t> texture; //made on the context thread
+			state_t state = state_t::queued;
+			float screen_size = 0.f;
+			std::vector<level_t> levels; //finest first, like GL
+			size_t uploaded = 0; //levels resident, counted from the coarsest
+		};
+		struct job_t {
+			handle_t handle;
+			source_t source;
+		};
+		struct in_flight_t {
+			GLsync fence;
+			std::vector<level_t> levels; //staging to free once the fence signals
+		};
+		static GL::texture_t& texture_of(entry_t& e) {
+			if (!e.texture)
+				e.texture.emplace();
+			return *e.texture;
+		}
+		static size_t level_bytes(uint32_t width, uint32_t height) {
+			return size_t(width) * height * 4;
+		}
+		//a decode thread, returns false when stopping or when 'blocks' can never fit
+		bool allocate_staging(uint32_t blocks, uint32_t& block) {
+			std::unique_lock<mutex_t> lock(_staging_mutex);
+			if (blocks > _staging_space.capacity())
+				return false;
+			for (;;) {
+				block = _staging_space.allocate(blocks);
+				if (block != range_allocator_t::INVALID)
+					return true;
+				if (_stopping)
+					return false;
+				_space_freed.wait(lock);
+			}
+		}
+		void free_staging(const level_t& level) {
+			std::lock_guard<mutex_t> lock(_staging_mutex);
+			_staging_space.free(level.block, level.blocks);
+		}
+		void decode_loop() {
+			for (;;) {
+				job_t job;
+				{
+					std::unique_lock<mutex_t> lock(_mutex);
+					_wake.wait(lock, [&] { return _stopping || !_queue.empty(); });
+					if (_stopping)
+						return;
+					//biggest on screen first
+					auto next = std::max_element(_queue.begin(), _queue.end(), [&](const job_t& a, const job_t& b) {
+						return _entries[a.handle]->screen_size < _entries[b.handle]->screen_size;
+					});
+					job = std::move(*next);
+					_queue.erase(next);
+				}
+				std::vector<level_t> levels;
+				bool ok = false;
+				try {
+					image_t image = job.source();
+					ok = image.valid();
+					//the whole chain in one allocation, a decode thread never waits while holding part of the staging buffer
+					size_t total = 0;
+					for (uint32_t width = image.width, height = image.height; ok; width = std::max(width / 2, 1u), height = std::max(height / 2, 1u)) {
+						const size_t blocks = (level_bytes(width, height) + STAGING_BLOCK - 1) / STAGING_BLOCK;
+						levels.push_back(level_t{ width, height, static_cast<uint32_t>(total), static_cast<uint32_t>(blocks) });
+						total += blocks;
+						if (width == 1 && height == 1)
+							break;
+					}
+					uint32_t first = range_allocator_t::INVALID;
+					ok = ok && total <= UINT32_MAX && allocate_staging(static_cast<uint32_t>(total), first);
+					if (!ok)
+						levels.clear();
+					for (level_t& level : levels)
+						level.block += first;
+					for (size_t l = 0; l < levels.size(); l++) {
+						if (l > 0)
+							image = texture::downsample(image);
+						std::memcpy(_mapped + size_t(levels[l].block) * STAGING_BLOCK, image.pixels.data(), level_bytes(image.width, image.height));
+					}
+				}
+				catch (...) {
+					ok = false;
+				}
+				if (!ok) {
+					for (const level_t& level : levels)
+						free_staging(level);
+					_space_freed.notify_all();
+				}
+				std::lock_guard<mutex_t> lock(_mutex);
+				entry_t& e = *_entries[job.handle];
+				if (ok) {
+					e.levels = std::move(levels);
+					e.state = state_t::decoded;
+					_decoded.push_back(job.handle);
+				}
+				else
+					e.state = state_t::failed;
+			}
+		}
+		//every level allocated as immutable storage, the sampler only sees what's resident through the base level
+		void allocate_storage(entry_t& e) {
+			GL::texture_t& texture = texture_of(e);
+			auto bind = texture.bind();
+			bind.allocate_storage(e.levels.front().width, e.levels.front().height, GL_RGBA8, static_cast<GLsizei>(e.levels.size()));
+			const GLint coarsest = static_cast<GLint>(e.levels.size() - 1);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, coarsest);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, coarsest);
+			bind.set_filter();
+			e.state = state_t::streaming;
+		}
+		//finest level the texture needs at its screen size, never finer than 0
+		static size_t needed_level(const entry_t& e) {
+			if (e.screen_size <= 0.f)
+				return e.levels.size() - 1;
+			const float texels = static_cast<float>(std::max(e.levels.front().width, e.levels.front().height));
+			const float level = std::floor(std::log2(std::max(texels / e.screen_size, 1.f)));
+			return std::min(static_cast<size_t>(level), e.levels.size() - 1);
+		}
+		/*
+			one level per texture per pass: needed levels before unneeded ones, then bigger on screen first
+			within a texture the next level is always the one just finer than what's resident
+		*/
+		void upload() {
+			struct candidate_t {
+				handle_t handle;
+				bool needed;
+				float screen_size;
+			};
+			std::vector<candidate_t> candidates;
+			in_flight_t frame{ nullptr, {} };
+			GL::state_cache_t& state = GL::state_cache_t::current();
+			std::scoped_lock locks(GL::texture_t::texture_bind_t::mutex(), GL::buffer_locks::pixel_unpack);
+			state.bind_buffer(GL_PIXEL_UNPACK_BUFFER, _staging.buffer_id());
+			for (bool progress = true; progress && stats.bytes_uploaded < bytes_per_frame;) {
+				candidates.clear();
+				for (const handle_t handle : _streaming) {
+					const entry_t& e = *_entries[handle];
+					if (e.uploaded == e.levels.size())
+						continue;
+					const size_t next = e.levels.size() - 1 - e.uploaded;
+					candidates.push_back(candidate_t{ handle, next >= needed_level(e), e.screen_size });
+				}
+				std::sort(candidates.begin(), candidates.end(), [](const candidate_t& a, const candidate_t& b) {
+					if (a.needed != b.needed)
+						return a.needed;
+					return a.screen_size > b.screen_size;
+				});
+				progress = false;
+				for (const candidate_t& c : candidates) {
+					entry_t& e = *_entries[c.handle];
+					const size_t l = e.levels.size() - 1 - e.uploaded;
+					const level_t& level = e.levels[l];
+					const size_t bytes = level_bytes(level.width, level.height);
+					//a level bigger than the whole budget still goes when it's the first thing this frame
+					if (stats.bytes_uploaded > 0 && stats.bytes_uploaded + bytes > bytes_per_frame)
+						continue;
+					state.bind_texture(GL_TEXTURE_2D, e.texture->id());
+					glTexSubImage2D(GL_TEXTURE_2D, static_cast<GLint>(l), 0, 0, level.width, level.height, GL_RGBA, GL_UNSIGNED_BYTE,
+						reinterpret_cast<const void*>(size_t(level.block) * STAGING_BLOCK));
+					glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, static_cast<GLint>(l));
+					e.uploaded++;
+					if (e.uploaded == e.levels.size())
+						e.state = state_t::resident;
+					frame.levels.push_back(level);
+					stats.bytes_uploaded += bytes;
+					stats.levels_uploaded++;
+					progress = true;
+				}
+			}
+			state.unbind_buffer(GL_PIXEL_UNPACK_BUFFER);
+			_streaming.erase(std::remove_if(_streaming.begin(), _streaming.end(), [&](handle_t handle) {
+				return _entries[handle]->state == state_t::resident;
+			}), _streaming.end());
+			if (!frame.levels.empty()) {
+				frame.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+				_in_flight.push_back(std::move(frame));
+			}
+			GL::check_gl_errors("after texture_streamer_t::upload");
+		}
+		//frees staging whose uploads the GPU finished, never waits
+		void retire() {
+			bool freed = false;
+			while (!_in_flight.empty()) {
+				const GLenum result = glClientWaitSync(_in_flight.front().fence, 0, 0);
+				if (result == GL_TIMEOUT_EXPIRED)
+					break;
+				glDeleteSync(_in_flight.front().fence);
+				for (const level_t& level : _in_flight.front().levels)
+					free_staging(level);
+				_in_flight.pop_front();
+				freed = true;
+			}
+			if (freed)
+				_space_freed.notify_all();
+		}
+		GL::buffer_t _staging;
+		uint8_t* _mapped = nullptr;
+		range_allocator_t _staging_space; //guarded by _staging_mutex
+		mutex_t _staging_mutex;
+		std::condition_variable _space_freed;
+		mutable mutex_t _mutex; //everything below
+		std::condition_variable _wake;
+		std::vector<std::unique_ptr<entry_t>> _entries;
+		std::deque<job_t> _queue;
+		std::vector<handle_t> _decoded; //waiting for storage
+		std::vector<handle_t> _streaming; //storage made, levels left
+		std::deque<in_flight_t> _in_flight; //context thread only
+		std::vector<std::thread> _decoders;
+		std::atomic<bool> _stopping = false;
+	};
+}
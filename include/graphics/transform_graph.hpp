@@ -0,0 +1,257 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+#include "../types.hpp"
+#include "../utility/thread_pool.hpp"
+namespace foton {
+	/*
+		parent/child transforms, world = parent world * local
+
+		handles stay valid until remove(), the data behind them lives in SoA arrays ordered depth first,
+		so every parent comes before its children and every subtree is one contiguous range of slots
+		update() pushes dirty flags down in one forward pass, then recomputes world matrices for dirty slots only,
+		root subtrees are independent so they get split across the thread pool
+		a frame where nothing moved returns from update() right away, static scenery costs nothing
+
+		adding a child or reparenting breaks the ordering, the next update() restores it (O(n), meant for load time)
+	*/
+	struct transform_graph_t {
+		struct transform_graph_error_t : std::logic_error {
+			transform_graph_error_t(const char* what) : std::logic_error(what) {}
+		};
+		using handle_t = uint32_t;
+		static constexpr handle_t INVALID = static_cast<handle_t>(-1);
+		struct stats_t {
+			size_t nodes = 0;
+			size_t updated = 0; //world matrices recomputed by the last update()
+			bool reordered = false;
+		};
+		stats_t stats;
+
+		handle_t add(handle_t parent = INVALID, const vec3f& position = vec3f::Zero(), const quatf& rotation = quatf::Identity()) {
+			if (parent != INVALID && !alive(parent))
+				throw transform_graph_error_t("parent isn't in this graph");
+			handle_t handle;
+			if (_free.empty()) {
+				handle = static_cast<handle_t>(_slot_of.size());
+				_slot_of.push_back(INVALID);
+				_parent_of.push_back(INVALID);
+			}
+			else {
+				handle = _free.back();
+				_free.pop_back();
+			}
+			const uint32_t slot = static_cast<uint32_t>(_handle_of.size());
+			_slot_of[handle] = slot;
+			_parent_of[handle] = parent;
+			_handle_of.push_back(handle);
+			_parent.push_back(parent == INVALID ? INVALID : _slot_of[parent]);
+			_position.push_back(position);
+			_rotation.push_back(rotation);
+			_world.push_back(mat4f::Identity());
+			_dirty.push_back(1);
+			_any_dirty = true;
+			if (parent == INVALID)
+				_roots.push_back(slot); //a new last root keeps the order
+			else
+				_order_dirty = true;
+			return handle;
+		}
+		//removes 'handle' and everything under it, the handles get reused after the next update()
+		void remove(handle_t handle) {
+			if (!alive(handle))
+				return;
+			_parent_of[handle] = INVALID; //cut off so reorder() sees it as a root and skips it
+			_removed.push_back(handle);
+			_order_dirty = true;
+		}
+		//keeps the local transform, so the node moves with its new parent
+		void set_parent(handle_t handle, handle_t parent) {
+			if (!alive(handle) || (parent != INVALID && !alive(parent)))
+				throw transform_graph_error_t("node isn't in this graph");
+			for (handle_t p = parent; p != INVALID; p = _parent_of[p]) {
+				if (p == handle)
+					throw transform_graph_error_t("parenting a node under itself");
+			}
+			_parent_of[handle] = parent;
+			_dirty[_slot_of[handle]] = 1;
+			_any_dirty = true;
+			_order_dirty = true;
+		}
+		handle_t parent(handle_t handle) const {
+			return _parent_of[handle];
+		}
+		bool alive(handle_t handle) const {
+			return handle < _slot_of.size() && _slot_of[handle] != INVALID;
+		}
+		void set_local(handle_t handle, const vec3f& position, const quatf& rotation) {
+			const uint32_t slot = _slot_of[handle];
+			_position[slot] = position;
+			_rotation[slot] = rotation;
+			_dirty[slot] = 1;
+			_any_dirty = true;
+		}
+		const vec3f& local_position(handle_t handle) const {
+			return _position[_slot_of[handle]];
+		}
+		const quatf& local_rotation(handle_t handle) const {
+			return _rotation[_slot_of[handle]];
+		}
+		//as of the last update()
+		const mat4f& world(handle_t handle) const {
+			return _world[_slot_of[handle]];
+		}
+		//handles whose world matrix the last update() changed
+		const std::vector<handle_t>& changed() const {
+			return _changed;
+		}
+		size_t size() const {
+			return _handle_of.size();
+		}
+		void update(thread_pool_t& pool = thread_pool_t::shared()) {
+			_changed.clear();
+			stats.updated = 0;
+			stats.reordered = _order_dirty;
+			if (_order_dirty)
+				reorder();
+			stats.nodes = size();
+			if (!_any_dirty)
+				return;
+			const uint32_t count = static_cast<uint32_t>(size());
+			for (uint32_t i = 0; i < count; i++) {
+				if (_parent[i] != INVALID)
+					_dirty[i] |= _dirty[_parent[i]];
+			}
+			//cut [0, count) at root boundaries into about one range per thread
+			const size_t ranges = std::min(_roots.size(), pool.thread_count());
+			pool.parallel_for(ranges, [&](size_t r) {
+				const uint32_t first = boundary(r, ranges, count);
+				const uint32_t last = boundary(r + 1, ranges, count);
+				for (uint32_t i = first; i < last; i++) {
+					if (!_dirty[i])
+						continue;
+					aff3f local = aff3f::Identity();
+					local.translate(_position[i]);
+					local.rotate(_rotation[i]);
+					if (_parent[i] == INVALID)
+						_world[i] = local.matrix();
+					else
+						_world[i] = _world[_parent[i]] * local.matrix();
+				}
+			});
+			for (uint32_t i = 0; i < count; i++) {
+				if (_dirty[i]) {
+					_changed.push_back(_handle_of[i]);
+					_dirty[i] = 0;
+				}
+			}
+			stats.updated = _changed.size();
+			_any_dirty = false;
+		}
+	private:
+		//first slot of range r out of 'ranges', always the start of a root subtree
+		uint32_t boundary(size_t r, size_t ranges, uint32_t count) const {
+			if (r == ranges)
+				return count;
+			const uint32_t target = static_cast<uint32_t>(size_t(count) * r / ranges);
+			const auto root = std::lower_bound(_roots.begin(), _roots.end(), target);
+			return root == _roots.end() ? count : *root;
+		}
+		//depth first order from the hierarchy in _parent_of, drops removed subtrees and frees their handles
+		void reorder() {
+			const size_t handles = _slot_of.size();
+			std::vector<uint8_t> removed(handles, 0);
+			for (const handle_t handle : _removed)
+				removed[handle] = 1;
+			_removed.clear();
+			//children of every handle, in current slot order so siblings keep their order
+			std::vector<uint32_t> child_start(handles + 1, 0);
+			for (const handle_t handle : _handle_of) {
+				if (_parent_of[handle] != INVALID)
+					child_start[_parent_of[handle] + 1]++;
+			}
+			for (size_t h = 0; h < handles; h++)
+				child_start[h + 1] += child_start[h];
+			std::vector<handle_t> children(child_start[handles]);
+			std::vector<uint32_t> fill(child_start.begin(), child_start.end() - 1);
+			for (const handle_t handle : _handle_of) {
+				if (_parent_of[handle] != INVALID)
+					children[fill[_parent_of[handle]]++] = handle;
+			}
+			std::vector<handle_t> order;
+			order.reserve(_handle_of.size());
+			std::vector<uint32_t> new_parent;
+			new_parent.reserve(_handle_of.size());
+			std::vector<uint32_t> new_roots;
+			struct entry_t {
+				handle_t handle;
+				uint32_t parent_slot;
+			};
+			std::vector<entry_t> stack;
+			for (const handle_t root : _handle_of) {
+				if (_parent_of[root] != INVALID || removed[root])
+					continue;
+				new_roots.push_back(static_cast<uint32_t>(order.size()));
+				stack.push_back(entry_t{ root, INVALID });
+				while (!stack.empty()) {
+					const entry_t e = stack.back();
+					stack.pop_back();
+					const uint32_t slot = static_cast<uint32_t>(order.size());
+					order.push_back(e.handle);
+					new_parent.push_back(e.parent_slot);
+					for (uint32_t c = child_start[e.handle + 1]; c-- > child_start[e.handle];) {
+						if (!removed[children[c]])
+							stack.push_back(entry_t{ children[c], slot });
+					}
+				}
+			}
+			std::vector<vec3f> position(order.size());
+			std::vector<quatf> rotation(order.size());
+			std::vector<mat4f> world(order.size());
+			std::vector<uint8_t> dirty(order.size());
+			for (uint32_t slot = 0; slot < order.size(); slot++) {
+				const uint32_t old = _slot_of[order[slot]];
+				position[slot] = _position[old];
+				rotation[slot] = _rotation[old];
+				world[slot] = _world[old];
+				dirty[slot] = _dirty[old];
+			}
+			for (const handle_t handle : _handle_of) //anything not reached was removed or under something removed
+				_slot_of[handle] = INVALID;
+			for (uint32_t slot = 0; slot < order.size(); slot++)
+				_slot_of[order[slot]] = slot;
+			for (const handle_t handle : _handle_of) {
+				if (_slot_of[handle] == INVALID) {
+					_parent_of[handle] = INVALID;
+					_free.push_back(handle);
+				}
+			}
+			_handle_of = std::move(order);
+			_parent = std::move(new_parent);
+			_roots = std::move(new_roots);
+			_position = std::move(position);
+			_rotation = std::move(rotation);
+			_world = std::move(world);
+			_dirty = std::move(dirty);
+			_order_dirty = false;
+		}
+		//by slot, depth first
+		std::vector<handle_t> _handle_of;
+		std::vector<uint32_t> _parent; //slot of the parent, INVALID for roots
+		std::vector<vec3f> _position; //local
+		std::vector<quatf> _rotation; //local
+		std::vector<mat4f> _world;
+		std::vector<uint8_t> _dirty;
+		std::vector<uint32_t> _roots; //slots, ascending
+		//by handle
+		std::vector<uint32_t> _slot_of;
+		std::vector<handle_t> _parent_of;
+		std::vector<handle_t> _free;
+		std::vector<handle_t> _removed;
+		std::vector<handle_t> _changed;
+		bool _any_dirty = false;
+		bool _order_dirty = false;
+	};
+}
@@ -3,23 +3,88 @@
 #include <string_view>
 #include <fstream>
 #include <filesystem>
+#include <limits>
 #include "types.hpp"
+#include "model/obj_parser.hpp"
+#include "model/weld.hpp"
+#include "utility/mapped_file.hpp"
 namespace foton {
 	namespace model {
 		namespace filesystem = std::filesystem;
 		using index_t = uint32_t;
 		static constexpr index_t INVALID_INDEX = static_cast<index_t>(-1);
+		//axis aligned box, empty until something gets added
+		struct aabb_t {
+			vec3f min = vec3f::Constant(std::numeric_limits<float>::max());
+			vec3f max = vec3f::Constant(std::numeric_limits<float>::lowest());
+			bool empty() const {
+				return min.x() > max.x();
+			}
+			void add(const vec3f& p) {
+				min = min.cwiseMin(p);
+				max = max.cwiseMax(p);
+			}
+			void add(const aabb_t& other) {
+				if (!other.empty()) {
+					add(other.min);
+					add(other.max);
+				}
+			}
+			vec3f center() const {
+				return (min + max) * 0.5f;
+			}
+			//half the size on each axis
+			vec3f extent() const {
+				return (max - min) * 0.5f;
+			}
+			//surface area, what the BVH builder's cost model weighs children by
+			float area() const {
+				if (empty())
+					return 0.f;
+				const vec3f size = max - min;
+				return 2.f * (size.x() * size.y() + size.y() * size.z() + size.z() * size.x());
+			}
+			bool operator==(const aabb_t& other) const {
+				return min == other.min && max == other.max;
+			}
+			bool overlaps(const aabb_t& other) const {
+				return (min.array() <= other.max.array()).all() && (other.min.array() <= max.array()).all();
+			}
+			//world box around this box moved by 'linear' then 'translation'
+			aabb_t transformed(const mat3f& linear, const vec3f& translation) const {
+				if (empty())
+					return *this;
+				const vec3f c = linear * center() + translation;
+				const vec3f e = linear.cwiseAbs() * extent();
+				aabb_t out;
+				out.min = c - e;
+				out.max = c + e;
+				return out;
+			}
+			template<class PointsT>
+			static aabb_t from_points(const PointsT& points) {
+				aabb_t out;
+				for (const vec3f& p : points)
+					out.add(p);
+				return out;
+			}
+		};
 		struct model_t {
 			std::vector<vec3f> vertices;
 			std::vector<vec2f> texture_coords;
 			std::vector<vec3f> normals;
 			std::vector<uint32_t> indices;
+			aabb_t bounds; //of the vertices, set by whatever builds the model (make_model, to_model, etc)
+			void compute_bounds() {
+				bounds = aabb_t::from_points(vertices);
+			}
 		};
 		class multiindex_model_t {
 		public:
 			struct model_loading_error_t : std::runtime_error {
 				model_loading_error_t(std::string message) : std::runtime_error(message) {};
 			};
+			static constexpr size_t MISSING_INDEX = static_cast<size_t>(-1); //corner without a texture coord or normal
 			struct multiindex_face_t {
 				struct vertex_indices_t {
 					size_t vertex_i, texture_coords_i, normals_i;
@@ -31,116 +96,122 @@ namespace foton {
 			std::vector<vec3f> normals;
 			std::vector<vec2f> texture_coords;
 			std::vector<multiindex_face_t> faces;
+			vec2f texture_coord_at(size_t i) const {
+				return i == MISSING_INDEX ? vec2f::Zero() : texture_coords[i];
+			}
+			vec3f normal_at(size_t i) const {
+				return i == MISSING_INDEX ? vec3f::Zero() : normals[i];
+			}
 			index_t add_vertex_indices(model_t& model, multiindex_face_t::vertex_indices_t v) {
 				model.vertices.push_back(vertices[v.vertex_i]);
-				model.texture_coords.push_back(texture_coords[v.texture_coords_i]);
-				model.normals.push_back(normals[v.normals_i]);
+				model.texture_coords.push_back(texture_coord_at(v.texture_coords_i));
+				model.normals.push_back(normal_at(v.normals_i));
 				return static_cast<index_t>(model.vertices.size() - 1);
 			}
-			index_t find_similar_vertex(model_t& model, vec3f vertex, vec2f uv, vec3f normal) {
-				for (index_t i = 0; i < model.vertices.size(); i++) {
-					if (model.vertices[i] == vertex
-						&& model.texture_coords[i] == uv
-						&& model.normals[i] == normal)
-						return i;
-				}
-				return INVALID_INDEX;
-			}
-			model_t make_model() {
+			/*
+				de-indexes the faces into a single index buffer, welding equal corners through a weld_table_t
+				linear in the corner count, see weld_mode_t for what counts as equal
+				throws model_loading_error_t for weld_mode_t::epsilon without a positive epsilon
+			*/
+			model_t make_model(weld_options_t options = {}) {
+				if (options.mode == weld_mode_t::epsilon && !(options.epsilon > 0.f)) //NaN too
+					throw model_loading_error_t("weld epsilon has to be positive, got " + std::to_string(options.epsilon));
+				using vertex_indices_t = multiindex_face_t::vertex_indices_t;
 				model_t out;
-				auto process_vertex_indices = [&](multiindex_face_t::vertex_indices_t v) {
-					if (const index_t i = find_similar_vertex(out, vertices[v.vertex_i], texture_coords[v.texture_coords_i],
-						normals[v.normals_i]); i != INVALID_INDEX) {
-						out.indices.push_back(i);
+				const size_t corner_count = faces.size() * 3;
+				const size_t expected_vertices = std::max({ vertices.size(), texture_coords.size(), normals.size() });
+				out.indices.reserve(corner_count);
+				out.vertices.reserve(expected_vertices);
+				out.texture_coords.reserve(expected_vertices);
+				out.normals.reserve(expected_vertices);
+				weld_table_t table(corner_count);
+				std::vector<vertex_indices_t> emitted_corners; //only needed to compare keys in weld_mode_t::indices
+				if (options.mode == weld_mode_t::indices)
+					emitted_corners.reserve(expected_vertices);
+				const float inverse_epsilon = 1.f / options.epsilon;
+
+				auto hash_corner = [&](const vertex_indices_t& v, const vec3f& position, const vec2f& uv, const vec3f& normal) {
+					uint64_t h = 0;
+					switch (options.mode) {
+					case weld_mode_t::indices:
+						h = weld::combine(weld::combine(weld::mix(v.vertex_i), v.texture_coords_i), v.normals_i);
+						return h;
+					case weld_mode_t::epsilon:
+						for (int i = 0; i < 3; i++)
+							h = weld::combine(h, static_cast<uint64_t>(weld::quantize(position[i], inverse_epsilon)));
+						break;
+					case weld_mode_t::exact:
+						for (int i = 0; i < 3; i++)
+							h = weld::combine(h, weld::float_bits(position[i]));
+						break;
 					}
-					else {
-						out.indices.push_back(add_vertex_indices(out, v));
+					for (int i = 0; i < 2; i++)
+						h = weld::combine(h, weld::float_bits(uv[i]));
+					for (int i = 0; i < 3; i++)
+						h = weld::combine(h, weld::float_bits(normal[i]));
+					return h;
+				};
+				auto same_position = [&](const vec3f& a, const vec3f& b) {
+					if (options.mode != weld_mode_t::epsilon)
+						return a == b;
+					for (int i = 0; i < 3; i++) {
+						if (weld::quantize(a[i], inverse_epsilon) != weld::quantize(b[i], inverse_epsilon))
+							return false;
+					}
+					return true;
+				};
+				auto process_vertex_indices = [&](const vertex_indices_t& v) {
+					const vec3f& position = vertices[v.vertex_i];
+					const vec2f uv = texture_coord_at(v.texture_coords_i);
+					const vec3f normal = normal_at(v.normals_i);
+					const index_t candidate = static_cast<index_t>(out.vertices.size());
+					const index_t i = table.find_or_insert(hash_corner(v, position, uv, normal), candidate, [&](index_t existing) {
+						if (options.mode == weld_mode_t::indices) {
+							const vertex_indices_t& e = emitted_corners[existing];
+							return e.vertex_i == v.vertex_i && e.texture_coords_i == v.texture_coords_i && e.normals_i == v.normals_i;
+						}
+						return same_position(out.vertices[existing], position)
+							&& out.texture_coords[existing] == uv
+							&& out.normals[existing] == normal;
+					});
+					if (i == candidate) {
+						add_vertex_indices(out, v);
+						if (options.mode == weld_mode_t::indices)
+							emitted_corners.push_back(v);
 					}
+					out.indices.push_back(i);
 				};
-				auto process_multiindex_face = [&](multiindex_face_t face) {
+				for (const multiindex_face_t& face : faces) {
 					process_vertex_indices(face.v1);
 					process_vertex_indices(face.v2);
 					process_vertex_indices(face.v3);
-				};
-				std::for_each(faces.begin(), faces.end(), process_multiindex_face);
+				}
+				out.compute_bounds();
+				return out;
 			}
 		};
 
-		std::istream& operator>>(std::istream& is, foton::vec3f& out) {
-			foton::vec3f::value_type x, y, z;
-			is >> x >> y >> z;
-			out = foton::vec3f{ x, y, z };
-			return is;
-		}
-		std::istream& operator>>(std::istream& is, foton::vec2f& out) {
-			foton::vec2f::value_type x, y;
-			is >> x >> y;
-			out = foton::vec2f{ x, y };
-			return is;
-		}
-		std::istream& operator>>(std::istream& is, foton::model::multiindex_model_t::multiindex_face_t::vertex_indices_t& out) {
-			is >> out.vertex_i;
-			if (is.peek() != '/')
-				return is;
-			is.get();
-			if (is.peek() != '/')
-				is >> out.texture_coords_i;
-			is.get();
-			if (is.peek() != '/')
-				return is;
-			is >> out.normals_i;
-			return is;
-		}
-		std::istream& operator>>(std::istream& is, foton::model::multiindex_model_t::multiindex_face_t& out) {
-			return is >> out.v1 >> out.v2 >> out.v3;
-		}
 		class OBJ_model_t : public multiindex_model_t {
+		public:
 			std::string obj_file_name;
+			explicit OBJ_model_t(std::string_view text) {
+				load(text);
+			}
 			OBJ_model_t(std::istream& in) {
-				std::string operation;
-				auto pass = [&] {
-					while (in.get() != '\n') {};
-				};
-				while (in >> operation) {
-					if (operation == "#") { //Comment
-						pass();
-						continue;
-					}
-					else if (operation == "o") { //Object name
-						in >> obj_file_name;
-						continue;
-					}
-					else if (operation == "mtllib") { //Unused
-						pass();
-						continue;
-					}
-					else if (operation == "v") {
-						vec3f vertex;
-						in >> vertex;
-						vertices.push_back(vertex);
-					}
-					else if (operation == "vt") {
-						vec2f texture_coord;
-						in >> texture_coord;
-						texture_coords.push_back(texture_coord);
-					}
-					else if (operation == "vn") {
-						vec3f normal;
-						in >> normal;
-						normals.push_back(normal);
-					}
-					else if (operation == "f") {
-						multiindex_face_t face;
-						in >> face;
-						faces.push_back(face);
-					}
-				}
+				using stream_iter = std::istreambuf_iterator<char>;
+				const std::string text(stream_iter(in), (stream_iter()));
+				load(text);
 			}
 			static OBJ_model_t from_path(const filesystem::path& path) {
-				std::ifstream stream = std::ifstream(path);
-				return OBJ_model_t(stream);
+				const mapped_file_t file(path);
+				return OBJ_model_t(file.view());
+			}
+		private:
+			void load(std::string_view text) {
+				std::string_view object_name;
+				obj::parse_parallel(text, *this, thread_pool_t::shared(), &object_name);
+				obj_file_name = object_name;
 			}
-
 		};
 	}
 
@@ -0,0 +1,388 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+#include <span>
+#include <string>
+#include "../model.hpp"
+#include "index_codec.hpp"
+#include "layout.hpp"
+#include "optimize.hpp"
+#include "../utility/hash.hpp"
+#include "../utility/mapped_file.hpp"
+namespace foton {
+	namespace model {
+		/*
+			binary "cooked" meshes
+
+			a cooked mesh is a model_t after parsing and welding, written out exactly how the GPU wants it
+			loading one is mapping the file and pointing spans at it, no parsing or copying
+			every section is 64 byte aligned inside the file (and the mapping is page aligned) so
+			spans can go straight into typed_buffer_t::upload
+			the one exception is indices, by default they're stored with index_codec (about a quarter of the size)
+			and get decoded once when the file is opened
+
+			layout: header_t, then the sections listed in header_t::sections in any order
+		*/
+		namespace cooked {
+			static constexpr std::array<char, 4> MAGIC = { 'F', 'C', 'M', 'H' };
+			static constexpr uint32_t VERSION = 4; //bump on ANY layout or cooking change, old caches get rebuilt
+			static constexpr uint64_t SECTION_ALIGNMENT = 64;
+			enum class section_id_t : uint32_t {
+				positions, //vec3f per vertex
+				texture_coords, //vec2f per vertex
+				normals, //vec3f per vertex
+				interleaved, //foton::vertex_t per vertex
+				indices, //index_t per index, or index_codec bytes (see index_encoding_t)
+				count
+			};
+			static constexpr size_t SECTION_COUNT = static_cast<size_t>(section_id_t::count);
+			enum class vertex_layout_t : uint32_t {
+				separate = 1 << 0, //positions, texture_coords, normals
+				interleaved = 1 << 1, //vertex_t
+				both = separate | interleaved
+			};
+			enum class index_encoding_t : uint32_t {
+				raw, //index_t array, mapped as is
+				varint //index_codec::encode
+			};
+			inline bool has_layout(vertex_layout_t layout, vertex_layout_t which) {
+				return (static_cast<uint32_t>(layout) & static_cast<uint32_t>(which)) != 0;
+			}
+			struct section_t {
+				uint64_t offset = 0; //in bytes from the start of the file
+				uint64_t size = 0; //in bytes, 0 means the section isn't there
+			};
+			//what the cooked file was built from, a cache hit needs all of these to match
+			struct source_key_t {
+				uint64_t path_hash = 0;
+				int64_t mtime = 0;
+				uint64_t size = 0;
+				uint64_t content_hash = 0;
+				uint64_t options_hash = 0; //weld and optimize settings the mesh was cooked with, see mesh_cache_t::options_hash()
+				static uint64_t hash_path(const filesystem::path& source) {
+					return hash::string(filesystem::absolute(source).lexically_normal().generic_string());
+				}
+				//path, mtime and size only, cheap enough to do every load
+				static source_key_t stat(const filesystem::path& source) {
+					source_key_t key;
+					key.path_hash = hash_path(source);
+					key.mtime = static_cast<int64_t>(filesystem::last_write_time(source).time_since_epoch().count());
+					key.size = static_cast<uint64_t>(filesystem::file_size(source));
+					return key;
+				}
+				static uint64_t hash_contents(const mapped_file_t& file) {
+					return hash::bytes(file.data(), file.size());
+				}
+			};
+			struct header_t {
+				std::array<char, 4> magic = MAGIC;
+				uint32_t version = VERSION;
+				source_key_t source;
+				uint32_t vertex_count = 0;
+				uint32_t index_count = 0;
+				vertex_layout_t layout = vertex_layout_t::separate;
+				index_encoding_t index_encoding = index_encoding_t::raw;
+				std::array<section_t, SECTION_COUNT> sections = {};
+				const section_t& section(section_id_t id) const {
+					return sections[static_cast<size_t>(id)];
+				}
+				section_t& section(section_id_t id) {
+					return sections[static_cast<size_t>(id)];
+				}
+			};
+			static_assert(std::is_trivially_copyable_v<header_t>);
+			static_assert(sizeof(header_t) % 8 == 0, "header should have no tail padding that changes between compilers");
+
+			struct cooked_mesh_error_t : std::runtime_error {
+				cooked_mesh_error_t(const filesystem::path& path, const char* what)
+					: std::runtime_error("cooked mesh '" + path.string() + "': " + what) {}
+			};
+
+			/*
+				writes 'model' as a cooked mesh to 'path'
+
+				goes through a temporary file + rename so a reader never maps a half written file
+			*/
+			inline void write(const filesystem::path& path, const model_t& model, const source_key_t& source,
+				vertex_layout_t layout = vertex_layout_t::separate, index_encoding_t index_encoding = index_encoding_t::varint) {
+				header_t header;
+				header.source = source;
+				header.vertex_count = static_cast<uint32_t>(model.vertices.size());
+				header.index_count = static_cast<uint32_t>(model.indices.size());
+				header.layout = layout;
+				header.index_encoding = index_encoding;
+				std::vector<uint8_t> encoded_indices;
+				if (index_encoding == index_encoding_t::varint)
+					encoded_indices = index_codec::encode(model.indices);
+
+				uint64_t end = sizeof(header_t);
+				auto place = [&](section_id_t id, uint64_t size) {
+					end = (end + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+					header.section(id) = section_t{ end, size };
+					end += size;
+				};
+				const uint64_t vertex_count = header.vertex_count;
+				if (has_layout(layout, vertex_layout_t::separate)) {
+					place(section_id_t::positions, vertex_count * sizeof(vec3f));
+					place(section_id_t::texture_coords, vertex_count * sizeof(vec2f));
+					place(section_id_t::normals, vertex_count * sizeof(vec3f));
+				}
+				if (has_layout(layout, vertex_layout_t::interleaved))
+					place(section_id_t::interleaved, vertex_count * sizeof(vertex_t));
+				if (index_encoding == index_encoding_t::varint)
+					place(section_id_t::indices, encoded_indices.size());
+				else
+					place(section_id_t::indices, uint64_t(header.index_count) * sizeof(index_t));
+
+				filesystem::path temporary = path;
+				temporary += ".tmp";
+				{
+					std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+					if (!out)
+						throw cooked_mesh_error_t(temporary, "unable to open for writing");
+					uint64_t written = 0;
+					auto write_section = [&](section_id_t id, const void* data) {
+						const section_t& section = header.section(id);
+						static constexpr char padding[SECTION_ALIGNMENT] = {};
+						out.write(padding, static_cast<std::streamsize>(section.offset - written));
+						out.write(static_cast<const char*>(data), static_cast<std::streamsize>(section.size));
+						written = section.offset + section.size;
+					};
+					out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+					written = sizeof(header);
+					if (has_layout(layout, vertex_layout_t::separate)) {
+						write_section(section_id_t::positions, model.vertices.data());
+						write_section(section_id_t::texture_coords, model.texture_coords.data());
+						write_section(section_id_t::normals, model.normals.data());
+					}
+					if (has_layout(layout, vertex_layout_t::interleaved)) {
+						const std::vector<vertex_t> interleaved = model::interleave(model);
+						write_section(section_id_t::interleaved, interleaved.data());
+					}
+					write_section(section_id_t::indices, index_encoding == index_encoding_t::varint
+						? static_cast<const void*>(encoded_indices.data()) : static_cast<const void*>(model.indices.data()));
+					if (!out)
+						throw cooked_mesh_error_t(temporary, "write failed");
+				}
+				filesystem::rename(temporary, path);
+			}
+
+			/*
+				a mapped cooked mesh, every accessor is a span into the mapping
+
+				missing sections come back as empty spans, check layout() for what was cooked
+				encoded indices get decoded into memory owned by the cooked_mesh_t, everything else stays mapped
+			*/
+			struct cooked_mesh_t {
+				cooked_mesh_t() = default;
+				explicit cooked_mesh_t(const filesystem::path& path) : _file(path) {
+					if (_file.size() < sizeof(header_t))
+						throw cooked_mesh_error_t(path, "too small for a header");
+					std::memcpy(&_header, _file.data(), sizeof(header_t));
+					if (_header.magic != MAGIC)
+						throw cooked_mesh_error_t(path, "not a cooked mesh");
+					if (_header.version != VERSION)
+						throw cooked_mesh_error_t(path, "cooked with a different version");
+					auto expect = [&](section_id_t id, uint64_t element_size, uint64_t count, bool required) {
+						const section_t& section = _header.section(id);
+						if (section.size == 0 && !required)
+							return;
+						if (section.offset % SECTION_ALIGNMENT != 0 || section.offset + section.size > _file.size()
+							|| section.size != element_size * count)
+							throw cooked_mesh_error_t(path, "corrupt section table");
+					};
+					const bool separate = has_layout(_header.layout, vertex_layout_t::separate);
+					const bool interleaved = has_layout(_header.layout, vertex_layout_t::interleaved);
+					expect(section_id_t::positions, sizeof(vec3f), _header.vertex_count, separate);
+					expect(section_id_t::texture_coords, sizeof(vec2f), _header.vertex_count, separate);
+					expect(section_id_t::normals, sizeof(vec3f), _header.vertex_count, separate);
+					expect(section_id_t::interleaved, sizeof(vertex_t), _header.vertex_count, interleaved);
+					//a corrupt file can have the right index count and still point past the vertices
+					auto expect_in_range = [&](std::span<const index_t> indices) {
+						for (const index_t index : indices) {
+							if (index >= _header.vertex_count)
+								throw cooked_mesh_error_t(path, "index out of range");
+						}
+					};
+					if (_header.index_encoding == index_encoding_t::raw) {
+						expect(section_id_t::indices, sizeof(index_t), _header.index_count, true);
+						expect_in_range(section<index_t>(section_id_t::indices));
+					}
+					else if (_header.index_encoding == index_encoding_t::varint) {
+						const section_t& encoded = _header.section(section_id_t::indices);
+						if (encoded.offset % SECTION_ALIGNMENT != 0 || encoded.offset + encoded.size > _file.size())
+							throw cooked_mesh_error_t(path, "corrupt section table");
+						try {
+							_decoded_indices = index_codec::decode(section<uint8_t>(section_id_t::indices), _header.index_count);
+						}
+						catch (const index_codec::index_codec_error_t& e) {
+							throw cooked_mesh_error_t(path, e.what());
+						}
+						expect_in_range(_decoded_indices);
+					}
+					else
+						throw cooked_mesh_error_t(path, "unknown index encoding");
+				}
+				const header_t& header() const {
+					return _header;
+				}
+				vertex_layout_t layout() const {
+					return _header.layout;
+				}
+				size_t vertex_count() const {
+					return _header.vertex_count;
+				}
+				size_t index_count() const {
+					return _header.index_count;
+				}
+				std::span<const vec3f> vertices() const {
+					return section<vec3f>(section_id_t::positions);
+				}
+				std::span<const vec2f> texture_coords() const {
+					return section<vec2f>(section_id_t::texture_coords);
+				}
+				std::span<const vec3f> normals() const {
+					return section<vec3f>(section_id_t::normals);
+				}
+				std::span<const vertex_t> interleaved() const {
+					return section<vertex_t>(section_id_t::interleaved);
+				}
+				std::span<const index_t> indices() const {
+					if (_header.index_encoding != index_encoding_t::raw)
+						return _decoded_indices;
+					return section<index_t>(section_id_t::indices);
+				}
+				//copies back out into a model_t, for CPU side processing
+				model_t to_model() const {
+					if (!has_layout(layout(), vertex_layout_t::separate))
+						return deinterleave(interleaved(), indices());
+					model_t out;
+					out.vertices.assign(vertices().begin(), vertices().end());
+					out.texture_coords.assign(texture_coords().begin(), texture_coords().end());
+					out.normals.assign(normals().begin(), normals().end());
+					out.indices.assign(indices().begin(), indices().end());
+					out.compute_bounds();
+					return out;
+				}
+			private:
+				template<class T>
+				std::span<const T> section(section_id_t id) const {
+					const section_t& s = _header.section(id);
+					if (s.size == 0)
+						return {};
+					return std::span<const T>(reinterpret_cast<const T*>(_file.data() + s.offset), static_cast<size_t>(s.size / sizeof(T)));
+				}
+				mapped_file_t _file;
+				header_t _header;
+				std::vector<index_t> _decoded_indices;
+			};
+
+			/*
+				directory of cooked meshes keyed by source file
+
+				load() hands back the cooked mesh for an OBJ, cooking it first if there is no cooked file
+				or the source changed. a matching path + mtime + size is a hit without reading the source,
+				if only the mtime/size moved the source gets hashed and compared before recooking
+			*/
+			struct mesh_cache_t {
+				filesystem::path directory;
+				vertex_layout_t layout = vertex_layout_t::separate;
+				weld_options_t weld_options = {};
+				bool optimize = true; //vertex cache, overdraw and vertex fetch ordering, see optimize.hpp
+				optimize::options_t optimize_options = {};
+				index_encoding_t index_encoding = index_encoding_t::varint;
+				explicit mesh_cache_t(filesystem::path directory, vertex_layout_t layout = vertex_layout_t::separate)
+					: directory(std::move(directory)), layout(layout) {}
+				filesystem::path cooked_path(const filesystem::path& source) const {
+					char name[17];
+					std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(source_key_t::hash_path(source)));
+					return directory / (std::string(name) + ".fcm");
+				}
+				//everything about cooking that changes the output besides the source, a different value recooks
+				uint64_t options_hash() const {
+					uint64_t h = hash::combine(static_cast<uint64_t>(weld_options.mode), weld::float_bits(weld_options.epsilon));
+					h = hash::combine(h, optimize);
+					if (optimize) {
+						h = hash::combine(h, optimize_options.cache_size);
+						h = hash::combine(h, optimize_options.overdraw);
+						h = hash::combine(h, optimize_options.vertex_fetch);
+					}
+					return h;
+				}
+				cooked_mesh_t load(const filesystem::path& source) {
+					const filesystem::path cooked_file = cooked_path(source);
+					source_key_t key = source_key_t::stat(source);
+					key.options_hash = options_hash();
+					if (filesystem::exists(cooked_file)) {
+						bool touched = false;
+						try {
+							cooked_mesh_t cooked(cooked_file);
+							const source_key_t& cached = cooked.header().source;
+							if (cached.path_hash == key.path_hash && cached.options_hash == key.options_hash && cooked.layout() == layout
+								&& cooked.header().index_encoding == index_encoding) {
+								if (cached.mtime == key.mtime && cached.size == key.size)
+									return cooked;
+								key.content_hash = source_key_t::hash_contents(mapped_file_t(source));
+								touched = cached.size == key.size && cached.content_hash == key.content_hash;
+							}
+						}
+						catch (const cooked_mesh_error_t&) {
+							//corrupt or from another version, fall through and recook
+						}
+						//same contents with a new mtime, store the new key so the next load is a plain hit, recook if that fails
+						if (touched && rewrite_source_key(cooked_file, key))
+							return cooked_mesh_t(cooked_file);
+					}
+					return cook(source, key);
+				}
+				cooked_mesh_t cook(const filesystem::path& source) {
+					source_key_t key = source_key_t::stat(source);
+					key.options_hash = options_hash();
+					return cook(source, key);
+				}
+			private:
+				//patches the key into a copy and renames that over the cooked file like write() does, false if any step failed
+				static bool rewrite_source_key(const filesystem::path& cooked_file, const source_key_t& key) {
+					filesystem::path temporary = cooked_file;
+					temporary += ".tmp";
+					std::error_code error;
+					if (!filesystem::copy_file(cooked_file, temporary, filesystem::copy_options::overwrite_existing, error))
+						return false;
+					bool written = false;
+					{
+						std::fstream file(temporary, std::ios::binary | std::ios::in | std::ios::out);
+						if (file) {
+							file.seekp(offsetof(header_t, source));
+							file.write(reinterpret_cast<const char*>(&key), sizeof(key));
+							file.flush();
+							written = static_cast<bool>(file);
+						}
+					}
+					if (written)
+						filesystem::rename(temporary, cooked_file, error);
+					if (!written || error) {
+						filesystem::remove(temporary, error);
+						return false;
+					}
+					return true;
+				}
+				cooked_mesh_t cook(const filesystem::path& source, source_key_t key) {
+					filesystem::create_directories(directory);
+					const mapped_file_t file(source);
+					key.content_hash = source_key_t::hash_contents(file);
+					model_t model = OBJ_model_t(file.view()).make_model(weld_options);
+					if (optimize)
+						optimize::optimize_model(model, optimize_options);
+					const filesystem::path cooked_file = cooked_path(source);
+					write(cooked_file, model, key, layout, index_encoding);
+					return cooked_mesh_t(cooked_file);
+				}
+			};
+		}
+	}
+}
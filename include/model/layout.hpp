@@ -0,0 +1,110 @@
+#pragma once
+#include <cstring>
+#include <span>
+#include <vector>
+#include "../model.hpp"
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <xmmintrin.h>
+#define FOTON_LAYOUT_SSE
+#endif
+namespace foton {
+	namespace model {
+		/*
+			conversion between the two vertex layouts
+
+			model_t keeps one array per attribute (positions, uvs, normals) which is what CPU side passes want,
+			culling only touches positions and skinning only positions + normals
+			the GPU wants one interleaved vertex_t array (position, normal, uv = 32 bytes) so one vbo feeds every attribute
+
+			4 vertices at a time is exactly 3 position registers, 3 normal registers, 2 uv registers and 8 vertex_t registers
+			so the SSE path is just shuffles between whole registers
+		*/
+		static_assert(sizeof(vec3f) == sizeof(float) * 3 && sizeof(vec2f) == sizeof(float) * 2, "layout conversion assumes packed eigen vectors");
+		static_assert(sizeof(vertex_t) == sizeof(float) * 8);
+		namespace layout {
+			inline void interleave_one(const float* position, const float* normal, const float* uv, float* out) {
+				std::memcpy(out, position, sizeof(float) * 3);
+				std::memcpy(out + 3, normal, sizeof(float) * 3);
+				std::memcpy(out + 6, uv, sizeof(float) * 2);
+			}
+			inline void deinterleave_one(const float* in, float* position, float* normal, float* uv) {
+				std::memcpy(position, in, sizeof(float) * 3);
+				std::memcpy(normal, in + 3, sizeof(float) * 3);
+				std::memcpy(uv, in + 6, sizeof(float) * 2);
+			}
+			//'count' vertices from 3 attribute streams into 'out', none of the pointers need to be aligned
+			inline void interleave(const float* positions, const float* normals, const float* uvs, size_t count, float* out) {
+				size_t i = 0;
+#ifdef FOTON_LAYOUT_SSE
+				for (; i + 4 <= count; i += 4, positions += 12, normals += 12, uvs += 8, out += 32) {
+					const __m128 p0 = _mm_loadu_ps(positions), p1 = _mm_loadu_ps(positions + 4), p2 = _mm_loadu_ps(positions + 8);
+					const __m128 n0 = _mm_loadu_ps(normals), n1 = _mm_loadu_ps(normals + 4), n2 = _mm_loadu_ps(normals + 8);
+					const __m128 t0 = _mm_loadu_ps(uvs), t1 = _mm_loadu_ps(uvs + 4);
+					//vertex 0: p0x p0y p0z n0x | n0y n0z t0x t0y
+					_mm_storeu_ps(out, _mm_shuffle_ps(p0, _mm_shuffle_ps(p0, n0, _MM_SHUFFLE(0, 0, 2, 2)), _MM_SHUFFLE(2, 0, 1, 0)));
+					_mm_storeu_ps(out + 4, _mm_shuffle_ps(n0, t0, _MM_SHUFFLE(1, 0, 2, 1)));
+					//vertex 1
+					_mm_storeu_ps(out + 8, _mm_shuffle_ps(_mm_shuffle_ps(p0, p1, _MM_SHUFFLE(0, 0, 3, 3)),
+						_mm_shuffle_ps(p1, n0, _MM_SHUFFLE(3, 3, 1, 1)), _MM_SHUFFLE(2, 0, 2, 0)));
+					_mm_storeu_ps(out + 12, _mm_shuffle_ps(n1, t0, _MM_SHUFFLE(3, 2, 1, 0)));
+					//vertex 2
+					_mm_storeu_ps(out + 16, _mm_shuffle_ps(p1, _mm_shuffle_ps(p2, n1, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 0, 3, 2)));
+					_mm_storeu_ps(out + 20, _mm_shuffle_ps(_mm_shuffle_ps(n1, n2, _MM_SHUFFLE(0, 0, 3, 3)), t1, _MM_SHUFFLE(1, 0, 2, 0)));
+					//vertex 3
+					_mm_storeu_ps(out + 24, _mm_shuffle_ps(p2, _mm_shuffle_ps(p2, n2, _MM_SHUFFLE(1, 1, 3, 3)), _MM_SHUFFLE(2, 0, 2, 1)));
+					_mm_storeu_ps(out + 28, _mm_shuffle_ps(n2, t1, _MM_SHUFFLE(3, 2, 3, 2)));
+				}
+#endif
+				for (; i < count; i++, positions += 3, normals += 3, uvs += 2, out += 8)
+					interleave_one(positions, normals, uvs, out);
+			}
+			//inverse of interleave()
+			inline void deinterleave(const float* in, size_t count, float* positions, float* normals, float* uvs) {
+				size_t i = 0;
+#ifdef FOTON_LAYOUT_SSE
+				for (; i + 4 <= count; i += 4, positions += 12, normals += 12, uvs += 8, in += 32) {
+					const __m128 o0 = _mm_loadu_ps(in), o1 = _mm_loadu_ps(in + 4), o2 = _mm_loadu_ps(in + 8), o3 = _mm_loadu_ps(in + 12);
+					const __m128 o4 = _mm_loadu_ps(in + 16), o5 = _mm_loadu_ps(in + 20), o6 = _mm_loadu_ps(in + 24), o7 = _mm_loadu_ps(in + 28);
+					_mm_storeu_ps(positions, _mm_shuffle_ps(o0, _mm_shuffle_ps(o0, o2, _MM_SHUFFLE(0, 0, 2, 2)), _MM_SHUFFLE(2, 0, 1, 0)));
+					_mm_storeu_ps(positions + 4, _mm_shuffle_ps(o2, o4, _MM_SHUFFLE(1, 0, 2, 1)));
+					_mm_storeu_ps(positions + 8, _mm_shuffle_ps(_mm_shuffle_ps(o4, o6, _MM_SHUFFLE(0, 0, 2, 2)), o6, _MM_SHUFFLE(2, 1, 2, 0)));
+					_mm_storeu_ps(normals, _mm_shuffle_ps(_mm_shuffle_ps(o0, o1, _MM_SHUFFLE(0, 0, 3, 3)),
+						_mm_shuffle_ps(o1, o2, _MM_SHUFFLE(3, 3, 1, 1)), _MM_SHUFFLE(2, 0, 2, 0)));
+					_mm_storeu_ps(normals + 4, _mm_shuffle_ps(o3, _mm_shuffle_ps(o4, o5, _MM_SHUFFLE(0, 0, 3, 3)), _MM_SHUFFLE(2, 0, 1, 0)));
+					_mm_storeu_ps(normals + 8, _mm_shuffle_ps(_mm_shuffle_ps(o5, o6, _MM_SHUFFLE(3, 3, 1, 1)), o7, _MM_SHUFFLE(1, 0, 2, 0)));
+					_mm_storeu_ps(uvs, _mm_shuffle_ps(o1, o3, _MM_SHUFFLE(3, 2, 3, 2)));
+					_mm_storeu_ps(uvs + 4, _mm_shuffle_ps(o5, o7, _MM_SHUFFLE(3, 2, 3, 2)));
+				}
+#endif
+				for (; i < count; i++, positions += 3, normals += 3, uvs += 2, in += 8)
+					deinterleave_one(in, positions, normals, uvs);
+			}
+		}
+		//model_t -> vertex_t array for GPU upload, indices stay as they are
+		inline void interleave(const model_t& model, vertex_t* out) {
+			if (model.vertices.empty())
+				return;
+			layout::interleave(model.vertices.front().data(), model.normals.front().data(), model.texture_coords.front().data(),
+				model.vertices.size(), reinterpret_cast<float*>(out));
+		}
+		inline std::vector<vertex_t> interleave(const model_t& model) {
+			std::vector<vertex_t> out(model.vertices.size());
+			interleave(model, out.data());
+			return out;
+		}
+		//vertex_t array (e.g. an interleaved cooked mesh) -> model_t for CPU side processing
+		inline model_t deinterleave(std::span<const vertex_t> vertices, std::span<const index_t> indices) {
+			model_t out;
+			out.vertices.resize(vertices.size());
+			out.normals.resize(vertices.size());
+			out.texture_coords.resize(vertices.size());
+			out.indices.assign(indices.begin(), indices.end());
+			if (!vertices.empty()) {
+				layout::deinterleave(reinterpret_cast<const float*>(vertices.data()), vertices.size(),
+					out.vertices.front().data(), out.normals.front().data(), out.texture_coords.front().data());
+			}
+			out.compute_bounds();
+			return out;
+		}
+	}
+}
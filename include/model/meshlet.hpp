@@ -0,0 +1,221 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "../model.hpp"
+#include "optimize.hpp"
+namespace foton {
+	namespace model {
+		/*
+			splits a model into small clusters (meshlets) that can be culled on their own
+
+			the builder reorders model_t::indices so every meshlet is one contiguous range of it,
+			a culled draw is then just a list of (first_index, count) ranges into the unchanged ebo
+			clusters grow over shared vertices so they stay compact, which keeps the bounds and cones tight
+		*/
+		namespace meshlet {
+			static constexpr size_t MAX_VERTICES = 64;
+			static constexpr size_t MAX_TRIANGLES = 124;
+			struct bounds_t {
+				vec3f center = vec3f::Zero();
+				float radius = 0.f;
+				/*
+					backface cone, every triangle faces away from a camera at 'position' when
+					dot(normalize(cone_apex - position), cone_axis) >= cone_cutoff
+					a cutoff above 1 never culls (the normals spread over more than a hemisphere)
+				*/
+				vec3f cone_apex = vec3f::Zero();
+				vec3f cone_axis = vec3f::UnitZ();
+				float cone_cutoff = 2.f;
+				bool backfacing_from(const vec3f& position) const {
+					const vec3f to_apex = cone_apex - position;
+					const float length = to_apex.norm();
+					return length > 0.f && to_apex.dot(cone_axis) >= cone_cutoff * length;
+				}
+			};
+			struct meshlet_t {
+				uint32_t first_index; //into model_t::indices
+				uint32_t triangle_count;
+				uint32_t vertex_count;
+				bounds_t bounds;
+				uint32_t index_count() const {
+					return triangle_count * 3;
+				}
+			};
+			struct meshlets_t {
+				std::vector<meshlet_t> meshlets;
+				//whole model, for culling the object before its meshlets
+				vec3f center = vec3f::Zero();
+				float radius = 0.f;
+			};
+			//Ritter's sphere, a few percent bigger than optimal but linear
+			template<class PointsT>
+			inline void bounding_sphere(const PointsT& points, vec3f& center, float& radius) {
+				if (points.empty()) {
+					center = vec3f::Zero();
+					radius = 0.f;
+					return;
+				}
+				auto furthest = [&](const vec3f& from) {
+					vec3f best = from;
+					float best_distance = -1.f;
+					for (const vec3f& p : points) {
+						const float d = (p - from).squaredNorm();
+						if (d > best_distance) {
+							best_distance = d;
+							best = p;
+						}
+					}
+					return best;
+				};
+				const vec3f a = furthest(points.front());
+				const vec3f b = furthest(a);
+				center = (a + b) * 0.5f;
+				radius = (b - a).norm() * 0.5f;
+				for (const vec3f& p : points) {
+					const float d = (p - center).norm();
+					if (d > radius) {
+						const float grown = (radius + d) * 0.5f;
+						center += (p - center) * ((grown - radius) / d);
+						radius = grown;
+					}
+				}
+			}
+			inline bounds_t compute_bounds(std::span<const index_t> indices, std::span<const vec3f> positions) {
+				bounds_t bounds;
+				std::vector<vec3f> corners;
+				corners.reserve(indices.size());
+				for (const index_t i : indices)
+					corners.push_back(positions[i]);
+				bounding_sphere(corners, bounds.center, bounds.radius);
+
+				const size_t triangle_count = indices.size() / 3;
+				std::vector<vec3f> normals;
+				normals.reserve(triangle_count);
+				vec3f axis = vec3f::Zero();
+				for (size_t t = 0; t < triangle_count; t++) {
+					const vec3f& p0 = corners[t * 3];
+					const vec3f normal = (corners[t * 3 + 1] - p0).cross(corners[t * 3 + 2] - p0);
+					const float length = normal.norm();
+					if (length == 0.f)
+						continue; //degenerate triangles can't be seen from anywhere
+					normals.push_back(normal / length);
+					axis += normals.back();
+				}
+				const float axis_length = axis.norm();
+				if (normals.empty() || axis_length == 0.f)
+					return bounds;
+				axis /= axis_length;
+				float min_dot = 1.f;
+				for (const vec3f& n : normals)
+					min_dot = std::min(min_dot, n.dot(axis));
+				if (min_dot <= 0.1f)
+					return bounds; //spread over (almost) a hemisphere, the cone would never cull
+				//slide the apex back along the axis until it's behind every triangle's plane
+				float max_t = 0.f;
+				for (size_t t = 0, n = 0; t < triangle_count; t++) {
+					const vec3f& p0 = corners[t * 3];
+					const vec3f normal = (corners[t * 3 + 1] - p0).cross(corners[t * 3 + 2] - p0);
+					if (normal.norm() == 0.f)
+						continue;
+					const vec3f& unit = normals[n++];
+					max_t = std::max(max_t, (bounds.center - p0).dot(unit) / unit.dot(axis));
+				}
+				bounds.cone_apex = bounds.center - axis * max_t;
+				bounds.cone_axis = axis;
+				bounds.cone_cutoff = std::sqrt(1.f - min_dot * min_dot);
+				return bounds;
+			}
+			/*
+				greedy cluster growth: a meshlet keeps taking the neighbouring triangle that adds the fewest new vertices
+				(closest to the meshlet's centroid on ties) until it runs out of vertex/triangle budget or neighbours
+				indices come out in meshlet order, the vertex arrays are untouched
+			*/
+			inline meshlets_t build(model_t& model, size_t max_vertices = MAX_VERTICES, size_t max_triangles = MAX_TRIANGLES) {
+				meshlets_t out;
+				const size_t vertex_count = model.vertices.size();
+				const size_t triangle_count = model.indices.size() / 3;
+				bounding_sphere(model.vertices, out.center, out.radius);
+				if (triangle_count == 0)
+					return out;
+				const optimize::adjacency_t adjacency(model.indices, vertex_count);
+				const std::vector<index_t>& indices = model.indices;
+				std::vector<bool> emitted(triangle_count, false);
+				std::vector<uint32_t> vertex_stamp(vertex_count, 0); //== meshlet number + 1 if the vertex is in that meshlet
+				std::vector<index_t> reordered;
+				reordered.reserve(indices.size());
+				std::vector<uint32_t> candidates;
+				size_t seed_cursor = 0;
+				uint32_t stamp = 0;
+				while (true) {
+					while (seed_cursor < triangle_count && emitted[seed_cursor])
+						seed_cursor++;
+					if (seed_cursor == triangle_count)
+						break;
+					stamp++;
+					meshlet_t meshlet{ static_cast<uint32_t>(reordered.size()), 0, 0, {} };
+					vec3f centroid_sum = vec3f::Zero();
+					candidates.clear();
+					auto new_vertices = [&](uint32_t t) {
+						size_t n = 0;
+						for (size_t c = 0; c < 3; c++)
+							n += vertex_stamp[indices[t * 3 + c]] != stamp;
+						return n;
+					};
+					auto add = [&](uint32_t t) {
+						emitted[t] = true;
+						for (size_t c = 0; c < 3; c++) {
+							const index_t v = indices[t * 3 + c];
+							reordered.push_back(v);
+							if (vertex_stamp[v] == stamp)
+								continue;
+							vertex_stamp[v] = stamp;
+							meshlet.vertex_count++;
+							centroid_sum += model.vertices[v];
+							for (const uint32_t neighbour : adjacency.of(v)) {
+								if (!emitted[neighbour])
+									candidates.push_back(neighbour);
+							}
+						}
+						meshlet.triangle_count++;
+					};
+					add(static_cast<uint32_t>(seed_cursor));
+					while (meshlet.triangle_count < max_triangles) {
+						const vec3f centroid = centroid_sum / static_cast<float>(meshlet.vertex_count);
+						size_t best = SIZE_MAX;
+						size_t best_new = 4;
+						float best_distance = std::numeric_limits<float>::max();
+						for (size_t i = 0; i < candidates.size();) {
+							const uint32_t t = candidates[i];
+							if (emitted[t]) {
+								candidates[i] = candidates.back();
+								candidates.pop_back();
+								continue;
+							}
+							const size_t extra = new_vertices(t);
+							if (meshlet.vertex_count + extra <= max_vertices && extra <= best_new) {
+								const vec3f& p0 = model.vertices[indices[t * 3]];
+								const float distance = (p0 - centroid).squaredNorm();
+								if (extra < best_new || distance < best_distance) {
+									best = i;
+									best_new = extra;
+									best_distance = distance;
+								}
+							}
+							i++;
+						}
+						if (best == SIZE_MAX)
+							break;
+						add(candidates[best]);
+					}
+					meshlet.bounds = compute_bounds(std::span<const index_t>(reordered.data() + meshlet.first_index, meshlet.index_count()), model.vertices);
+					out.meshlets.push_back(meshlet);
+				}
+				model.indices = std::move(reordered);
+				return out;
+			}
+		}
+	}
+}
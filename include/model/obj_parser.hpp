@@ -0,0 +1,363 @@
+#pragma once
+#include <charconv>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../types.hpp"
+#include "../utility/thread_pool.hpp"
+namespace foton {
+	namespace model {
+		namespace obj {
+			/*
+				allocation free OBJ parser
+
+				works on the whole file as one buffer (usually a mapped_file_t) instead of a std::istream,
+				numbers go through std::from_chars so there is no locale or stream state involved
+				and nothing gets allocated per line, the output arrays are sized once from a counting pass
+			*/
+			struct record_counts_t {
+				size_t vertices = 0;
+				size_t texture_coords = 0;
+				size_t normals = 0;
+				size_t faces = 0; //face lines, polygons with more than 3 corners turn into more triangles than this
+				size_t lines = 0;
+				record_counts_t& operator+=(const record_counts_t& other) {
+					vertices += other.vertices;
+					texture_coords += other.texture_coords;
+					normals += other.normals;
+					faces += other.faces;
+					lines += other.lines;
+					return *this;
+				}
+			};
+			enum class record_t {
+				unknown, //comments, mtllib, usemtl, g, s, etc
+				vertex,
+				texture_coord,
+				normal,
+				face,
+				object_name
+			};
+			namespace detail {
+				inline bool is_blank(char c) {
+					return c == ' ' || c == '\t' || c == '\r';
+				}
+				inline const char* skip_blanks(const char* it, const char* end) {
+					while (it != end && is_blank(*it))
+						++it;
+					return it;
+				}
+				inline const char* line_end(const char* it, const char* end) {
+					const void* newline = std::memchr(it, '\n', static_cast<size_t>(end - it));
+					return newline ? static_cast<const char*>(newline) : end;
+				}
+				inline const char* next_line(const char* eol, const char* end) {
+					return eol == end ? end : eol + 1;
+				}
+				//moves 'it' past the opcode if there is one
+				inline record_t classify(const char*& it, const char* end) {
+					auto opcode_ends_at = [&](ptrdiff_t length) {
+						return end - it == length || (end - it > length && is_blank(it[length]));
+					};
+					if (it == end)
+						return record_t::unknown;
+					record_t record = record_t::unknown;
+					ptrdiff_t length = 1;
+					switch (*it) {
+					case 'v':
+						if (opcode_ends_at(1)) {
+							record = record_t::vertex;
+						}
+						else if (end - it > 1 && opcode_ends_at(2)) {
+							length = 2;
+							if (it[1] == 't')
+								record = record_t::texture_coord;
+							else if (it[1] == 'n')
+								record = record_t::normal;
+						}
+						break;
+					case 'f':
+						if (opcode_ends_at(1))
+							record = record_t::face;
+						break;
+					case 'o':
+						if (opcode_ends_at(1))
+							record = record_t::object_name;
+						break;
+					default:
+						break;
+					}
+					if (record != record_t::unknown)
+						it += length;
+					return record;
+				}
+				//reads up to 'max_count' floats, returns how many were read
+				inline size_t parse_floats(const char*& it, const char* end, float* out, size_t max_count) {
+					size_t count = 0;
+					for (; count < max_count; count++) {
+						it = skip_blanks(it, end);
+						if (it != end && *it == '+') //from_chars doesn't take a leading '+'
+							++it;
+						auto [ptr, err] = std::from_chars(it, end, out[count]);
+						if (err != std::errc())
+							break;
+						it = ptr;
+					}
+					return count;
+				}
+				inline bool parse_index(const char*& it, const char* end, long long& out) {
+					auto [ptr, err] = std::from_chars(it, end, out);
+					if (err != std::errc() || out == 0)
+						return false;
+					it = ptr;
+					return true;
+				}
+				//OBJ indices are 1 based, negative indices are relative to the end of what has been read so far
+				//either way they have to point at a record that came before, 0 is never valid
+				inline bool resolve_index(long long raw, size_t count_so_far, size_t& out) {
+					if (raw > 0) {
+						if (static_cast<unsigned long long>(raw) > count_so_far)
+							return false;
+						out = static_cast<size_t>(raw - 1);
+						return true;
+					}
+					if (raw == 0 || static_cast<size_t>(-raw) > count_so_far)
+						return false;
+					out = count_so_far - static_cast<size_t>(-raw);
+					return true;
+				}
+			}
+			inline record_counts_t count_records(std::string_view text) {
+				record_counts_t counts;
+				const char* it = text.data();
+				const char* const end = it + text.size();
+				while (it != end) {
+					counts.lines++;
+					const char* eol = detail::line_end(it, end);
+					const char* cursor = detail::skip_blanks(it, eol);
+					switch (detail::classify(cursor, eol)) {
+					case record_t::vertex:
+						counts.vertices++;
+						break;
+					case record_t::texture_coord:
+						counts.texture_coords++;
+						break;
+					case record_t::normal:
+						counts.normals++;
+						break;
+					case record_t::face:
+						counts.faces++;
+						break;
+					default:
+						break;
+					}
+					it = detail::next_line(eol, end);
+				}
+				return counts;
+			}
+			/*
+				appends every v/vt/vn/f record in 'text' to 'out' without reserving anything
+
+				'base' is how many records came before 'text' that aren't in 'out' (used when 'text' is one chunk of a bigger file),
+				negative indices get resolved against base + what is in 'out'
+			*/
+			template<class ModelT>
+			void parse_records(std::string_view text, ModelT& out, const record_counts_t& base, std::string_view* object_name = nullptr) {
+				using face_t = typename ModelT::multiindex_face_t;
+				using corner_t = typename face_t::vertex_indices_t;
+				using error_t = typename ModelT::model_loading_error_t;
+
+				const char* it = text.data();
+				const char* const end = it + text.size();
+				size_t line_number = base.lines;
+				auto fail = [&](const char* what) {
+					throw error_t("obj line " + std::to_string(line_number) + ": " + what);
+				};
+				auto parse_corner = [&](const char*& cursor, const char* eol) {
+					corner_t corner = { ModelT::MISSING_INDEX, ModelT::MISSING_INDEX, ModelT::MISSING_INDEX };
+					long long raw = 0;
+					if (!detail::parse_index(cursor, eol, raw) || !detail::resolve_index(raw, base.vertices + out.vertices.size(), corner.vertex_i))
+						fail("invalid vertex index");
+					if (cursor == eol || *cursor != '/')
+						return corner;
+					++cursor;
+					if (cursor != eol && *cursor != '/') {
+						if (!detail::parse_index(cursor, eol, raw) || !detail::resolve_index(raw, base.texture_coords + out.texture_coords.size(), corner.texture_coords_i))
+							fail("invalid texture coord index");
+					}
+					if (cursor == eol || *cursor != '/')
+						return corner;
+					++cursor;
+					if (!detail::parse_index(cursor, eol, raw) || !detail::resolve_index(raw, base.normals + out.normals.size(), corner.normals_i))
+						fail("invalid normal index");
+					return corner;
+				};
+				while (it != end) {
+					line_number++;
+					const char* eol = detail::line_end(it, end);
+					const char* cursor = detail::skip_blanks(it, eol);
+					switch (detail::classify(cursor, eol)) {
+					case record_t::vertex: {
+						float v[3];
+						if (detail::parse_floats(cursor, eol, v, 3) != 3)
+							fail("vertex needs 3 components");
+						out.vertices.emplace_back(v[0], v[1], v[2]);
+						break;
+					}
+					case record_t::texture_coord: {
+						float uv[2] = { 0.f, 0.f };
+						if (detail::parse_floats(cursor, eol, uv, 2) == 0)
+							fail("texture coord needs atleast 1 component");
+						out.texture_coords.emplace_back(uv[0], uv[1]);
+						break;
+					}
+					case record_t::normal: {
+						float n[3];
+						if (detail::parse_floats(cursor, eol, n, 3) != 3)
+							fail("normal needs 3 components");
+						out.normals.emplace_back(n[0], n[1], n[2]);
+						break;
+					}
+					case record_t::face: {
+						corner_t first, previous;
+						size_t corner_count = 0;
+						for (cursor = detail::skip_blanks(cursor, eol); cursor != eol; cursor = detail::skip_blanks(cursor, eol)) {
+							const corner_t corner = parse_corner(cursor, eol);
+							if (cursor != eol && !detail::is_blank(*cursor))
+								fail("unexpected character in face");
+							if (corner_count == 0)
+								first = corner;
+							else if (corner_count >= 2)
+								out.faces.push_back(face_t{ first, previous, corner });
+							previous = corner;
+							corner_count++;
+						}
+						if (corner_count < 3)
+							fail("face needs atleast 3 corners");
+						break;
+					}
+					case record_t::object_name:
+						if (object_name) {
+							cursor = detail::skip_blanks(cursor, eol);
+							const char* name_end = eol;
+							while (name_end != cursor && detail::is_blank(name_end[-1]))
+								--name_end;
+							*object_name = std::string_view(cursor, static_cast<size_t>(name_end - cursor));
+						}
+						break;
+					default:
+						break;
+					}
+					it = detail::next_line(eol, end);
+				}
+			}
+			/*
+				appends every v/vt/vn/f record in 'text' to 'out'
+
+				ModelT is anything shaped like multiindex_model_t, face indices come out 0 based and absolute,
+				a corner without a texture coord or normal gets ModelT::MISSING_INDEX
+				polygons are fanned into triangles
+			*/
+			template<class ModelT>
+			void parse(std::string_view text, ModelT& out, std::string_view* object_name = nullptr) {
+				const record_counts_t counts = count_records(text);
+				out.vertices.reserve(out.vertices.size() + counts.vertices);
+				out.texture_coords.reserve(out.texture_coords.size() + counts.texture_coords);
+				out.normals.reserve(out.normals.size() + counts.normals);
+				out.faces.reserve(out.faces.size() + counts.faces);
+				parse_records(text, out, record_counts_t{}, object_name);
+			}
+			//same arrays parse() fills, used as the thread local output of one chunk
+			template<class ModelT>
+			struct chunk_model_t {
+				using multiindex_face_t = typename ModelT::multiindex_face_t;
+				using model_loading_error_t = typename ModelT::model_loading_error_t;
+				static constexpr size_t MISSING_INDEX = ModelT::MISSING_INDEX;
+				decltype(ModelT::vertices) vertices;
+				decltype(ModelT::normals) normals;
+				decltype(ModelT::texture_coords) texture_coords;
+				decltype(ModelT::faces) faces;
+			};
+			static constexpr size_t PARALLEL_CHUNK_SIZE = 1 << 20; //smaller files aren't worth waking the pool for
+			/*
+				parse() split across a thread pool, the output is identical to parse()
+
+				the text gets cut into chunks at line boundaries, a counting pass gives every chunk
+				its prefix sums so relative face indices and line numbers resolve like they would serially,
+				then chunks parse into thread local arrays that get stitched into 'out' at their prefix offsets
+			*/
+			template<class ModelT>
+			void parse_parallel(std::string_view text, ModelT& out, thread_pool_t& pool = thread_pool_t::shared(), std::string_view* object_name = nullptr) {
+				const size_t chunk_count = std::min(text.size() / PARALLEL_CHUNK_SIZE, pool.thread_count() * 4);
+				if (chunk_count <= 1) {
+					parse(text, out, object_name);
+					return;
+				}
+				std::vector<std::string_view> chunks;
+				chunks.reserve(chunk_count);
+				const char* const end = text.data() + text.size();
+				const char* chunk_start = text.data();
+				for (size_t i = 1; i <= chunk_count && chunk_start != end; i++) {
+					const char* chunk_end = i == chunk_count ? end : text.data() + text.size() * i / chunk_count;
+					if (chunk_end < chunk_start)
+						chunk_end = chunk_start;
+					if (chunk_end != end)
+						chunk_end = detail::next_line(detail::line_end(chunk_end, end), end);
+					chunks.emplace_back(chunk_start, static_cast<size_t>(chunk_end - chunk_start));
+					chunk_start = chunk_end;
+				}
+
+				std::vector<record_counts_t> counts(chunks.size());
+				pool.parallel_for(chunks.size(), [&](size_t i) {
+					counts[i] = count_records(chunks[i]);
+				});
+				std::vector<record_counts_t> bases(chunks.size());
+				record_counts_t running;
+				for (size_t i = 0; i < chunks.size(); i++) {
+					bases[i] = running;
+					running += counts[i];
+				}
+
+				std::vector<chunk_model_t<ModelT>> parsed(chunks.size());
+				std::vector<std::string_view> names(chunks.size());
+				pool.parallel_for(chunks.size(), [&](size_t i) {
+					chunk_model_t<ModelT>& chunk = parsed[i];
+					chunk.vertices.reserve(counts[i].vertices);
+					chunk.texture_coords.reserve(counts[i].texture_coords);
+					chunk.normals.reserve(counts[i].normals);
+					chunk.faces.reserve(counts[i].faces);
+					record_counts_t base = bases[i];
+					base.vertices += out.vertices.size();
+					base.texture_coords += out.texture_coords.size();
+					base.normals += out.normals.size();
+					parse_records(chunks[i], chunk, base, &names[i]);
+				});
+
+				auto stitch = [&](auto& destination, auto member) {
+					std::vector<size_t> offsets(parsed.size());
+					size_t total = destination.size();
+					for (size_t i = 0; i < parsed.size(); i++) {
+						offsets[i] = total;
+						total += (parsed[i].*member).size();
+					}
+					destination.resize(total);
+					pool.parallel_for(parsed.size(), [&](size_t i) {
+						const auto& source = parsed[i].*member;
+						std::copy(source.begin(), source.end(), destination.begin() + offsets[i]);
+					});
+				};
+				stitch(out.vertices, &chunk_model_t<ModelT>::vertices);
+				stitch(out.texture_coords, &chunk_model_t<ModelT>::texture_coords);
+				stitch(out.normals, &chunk_model_t<ModelT>::normals);
+				stitch(out.faces, &chunk_model_t<ModelT>::faces);
+				if (object_name) {
+					for (const std::string_view& name : names) {
+						if (name.data() != nullptr) //the last 'o' wins, same as parse()
+							*object_name = name;
+					}
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,233 @@
+#pragma once
+#include <algorithm>
+#include <numeric>
+#include <span>
+#include <vector>
+#include "../model.hpp"
+namespace foton {
+	namespace model {
+		/*
+			index/vertex buffer optimization, meant to run while cooking so it costs nothing at load
+
+			1. vertex cache: triangles get reordered with tipsify (Sander, Nehab, Barczak 2007) so vertices
+			   that were just transformed get reused while they are still in the post transform cache
+			2. overdraw: tipsify's output is cut into clusters where it had to jump, the clusters get sorted
+			   so the ones facing away from the middle of the mesh (likely to occlude) draw first
+			3. vertex fetch: vertices get renumbered in the order the index buffer first uses them so
+			   the attribute reads walk memory forwards, unused vertices get dropped
+		*/
+		namespace optimize {
+			static constexpr size_t DEFAULT_CACHE_SIZE = 16;
+			struct vertex_cache_stats_t {
+				size_t triangles = 0;
+				size_t vertices = 0;
+				size_t transformed = 0; //cache misses
+				//average cache miss ratio, transformed vertices per triangle (0.5 is the ideal for a big grid, 3 is no reuse at all)
+				float acmr() const {
+					return triangles ? static_cast<float>(transformed) / triangles : 0.f;
+				}
+				//average transform to vertex ratio, 1 is ideal
+				float atvr() const {
+					return vertices ? static_cast<float>(transformed) / vertices : 0.f;
+				}
+			};
+			//simulates a FIFO post transform cache of 'cache_size' entries
+			inline vertex_cache_stats_t analyze_vertex_cache(std::span<const index_t> indices, size_t vertex_count, size_t cache_size = DEFAULT_CACHE_SIZE) {
+				vertex_cache_stats_t stats;
+				stats.triangles = indices.size() / 3;
+				stats.vertices = vertex_count;
+				std::vector<size_t> inserted_at(vertex_count, 0); //fifo_head right after a vertex was inserted, 0 = never
+				size_t fifo_head = 0;
+				for (const index_t i : indices) {
+					if (inserted_at[i] == 0 || fifo_head - inserted_at[i] >= cache_size) {
+						inserted_at[i] = ++fifo_head;
+						stats.transformed++;
+					}
+				}
+				return stats;
+			}
+			//vertex -> triangles that use it, as one flat array
+			struct adjacency_t {
+				std::vector<uint32_t> offsets; //vertex_count + 1
+				std::vector<uint32_t> triangles;
+				adjacency_t(std::span<const index_t> indices, size_t vertex_count) : offsets(vertex_count + 1, 0), triangles(indices.size()) {
+					for (const index_t i : indices)
+						offsets[i + 1]++;
+					std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+					std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+					for (size_t i = 0; i < indices.size(); i++)
+						triangles[cursor[indices[i]]++] = static_cast<uint32_t>(i / 3);
+				}
+				std::span<const uint32_t> of(index_t vertex) const {
+					return std::span<const uint32_t>(triangles.data() + offsets[vertex], offsets[vertex + 1] - offsets[vertex]);
+				}
+			};
+			/*
+				reorders the triangles in 'indices' for the post transform cache, linear time
+				returns where each cluster starts (in triangles), a new cluster starts every time tipsify hits a dead end
+			*/
+			inline std::vector<uint32_t> tipsify(std::vector<index_t>& indices, size_t vertex_count, size_t cache_size = DEFAULT_CACHE_SIZE) {
+				const size_t triangle_count = indices.size() / 3;
+				std::vector<uint32_t> cluster_starts;
+				if (triangle_count == 0)
+					return cluster_starts;
+				const adjacency_t adjacency(indices, vertex_count);
+				std::vector<uint32_t> live(vertex_count);
+				for (size_t v = 0; v < vertex_count; v++)
+					live[v] = static_cast<uint32_t>(adjacency.of(static_cast<index_t>(v)).size());
+				std::vector<size_t> cache_time(vertex_count, 0);
+				std::vector<bool> emitted(triangle_count, false);
+				std::vector<index_t> dead_end_stack;
+				std::vector<index_t> candidates;
+				std::vector<index_t> out;
+				out.reserve(indices.size());
+				size_t time = cache_size + 1;
+				size_t scan_cursor = 0; //next vertex in input order to try after a dead end
+				auto skip_dead_end = [&]() -> int64_t {
+					while (!dead_end_stack.empty()) {
+						const index_t d = dead_end_stack.back();
+						dead_end_stack.pop_back();
+						if (live[d] > 0)
+							return d;
+					}
+					for (; scan_cursor < vertex_count; scan_cursor++) {
+						if (live[scan_cursor] > 0)
+							return static_cast<int64_t>(scan_cursor);
+					}
+					return -1;
+				};
+				int64_t fanning = skip_dead_end();
+				cluster_starts.push_back(0);
+				while (fanning >= 0) {
+					candidates.clear();
+					for (const uint32_t t : adjacency.of(static_cast<index_t>(fanning))) {
+						if (emitted[t])
+							continue;
+						emitted[t] = true;
+						for (size_t corner = 0; corner < 3; corner++) {
+							const index_t v = indices[t * 3 + corner];
+							out.push_back(v);
+							dead_end_stack.push_back(v);
+							candidates.push_back(v);
+							live[v]--;
+							if (time - cache_time[v] > cache_size)
+								cache_time[v] = time++;
+						}
+					}
+					//pick the candidate that will still be in the cache after its remaining triangles are emitted, oldest first
+					int64_t next = -1;
+					int64_t best_priority = -1;
+					for (const index_t v : candidates) {
+						if (live[v] == 0)
+							continue;
+						int64_t priority = 0;
+						if (time - cache_time[v] + 2 * live[v] <= cache_size)
+							priority = static_cast<int64_t>(time - cache_time[v]);
+						if (priority > best_priority) {
+							best_priority = priority;
+							next = v;
+						}
+					}
+					if (next == -1) {
+						next = skip_dead_end();
+						if (next >= 0 && out.size() / 3 > cluster_starts.back())
+							cluster_starts.push_back(static_cast<uint32_t>(out.size() / 3));
+					}
+					fanning = next;
+				}
+				indices = std::move(out);
+				return cluster_starts;
+			}
+			/*
+				sorts the clusters tipsify made so outward facing ones draw first
+
+				a cluster's score is how much its average normal points away from the mesh centroid at its own centroid,
+				big positive scores are on the outside of the mesh and occlude the rest
+			*/
+			inline void sort_clusters_for_overdraw(std::vector<index_t>& indices, std::span<const vec3f> positions, const std::vector<uint32_t>& cluster_starts) {
+				const size_t triangle_count = indices.size() / 3;
+				if (cluster_starts.size() <= 1)
+					return;
+				vec3f mesh_centroid = vec3f::Zero();
+				float mesh_area = 0.f;
+				struct cluster_t {
+					uint32_t start;
+					uint32_t end;
+					float score;
+				};
+				std::vector<cluster_t> clusters(cluster_starts.size());
+				std::vector<vec3f> centroids(clusters.size());
+				std::vector<vec3f> normals(clusters.size());
+				for (size_t c = 0; c < clusters.size(); c++) {
+					clusters[c].start = cluster_starts[c];
+					clusters[c].end = c + 1 < cluster_starts.size() ? cluster_starts[c + 1] : static_cast<uint32_t>(triangle_count);
+					vec3f centroid = vec3f::Zero();
+					vec3f normal = vec3f::Zero();
+					float area = 0.f;
+					for (uint32_t t = clusters[c].start; t < clusters[c].end; t++) {
+						const vec3f& p0 = positions[indices[t * 3]];
+						const vec3f& p1 = positions[indices[t * 3 + 1]];
+						const vec3f& p2 = positions[indices[t * 3 + 2]];
+						const vec3f cross = (p1 - p0).cross(p2 - p0);
+						const float triangle_area = cross.norm();
+						centroid += (p0 + p1 + p2) * (triangle_area / 3.f);
+						normal += cross; //area weighted already
+						area += triangle_area;
+					}
+					mesh_centroid += centroid;
+					mesh_area += area;
+					centroids[c] = area > 0.f ? vec3f(centroid / area) : vec3f(positions[indices[clusters[c].start * 3]]);
+					normals[c] = normal;
+				}
+				if (mesh_area > 0.f)
+					mesh_centroid /= mesh_area;
+				for (size_t c = 0; c < clusters.size(); c++) {
+					const float length = normals[c].norm();
+					clusters[c].score = length > 0.f ? (centroids[c] - mesh_centroid).dot(normals[c] / length) : 0.f;
+				}
+				std::stable_sort(clusters.begin(), clusters.end(), [](const cluster_t& a, const cluster_t& b) {
+					return a.score > b.score;
+				});
+				std::vector<index_t> out;
+				out.reserve(indices.size());
+				for (const cluster_t& cluster : clusters)
+					out.insert(out.end(), indices.begin() + cluster.start * 3, indices.begin() + cluster.end * 3);
+				indices = std::move(out);
+			}
+			//renumbers vertices in first use order and drops the ones no triangle uses
+			inline void optimize_vertex_fetch(model_t& model) {
+				std::vector<index_t> remap(model.vertices.size(), INVALID_INDEX);
+				index_t next = 0;
+				for (index_t& i : model.indices) {
+					if (remap[i] == INVALID_INDEX)
+						remap[i] = next++;
+					i = remap[i];
+				}
+				auto reorder = [&](auto& attribute) {
+					std::remove_reference_t<decltype(attribute)> reordered(next);
+					for (size_t old = 0; old < remap.size(); old++) {
+						if (remap[old] != INVALID_INDEX)
+							reordered[remap[old]] = attribute[old];
+					}
+					attribute = std::move(reordered);
+				};
+				reorder(model.vertices);
+				reorder(model.texture_coords);
+				reorder(model.normals);
+			}
+			struct options_t {
+				size_t cache_size = DEFAULT_CACHE_SIZE;
+				bool overdraw = true;
+				bool vertex_fetch = true;
+			};
+			//all three passes, in the order they have to run in
+			inline void optimize_model(model_t& model, const options_t& options = {}) {
+				const std::vector<uint32_t> clusters = tipsify(model.indices, model.vertices.size(), options.cache_size);
+				if (options.overdraw)
+					sort_clusters_for_overdraw(model.indices, model.vertices, clusters);
+				if (options.vertex_fetch)
+					optimize_vertex_fetch(model);
+			}
+		}
+	}
+}
@@ -0,0 +1,173 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "../model.hpp"
+#include "../utility/half.hpp"
+namespace foton {
+	namespace model {
+		/*
+			smaller vertex formats for static meshes, vertex_t is 32 bytes of floats
+
+			positions: 3 x unorm16 relative to the mesh's bounding box, the shader (or model matrix) maps them back with
+			           quantization_t::dequantize_matrix(), error is extent / 131070 per axis
+			normals:   octahedral (the unit sphere folded onto a square) in 2 x snorm16 or 2 x snorm8, the shader has to
+			           unfold them, see OCTAHEDRAL_DECODE_GLSL
+			uvs:       2 x half float, exact for textures up to 2048 texels wide in [0, 1]
+
+			packed_vertex16_t is 16 bytes (half of vertex_t), packed_vertex12_t trades normal precision for 12 bytes
+			every attribute is a normalized integer or half float so glVertexAttribPointer does the conversion for free
+		*/
+		namespace quantize {
+			inline int16_t to_snorm16(float v) {
+				return static_cast<int16_t>(std::lround(std::clamp(v, -1.f, 1.f) * 32767.f));
+			}
+			inline int8_t to_snorm8(float v) {
+				return static_cast<int8_t>(std::lround(std::clamp(v, -1.f, 1.f) * 127.f));
+			}
+			//how GL turns a snorm back into a float
+			inline float from_snorm16(int16_t v) {
+				return std::max(v / 32767.f, -1.f);
+			}
+			inline float from_snorm8(int8_t v) {
+				return std::max(v / 127.f, -1.f);
+			}
+			inline vec2f octahedral_encode(const vec3f& n) {
+				const float sum = std::abs(n.x()) + std::abs(n.y()) + std::abs(n.z());
+				if (sum == 0.f)
+					return vec2f(0.f, 0.f);
+				vec2f out(n.x() / sum, n.y() / sum);
+				if (n.z() < 0.f) { //fold the lower hemisphere over the diagonals
+					const vec2f folded((1.f - std::abs(out.y())) * (out.x() >= 0.f ? 1.f : -1.f),
+						(1.f - std::abs(out.x())) * (out.y() >= 0.f ? 1.f : -1.f));
+					out = folded;
+				}
+				return out;
+			}
+			inline vec3f octahedral_decode(const vec2f& e) {
+				vec3f n(e.x(), e.y(), 1.f - std::abs(e.x()) - std::abs(e.y()));
+				const float t = std::max(-n.z(), 0.f);
+				n.x() += n.x() >= 0.f ? -t : t;
+				n.y() += n.y() >= 0.f ? -t : t;
+				return n.normalized();
+			}
+			//same decode for the vertex shader, takes the (already normalized by GL) snorm pair
+			static constexpr const char* OCTAHEDRAL_DECODE_GLSL = R"(
+vec3 octahedral_decode(vec2 e) {
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
+)";
+			//maps positions into [0, 1]^3 of the mesh's bounding box and back
+			struct quantization_t {
+				vec3f min = vec3f::Zero();
+				vec3f extent = vec3f::Ones();
+				static quantization_t from_positions(const std::vector<vec3f>& positions) {
+					quantization_t out;
+					if (positions.empty())
+						return out;
+					vec3f max = positions.front();
+					out.min = positions.front();
+					for (const vec3f& p : positions) {
+						out.min = out.min.cwiseMin(p);
+						max = max.cwiseMax(p);
+					}
+					out.extent = max - out.min;
+					for (int i = 0; i < 3; i++) {
+						if (out.extent[i] <= 0.f)
+							out.extent[i] = 1.f; //flat axis, anything non zero works
+					}
+					return out;
+				}
+				void encode(const vec3f& p, uint16_t* out) const {
+					for (int i = 0; i < 3; i++)
+						out[i] = static_cast<uint16_t>(std::lround(std::clamp((p[i] - min[i]) / extent[i], 0.f, 1.f) * 65535.f));
+				}
+				vec3f decode(const uint16_t* in) const {
+					return vec3f(min.x() + extent.x() * (in[0] / 65535.f), min.y() + extent.y() * (in[1] / 65535.f), min.z() + extent.z() * (in[2] / 65535.f));
+				}
+				//unorm position -> model space, multiply it onto the model matrix when drawing a quantized mesh
+				mat4f dequantize_matrix() const {
+					mat4f out = mat4f::Identity();
+					out(0, 0) = extent.x();
+					out(1, 1) = extent.y();
+					out(2, 2) = extent.z();
+					out.block<3, 1>(0, 3) = min;
+					return out;
+				}
+			};
+		}
+		struct packed_vertex16_t {
+			uint16_t position[3];
+			uint16_t padding; //keeps the normal 4 byte aligned
+			int16_t normal[2];
+			half_t texture_coords[2];
+			void encode(const quantize::quantization_t& q, const vec3f& p, const vec3f& n, const vec2f& uv) {
+				q.encode(p, position);
+				padding = 0;
+				const vec2f octahedral = quantize::octahedral_encode(n);
+				normal[0] = quantize::to_snorm16(octahedral.x());
+				normal[1] = quantize::to_snorm16(octahedral.y());
+				texture_coords[0] = half_t(uv.x());
+				texture_coords[1] = half_t(uv.y());
+			}
+			vec3f decode_normal() const {
+				return quantize::octahedral_decode(vec2f(quantize::from_snorm16(normal[0]), quantize::from_snorm16(normal[1])));
+			}
+		};
+		static_assert(sizeof(packed_vertex16_t) == 16 && std::is_trivial_v<packed_vertex16_t>);
+		struct packed_vertex12_t {
+			uint16_t position[3];
+			int8_t normal[2];
+			half_t texture_coords[2];
+			void encode(const quantize::quantization_t& q, const vec3f& p, const vec3f& n, const vec2f& uv) {
+				q.encode(p, position);
+				const vec2f octahedral = quantize::octahedral_encode(n);
+				normal[0] = quantize::to_snorm8(octahedral.x());
+				normal[1] = quantize::to_snorm8(octahedral.y());
+				texture_coords[0] = half_t(uv.x());
+				texture_coords[1] = half_t(uv.y());
+			}
+			vec3f decode_normal() const {
+				return quantize::octahedral_decode(vec2f(quantize::from_snorm8(normal[0]), quantize::from_snorm8(normal[1])));
+			}
+		};
+		static_assert(sizeof(packed_vertex12_t) == 12 && std::is_trivial_v<packed_vertex12_t>);
+
+		template<class PackedT>
+		struct quantized_mesh_t {
+			std::vector<PackedT> vertices;
+			std::vector<index_t> indices;
+			quantize::quantization_t quantization;
+		};
+		template<class PackedT>
+		inline quantized_mesh_t<PackedT> quantize_model(const model_t& model) {
+			quantized_mesh_t<PackedT> out;
+			out.quantization = quantize::quantization_t::from_positions(model.vertices);
+			out.vertices.resize(model.vertices.size());
+			for (size_t i = 0; i < model.vertices.size(); i++)
+				out.vertices[i].encode(out.quantization, model.vertices[i], model.normals[i], model.texture_coords[i]);
+			out.indices = model.indices;
+			return out;
+		}
+		//back to floats, what the GPU will see (CPU side picking, error checks)
+		template<class PackedT>
+		inline model_t dequantize_model(const quantized_mesh_t<PackedT>& mesh) {
+			model_t out;
+			out.vertices.reserve(mesh.vertices.size());
+			out.normals.reserve(mesh.vertices.size());
+			out.texture_coords.reserve(mesh.vertices.size());
+			for (const PackedT& v : mesh.vertices) {
+				out.vertices.push_back(mesh.quantization.decode(v.position));
+				out.normals.push_back(v.decode_normal());
+				out.texture_coords.emplace_back(static_cast<float>(v.texture_coords[0]), static_cast<float>(v.texture_coords[1]));
+			}
+			out.indices = mesh.indices;
+			out.compute_bounds();
+			return out;
+		}
+	}
+}
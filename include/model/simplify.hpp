@@ -0,0 +1,305 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+#include "../model.hpp"
+#include "optimize.hpp"
+namespace foton {
+	namespace model {
+		/*
+			quadric error metric simplification (Garland & Heckbert 1997) with half edge collapses
+
+			a collapse moves vertex 'from' onto vertex 'to' so every vertex left in a LOD is an original one,
+			uvs and normals never get interpolated
+			vertices on an attribute seam (more than one model_t vertex at the same position, ie a uv seam or a hard normal)
+			and vertices on an open border never move, so seams and hard edges stay exactly where they were
+		*/
+		namespace simplify {
+			struct quadric_t {
+				double a2 = 0, ab = 0, ac = 0, ad = 0;
+				double b2 = 0, bc = 0, bd = 0;
+				double c2 = 0, cd = 0;
+				double d2 = 0;
+				static quadric_t from_plane(double a, double b, double c, double d) {
+					return quadric_t{ a * a, a * b, a * c, a * d, b * b, b * c, b * d, c * c, c * d, d * d };
+				}
+				quadric_t& operator+=(const quadric_t& o) {
+					a2 += o.a2; ab += o.ab; ac += o.ac; ad += o.ad;
+					b2 += o.b2; bc += o.bc; bd += o.bd;
+					c2 += o.c2; cd += o.cd;
+					d2 += o.d2;
+					return *this;
+				}
+				quadric_t operator+(const quadric_t& o) const {
+					quadric_t out = *this;
+					return out += o;
+				}
+				//sum of squared distances from 'p' to every plane in the quadric
+				double evaluate(const vec3f& p) const {
+					const double x = p.x(), y = p.y(), z = p.z();
+					return a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+						+ b2 * y * y + 2 * bc * y * z + 2 * bd * y
+						+ c2 * z * z + 2 * cd * z
+						+ d2;
+				}
+			};
+			//center and radius of the positions' bounding box
+			inline std::pair<vec3f, float> bounding_sphere(const std::vector<vec3f>& positions) {
+				if (positions.empty())
+					return { vec3f::Zero(), 0.f };
+				vec3f min = positions.front(), max = positions.front();
+				for (const vec3f& p : positions) {
+					min = min.cwiseMin(p);
+					max = max.cwiseMax(p);
+				}
+				return { vec3f((min + max) * 0.5f), (max - min).norm() * 0.5f };
+			}
+			struct result_t {
+				std::vector<index_t> indices; //into the same vertex arrays as the input
+				float error = 0.f; //world units, roughly the furthest any surface moved
+			};
+			/*
+				collapses edges until 'model' is down to 'target_triangles' or the next collapse would move the
+				surface further than 'max_error' (world units)
+			*/
+			inline result_t simplify_indices(const model_t& model, size_t target_triangles, float max_error) {
+				const size_t vertex_count = model.vertices.size();
+				const size_t triangle_count = model.indices.size() / 3;
+				result_t result;
+				std::vector<index_t> triangles = model.indices;
+				if (triangle_count <= target_triangles) {
+					result.indices = std::move(triangles);
+					return result;
+				}
+				const std::vector<vec3f>& positions = model.vertices;
+
+				//model_t vertices sharing a position
+				std::vector<index_t> position_group(vertex_count);
+				std::vector<uint32_t> group_size;
+				{
+					weld_table_t table(vertex_count);
+					std::vector<index_t> group_first;
+					for (index_t v = 0; v < vertex_count; v++) {
+						uint64_t h = 0;
+						for (int i = 0; i < 3; i++)
+							h = weld::combine(h, weld::float_bits(positions[v][i]));
+						const index_t first = table.find_or_insert(h, v, [&](index_t existing) {
+							return positions[existing] == positions[v];
+						});
+						if (first == v) {
+							position_group[v] = static_cast<index_t>(group_first.size());
+							group_first.push_back(v);
+							group_size.push_back(1);
+						}
+						else {
+							position_group[v] = position_group[first];
+							group_size[position_group[v]]++;
+						}
+					}
+				}
+				std::vector<bool> locked(vertex_count, false);
+				for (index_t v = 0; v < vertex_count; v++)
+					locked[v] = group_size[position_group[v]] > 1;
+				{
+					//an edge between position groups only one triangle uses is an open border
+					auto edge_key = [&](index_t a, index_t b) {
+						const uint64_t ga = position_group[a], gb = position_group[b];
+						return ga < gb ? (ga << 32) | gb : (gb << 32) | ga;
+					};
+					std::unordered_map<uint64_t, uint32_t> edge_uses;
+					edge_uses.reserve(triangles.size());
+					for (size_t t = 0; t < triangle_count; t++) {
+						for (size_t e = 0; e < 3; e++)
+							edge_uses[edge_key(triangles[t * 3 + e], triangles[t * 3 + (e + 1) % 3])]++;
+					}
+					for (size_t t = 0; t < triangle_count; t++) {
+						for (size_t e = 0; e < 3; e++) {
+							const index_t a = triangles[t * 3 + e], b = triangles[t * 3 + (e + 1) % 3];
+							if (edge_uses[edge_key(a, b)] == 1)
+								locked[a] = locked[b] = true;
+						}
+					}
+				}
+
+				std::vector<quadric_t> group_quadrics(group_size.size());
+				std::vector<std::vector<uint32_t>> vertex_triangles(vertex_count);
+				for (size_t t = 0; t < triangle_count; t++) {
+					const vec3f& p0 = positions[triangles[t * 3]];
+					const vec3f normal = (positions[triangles[t * 3 + 1]] - p0).cross(positions[triangles[t * 3 + 2]] - p0);
+					const float length = normal.norm();
+					if (length > 0.f) {
+						const vec3f n = normal / length;
+						const quadric_t plane = quadric_t::from_plane(n.x(), n.y(), n.z(), -n.dot(p0));
+						for (size_t c = 0; c < 3; c++)
+							group_quadrics[position_group[triangles[t * 3 + c]]] += plane;
+					}
+					for (size_t c = 0; c < 3; c++)
+						vertex_triangles[triangles[t * 3 + c]].push_back(static_cast<uint32_t>(t));
+				}
+				std::vector<quadric_t> quadrics(vertex_count);
+				for (index_t v = 0; v < vertex_count; v++)
+					quadrics[v] = group_quadrics[position_group[v]];
+
+				struct collapse_t {
+					double cost;
+					index_t from, to;
+					uint32_t from_version, to_version;
+					bool operator>(const collapse_t& o) const {
+						return cost > o.cost;
+					}
+				};
+				std::priority_queue<collapse_t, std::vector<collapse_t>, std::greater<collapse_t>> heap;
+				std::vector<uint32_t> version(vertex_count, 0);
+				std::vector<bool> removed(vertex_count, false);
+				std::vector<bool> dead(triangle_count, false);
+				auto push_edge = [&](index_t from, index_t to) {
+					if (locked[from] || from == to)
+						return;
+					const double cost = (quadrics[from] + quadrics[to]).evaluate(positions[to]);
+					heap.push(collapse_t{ std::max(cost, 0.0), from, to, version[from], version[to] });
+				};
+				auto push_edges_around = [&](index_t v) {
+					for (const uint32_t t : vertex_triangles[v]) {
+						if (dead[t])
+							continue;
+						for (size_t c = 0; c < 3; c++) {
+							const index_t w = triangles[t * 3 + c];
+							push_edge(v, w);
+							push_edge(w, v);
+						}
+					}
+				};
+				for (size_t t = 0; t < triangle_count; t++) {
+					for (size_t e = 0; e < 3; e++) {
+						const index_t a = triangles[t * 3 + e], b = triangles[t * 3 + (e + 1) % 3];
+						push_edge(a, b);
+						push_edge(b, a);
+					}
+				}
+				//moving 'from' onto 'to' can't flip or squash any triangle that survives it
+				auto collapse_keeps_orientation = [&](index_t from, index_t to) {
+					for (const uint32_t t : vertex_triangles[from]) {
+						if (dead[t])
+							continue;
+						const index_t* tri = &triangles[t * 3];
+						if (tri[0] == to || tri[1] == to || tri[2] == to)
+							continue; //this one collapses away
+						vec3f moved[3];
+						for (size_t c = 0; c < 3; c++)
+							moved[c] = positions[tri[c] == from ? to : tri[c]];
+						const vec3f before = (positions[tri[1]] - positions[tri[0]]).cross(positions[tri[2]] - positions[tri[0]]);
+						const vec3f after = (moved[1] - moved[0]).cross(moved[2] - moved[0]);
+						if (before.dot(after) <= 0.f)
+							return false;
+					}
+					return true;
+				};
+
+				const double max_cost = static_cast<double>(max_error) * max_error;
+				size_t live_triangles = triangle_count;
+				double worst_cost = 0;
+				while (live_triangles > target_triangles && !heap.empty()) {
+					const collapse_t collapse = heap.top();
+					heap.pop();
+					if (removed[collapse.from] || removed[collapse.to]
+						|| version[collapse.from] != collapse.from_version || version[collapse.to] != collapse.to_version)
+						continue; //stale
+					if (collapse.cost > max_cost)
+						break;
+					if (!collapse_keeps_orientation(collapse.from, collapse.to))
+						continue;
+					for (const uint32_t t : vertex_triangles[collapse.from]) {
+						if (dead[t])
+							continue;
+						index_t* tri = &triangles[t * 3];
+						if (tri[0] == collapse.to || tri[1] == collapse.to || tri[2] == collapse.to) {
+							dead[t] = true;
+							live_triangles--;
+							continue;
+						}
+						for (size_t c = 0; c < 3; c++) {
+							if (tri[c] == collapse.from)
+								tri[c] = collapse.to;
+						}
+						vertex_triangles[collapse.to].push_back(t);
+					}
+					removed[collapse.from] = true;
+					vertex_triangles[collapse.from].clear();
+					quadrics[collapse.to] += quadrics[collapse.from];
+					version[collapse.to]++;
+					worst_cost = std::max(worst_cost, collapse.cost);
+					push_edges_around(collapse.to);
+				}
+				result.indices.reserve(live_triangles * 3);
+				for (size_t t = 0; t < triangle_count; t++) {
+					if (!dead[t])
+						result.indices.insert(result.indices.end(), triangles.begin() + t * 3, triangles.begin() + t * 3 + 3);
+				}
+				result.error = static_cast<float>(std::sqrt(worst_cost));
+				return result;
+			}
+			struct lod_level_t {
+				model_t model;
+				float error = 0.f; //world units, accumulated over the chain
+				size_t triangle_count() const {
+					return model.indices.size() / 3;
+				}
+			};
+			/*
+				levels[0] is the full model, every level after is simplified from the one before it
+				errors only grow along the chain so the coarsest acceptable level is the last one that passes
+			*/
+			struct lod_chain_t {
+				std::vector<lod_level_t> levels;
+				vec3f center = vec3f::Zero();
+				float radius = 0.f;
+				//'pixels_per_unit' is how many pixels one world unit covers at the model's distance
+				size_t select(float pixels_per_unit, float max_pixel_error) const {
+					size_t chosen = 0;
+					for (size_t i = 1; i < levels.size(); i++) {
+						if (levels[i].error * pixels_per_unit <= max_pixel_error)
+							chosen = i;
+					}
+					return chosen;
+				}
+			};
+			struct lod_options_t {
+				std::vector<float> ratios = { 0.5f, 0.25f, 0.125f, 0.0625f }; //of the full triangle count
+				float max_error = 0.05f; //per level, relative to the model's radius
+				bool optimize = true; //run optimize_model on every level
+			};
+			/*
+				builds a LOD chain from 'model', stops early if a level can't get meaningfully smaller
+				(everything left is locked or the error budget ran out)
+			*/
+			inline lod_chain_t build_lod_chain(const model_t& model, const lod_options_t& options = {}) {
+				lod_chain_t chain;
+				std::tie(chain.center, chain.radius) = bounding_sphere(model.vertices);
+				chain.levels.push_back(lod_level_t{ model, 0.f });
+				const size_t full_triangles = model.indices.size() / 3;
+				for (const float ratio : options.ratios) {
+					const lod_level_t& previous = chain.levels.back();
+					const size_t target = static_cast<size_t>(full_triangles * ratio);
+					result_t simplified = simplify_indices(previous.model, target, options.max_error * chain.radius);
+					if (simplified.indices.size() / 3 > previous.triangle_count() * 9 / 10)
+						break;
+					lod_level_t level;
+					level.model.vertices = previous.model.vertices;
+					level.model.texture_coords = previous.model.texture_coords;
+					level.model.normals = previous.model.normals;
+					level.model.indices = std::move(simplified.indices);
+					level.error = previous.error + simplified.error;
+					if (options.optimize)
+						optimize::optimize_model(level.model);
+					else
+						optimize::optimize_vertex_fetch(level.model); //still drop the vertices nothing uses anymore
+					level.model.compute_bounds();
+					chain.levels.push_back(std::move(level));
+				}
+				return chain;
+			}
+		}
+	}
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "../utility/hash.hpp"
+namespace foton {
+	namespace model {
+		/*
+			how make_model decides two face corners are the same vertex
+
+			indices: same (vertex_i, texture_coords_i, normals_i) triple, cheapest but duplicate values in the file stay split
+			exact: bit for bit equal position, uv and normal (-0 == 0), same output as the old linear search
+			epsilon: positions snapped to an 'epsilon' sized grid, uv and normal still exact, epsilon has to be > 0
+		*/
+		enum class weld_mode_t {
+			indices,
+			exact,
+			epsilon
+		};
+		struct weld_options_t {
+			weld_mode_t mode = weld_mode_t::exact;
+			float epsilon = 1e-5f;
+		};
+		namespace weld {
+			using hash::mix;
+			using hash::combine;
+			inline uint64_t float_bits(float f) {
+				if (f == 0.f) //so -0 and 0 hash the same, they compare equal
+					f = 0.f;
+				uint32_t bits;
+				std::memcpy(&bits, &f, sizeof(bits));
+				return bits;
+			}
+			//grid cell of 'f', clamped so huge coordinates (or a tiny epsilon) can't overflow the cast
+			inline int64_t quantize(float f, float inverse_epsilon) {
+				constexpr double LIMIT = 4611686018427387904.0; //2^62
+				const double cell = std::floor(static_cast<double>(f) * inverse_epsilon);
+				return static_cast<int64_t>(std::clamp(cell, -LIMIT, LIMIT));
+			}
+		}
+		/*
+			flat open addressing table of output vertex indices
+
+			sized once for the worst case (every corner unique) at <= 80% load, so it never rehashes
+			the capacity isn't rounded to a power of 2 (that doubles the memory of a 10M triangle mesh),
+			slots get picked with a multiply-shift instead of a mask
+			slots keep the upper hash bits next to the index so most probes never touch vertex data
+		*/
+		struct weld_table_t {
+			static constexpr uint32_t EMPTY = static_cast<uint32_t>(-1);
+			explicit weld_table_t(size_t max_entries) {
+				_slots.assign(max_entries + max_entries / 4 + 16, slot_t{ EMPTY, 0 });
+			}
+			/*
+				returns the index already stored for an equal key, otherwise stores 'candidate' and returns it
+				'equal(existing_index)' compares the key being inserted against an already stored vertex
+			*/
+			template<class EqualF>
+			uint32_t find_or_insert(uint64_t hash, uint32_t candidate, EqualF&& equal) {
+				const uint32_t tag = static_cast<uint32_t>(hash >> 32);
+				const size_t capacity = _slots.size();
+				size_t i = static_cast<size_t>((static_cast<uint64_t>(static_cast<uint32_t>(hash)) * capacity) >> 32);
+				for (;; i = i + 1 == capacity ? 0 : i + 1) {
+					slot_t& slot = _slots[i];
+					if (slot.index == EMPTY) {
+						slot = slot_t{ candidate, tag };
+						return candidate;
+					}
+					if (slot.tag == tag && equal(slot.index))
+						return slot.index;
+				}
+			}
+			size_t capacity() const {
+				return _slots.size();
+			}
+		private:
+			struct slot_t {
+				uint32_t index;
+				uint32_t tag;
+			};
+			std::vector<slot_t> _slots;
+		};
+	}
+}
@@ -1,19 +1,35 @@
 #pragma once
 #include "containers/dynamic_vector.hpp"
+#include "graphics/camera.hpp"
 #include "graphics/drawer.hpp"
+#include "graphics/mesh.hpp"
+#include "graphics/command_list.hpp"
+#include "graphics/geometry_pool.hpp"
 #include "graphics/gl/shader.hpp"
+#include "graphics/transform_graph.hpp"
 #include "model.hpp"
+#include "model/simplify.hpp"
 namespace foton {
 	struct object_t : drawable_t {
 		struct optional_shader_t {
 			shader::shader_t shader;
 			shader::uniform_t<mat4f> transform_uniform;
+			GLint instance_location; //of 'in mat4 instance_transform', shaders that have one get instanced
+			GLint material_location; //of 'in vec4 instance_uv_rect', see GL::instance_material_t
+			bool object_block; //reads its transform from the std140 object_block instead of the transform uniform
 			optional_shader_t(shader::shader_t in_shader)
 				: shader(std::move(in_shader)),
-				transform_uniform(get_transform_uniform()) {}
+				transform_uniform(get_transform_uniform()),
+				instance_location(shader.attribute_location("instance_transform")),
+				material_location(shader.attribute_location("instance_uv_rect")),
+				object_block(shader.has_uniform_block(GL::uniform_bindings::OBJECT_BLOCK)) {}
 			optional_shader_t& operator=(shader::shader_t&& new_shader) {
 				shader.update_from(std::move(new_shader));
 				transform_uniform = get_transform_uniform();
+				instance_location = shader.attribute_location("instance_transform");
+				material_location = shader.attribute_location("instance_uv_rect");
+				object_block = shader.has_uniform_block(GL::uniform_bindings::OBJECT_BLOCK);
+				return *this;
 			}
 			shader::uniform_t<mat4f> get_transform_uniform() {
 				return shader.get_uniform<mat4f>("transform", false);
@@ -21,25 +37,76 @@ namespace foton {
 		};
 		using mat4f = Eigen::Matrix4f;
 		dynamic_vector_t<model::model_t> models;
+		//optional, lods[i] is the chain built from models[i], models without a chain always draw at full detail
+		std::vector<model::simplify::lod_chain_t> lods;
+		std::vector<size_t> selected_lods;
+		float max_lod_pixel_error = 1.f;
+		std::vector<mesh_t*> meshes; //uploaded meshes that aren't tied to a model, always drawn at full detail
+		std::vector<std::vector<std::unique_ptr<mesh_t>>> lod_meshes; //lod_meshes[i][level] from upload_lods(), record() draws the selected one
+		std::vector<std::vector<geometry_pool_t::handle_t>> pooled; //pooled[i][level] in scene_t::geometry, drawn with multi draw indirect
+		bool translucent = false;
 		std::unique_ptr<optional_shader_t> default_shader = nullptr;
-		vec3f position;
-		quatf rotation;
-		void draw_call(drawable_t::context_t context) override {
-			drawer_context_t new_context = context.apply(object_mat());
+		GL::uniform_block_t<GL::object_block_t> uniforms{ GL::uniform_bindings::OBJECT }; //everything per object goes up in one write
+		//when set world_mat() comes from the graph, set_transform() keeps the graph's local transform in step
+		transform_graph_t* transforms = nullptr;
+		transform_graph_t::handle_t transform_node = transform_graph_t::INVALID;
+		//draws right away on the context thread with the world matrix (from the graph when attached) as transform, scene_t goes through record() instead
+		void draw_call(const context_t& context) override {
+			(void)context;
+			const mat4f world = world_mat();
 			auto draw_all = [&]() {
-				for (model::model_t& model : models) {
-					model.draw_call();
+				for (size_t i = 0; i < lod_meshes.size(); i++) {
+					if (!lod_meshes[i].empty())
+						lod_meshes[i][selected_lod(i, lod_meshes[i].size())]->vao.bind().draw_elements();
 				}
+				for (mesh_t* mesh : meshes)
+					mesh->vao.bind().draw_elements();
 			};
 			if (default_shader) {
 				auto use = default_shader->shader.use();
-				default_shader->get_transform_uniform() = new_context.world_matrix;
+				if (default_shader->object_block) {
+					uniforms.data.transform = world;
+					uniforms.upload();
+				}
+				else
+					default_shader->transform_uniform = world;
 				draw_all();
 			}
 			else {
 				draw_all();
 			}
 		}
+		/*
+			puts the object under 'parent' in 'graph', or makes it a root
+			moving within the same graph keeps the node, so objects attached under this one come along
+			moving to another graph removes the old node with everything under it, those objects need attaching again
+		*/
+		void attach(transform_graph_t& graph, const object_t* parent = nullptr) {
+			const transform_graph_t::handle_t parent_node = parent ? parent->transform_node : transform_graph_t::INVALID;
+			if (transforms == &graph && graph.alive(transform_node)) {
+				graph.set_parent(transform_node, parent_node);
+				return;
+			}
+			if (transforms)
+				transforms->remove(transform_node);
+			transforms = &graph;
+			transform_node = graph.add(parent_node, _position, _rotation);
+		}
+		//the only way to move the object, so an attached one's node (and the scene's bvh) always sees it
+		void set_transform(const vec3f& new_position, const quatf& new_rotation) {
+			_position = new_position;
+			_rotation = new_rotation;
+			if (transforms)
+				transforms->set_local(transform_node, _position, _rotation);
+		}
+		//relative to the parent when attached to a transform graph
+		const vec3f& position() const {
+			return _position;
+		}
+		const quatf& rotation() const {
+			return _rotation;
+		}
+		//an empty shader_t (still compiling) leaves program 0 in record(), the render queue draws that with its fallback
 		void set_shader(shader::shader_t&& shader) {
 			if (default_shader) {
 				*default_shader = std::move(shader);
@@ -48,11 +115,168 @@ namespace foton {
 				default_shader = std::make_unique<optional_shader_t>(std::move(shader));
 			}
 		}
+		void build_lods(const model::simplify::lod_options_t& options = {}) {
+			lods.clear();
+			for (uint32_t i = 0; i < models.size(); i++)
+				lods.push_back(model::simplify::build_lod_chain(models[i], options));
+			selected_lods.assign(lods.size(), 0);
+		}
+		/*
+			picks every chain's coarsest level whose error covers at most max_lod_pixel_error pixels,
+			the projected size of a world unit at the chain's center comes from the camera's vertical fov and height in pixels
+		*/
+		void select_lods(const camera::camera_t& camera) {
+			selected_lods.resize(lods.size());
+			const mat4f world = world_mat();
+			const float focal = camera.projection.height / (2.f * std::tan(0.5f * camera.projection.fov_vertical));
+			for (size_t i = 0; i < lods.size(); i++) {
+				const vec3f center = (world * lods[i].center.homogeneous()).head<3>();
+				const float distance = std::max((center - camera.view.position).norm() - lods[i].radius, camera.projection.near_plane);
+				selected_lods[i] = lods[i].select(focal / distance, max_lod_pixel_error);
+			}
+		}
+		model::model_t& lod_model(size_t i) {
+			if (i < lods.size() && i < selected_lods.size())
+				return lods[i].levels[selected_lods[i]].model;
+			return models[i];
+		}
+		//selected level of model 'i' out of the 'level_count' it was uploaded with
+		size_t selected_lod(size_t i, size_t level_count) const {
+			return i < selected_lods.size() ? std::min(selected_lods[i], level_count - 1) : 0;
+		}
+		//one mesh_t per level of every model's chain, models without a chain get one at full detail
+		void upload_lods() {
+			lod_meshes.clear();
+			for (uint32_t i = 0; i < models.size(); i++) {
+				std::vector<std::unique_ptr<mesh_t>>& levels = lod_meshes.emplace_back();
+				if (i < lods.size()) {
+					for (const model::simplify::lod_level_t& level : lods[i].levels)
+						levels.push_back(std::make_unique<mesh_t>(level.model));
+				}
+				else
+					levels.push_back(std::make_unique<mesh_t>(models[i]));
+			}
+		}
+		//copies every model (every level of its chain when it has one) into 'pool', needs a default shader with an instance_transform attribute to get drawn
+		void pool_models(geometry_pool_t& pool) {
+			for (uint32_t i = 0; i < models.size(); i++) {
+				std::vector<geometry_pool_t::handle_t>& levels = pooled.emplace_back();
+				if (i < lods.size()) {
+					for (const model::simplify::lod_level_t& level : lods[i].levels)
+						levels.push_back(pool.add(level.model));
+				}
+				else
+					levels.push_back(pool.add(models[i]));
+			}
+		}
+		void record_pooled(geometry_pool_t& pool, const mat4f& view_projection) const {
+			if (!default_shader || default_shader->instance_location < 0)
+				return;
+			const mat4f transform = view_projection * world_mat();
+			for (size_t i = 0; i < pooled.size(); i++) {
+				if (!pooled[i].empty())
+					pool.push(pooled[i][selected_lod(i, pooled[i].size())], default_shader->shader.program_id(), default_shader->instance_location, transform);
+			}
+		}
+		//one render_queue_t::draw_t per mesh (the selected level of each lod mesh), 'depth' is the object's view depth over the far plane
+		//no GL calls so any thread can record, QueueT is a render_queue_t or a command_list_t
+		template<class QueueT>
+		void record(QueueT& queue, const mat4f& view_projection, float depth) const {
+			render_queue_t::draw_t draw;
+			if (default_shader) {
+				draw.program = default_shader->shader.program_id();
+				draw.object_block = default_shader->object_block;
+				draw.transform_location = draw.object_block ? -1 : default_shader->transform_uniform.location();
+				draw.instance_location = default_shader->instance_location;
+				draw.material_location = default_shader->material_location;
+			}
+			draw.world = world_mat();
+			draw.transform = view_projection * draw.world;
+			auto push = [&](const mesh_t* mesh) {
+				draw.vao = mesh->vao.id();
+				if (mesh->region.texture != 0) {
+					draw.texture = mesh->region.texture;
+					draw.texture_target = GL::texture_array_t::TARGET;
+					draw.material = mesh->region.material();
+				}
+				else {
+					draw.texture = mesh->textures.empty() ? 0 : mesh->textures.front().id();
+					draw.texture_target = GL_TEXTURE_2D;
+				}
+				draw.index_type = mesh->vao.index_type();
+				draw.count = mesh->vao.index_count();
+				queue.push(draw, depth, translucent);
+			};
+			for (size_t i = 0; i < lod_meshes.size(); i++) {
+				if (!lod_meshes[i].empty())
+					push(lod_meshes[i][selected_lod(i, lod_meshes[i].size())].get());
+			}
+			for (const mesh_t* mesh : meshes)
+				push(mesh);
+		}
+		//model space box around every model and uploaded mesh
+		model::aabb_t local_bounds() const {
+			model::aabb_t out;
+			for (uint32_t i = 0; i < models.size(); i++)
+				out.add(models[i].bounds);
+			for (const mesh_t* mesh : meshes)
+				out.add(mesh->bounds);
+			return out;
+		}
+		model::aabb_t world_bounds() const {
+			const mat4f world = world_mat();
+			return local_bounds().transformed(world.block<3, 3>(0, 0), world.block<3, 1>(0, 3));
+		}
+		/*
+			distance along a world space ray to the closest triangle of the full detail models, infinity on a miss
+			'direction' doesn't have to be normalized, the distance is in units of it
+		*/
+		float intersect_ray(const vec3f& origin, const vec3f& direction) const {
+			const mat4f world = world_mat();
+			const mat3f inverse = world.block<3, 3>(0, 0).transpose(); //rotation only, so the transpose inverts it
+			const vec3f o = inverse * (origin - world.block<3, 1>(0, 3));
+			const vec3f d = inverse * direction;
+			float best = std::numeric_limits<float>::infinity();
+			for (uint32_t m = 0; m < models.size(); m++) {
+				const model::model_t& model = models[m];
+				for (size_t i = 0; i + 2 < model.indices.size(); i += 3) { //Moller-Trumbore
+					const vec3f& v0 = model.vertices[model.indices[i]];
+					const vec3f e1 = model.vertices[model.indices[i + 1]] - v0;
+					const vec3f e2 = model.vertices[model.indices[i + 2]] - v0;
+					const vec3f p = d.cross(e2);
+					const float det = e1.dot(p);
+					if (std::abs(det) < 1e-12f)
+						continue;
+					const float inverse_det = 1.f / det;
+					const vec3f s = o - v0;
+					const float u = s.dot(p) * inverse_det;
+					if (u < 0.f || u > 1.f)
+						continue;
+					const vec3f q = s.cross(e1);
+					const float v = d.dot(q) * inverse_det;
+					if (v < 0.f || u + v > 1.f)
+						continue;
+					const float t = e2.dot(q) * inverse_det;
+					if (t >= 0.f && t < best)
+						best = t;
+				}
+			}
+			return best;
+		}
+		//local to world, cached by the transform graph when attached
+		mat4f world_mat() const {
+			if (transforms)
+				return transforms->world(transform_node);
+			return object_mat();
+		}
 		mat4f object_mat() const {
-			aff3f out;
-			out.translate(position);
-			out.rotate(rotation);
-			return out.matrix;
+			aff3f out = aff3f::Identity();
+			out.translate(_position);
+			out.rotate(_rotation);
+			return out.matrix();
 		}
+	private:
+		vec3f _position = vec3f::Zero();
+		quatf _rotation = quatf::Identity();
 	};
 }
\ No newline at end of file
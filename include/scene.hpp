@@ -1,20 +1,218 @@
 #pragma once
 #include "object.hpp"
+#include "graphics/bvh.hpp"
 #include "graphics/camera.hpp"
+#include "graphics/command_list.hpp"
+#include "graphics/frustum_culler.hpp"
+#include "graphics/gl/ring_buffer.hpp"
 #include "graphics/gl/shader.hpp"
+#include "graphics/transform_graph.hpp"
 namespace foton {
 	namespace scene {
 		struct scene_t : drawer_t {
 			std::vector<object_t*> objects;
+			render_queue_t queue;
+			parallel_recorder_t recorder;
+			geometry_pool_t geometry; //static meshes shared by every object, see object_t::pool_models
+			frustum_culler_t culler;
+			transform_graph_t transforms; //objects not attached anywhere get attached here as roots
+			bvh_t bvh; //over world_bounds, kept current by update_bvh()
+			std::vector<model::aabb_t> world_bounds; //by object index
+			std::vector<uint32_t> visible; //indices into objects that survived the last cull
+			shader::shader_compiler_t* shader_compiler = nullptr; //when set, objects whose program hasn't linked yet draw with its fallback
+			//per frame sizes of the ring buffers queue and geometry stream through, read when the first frame creates them
+			size_t stream_bytes = 8 << 20; //instance matrices and materials
+			size_t uniform_stream_bytes = 2 << 20; //object blocks
+			//draw_with fills in the camera's matrices and uploads it, object blocks only carry the world matrix. 'time' is up to the caller
+			GL::uniform_block_t<GL::frame_block_t> frame_uniforms{ GL::uniform_bindings::FRAME };
+			/*
+				objects outside the camera's frustum are dropped first (walking the bvh, leaves tested several boxes at a time),
+				the rest get recorded (lod selection, matrices, keys) across the thread pool without any GL,
+				then the queue sorts everything by state and submits it from this thread, which has to own the context
+			*/
 			void draw_with(const camera::camera_t& camera) {
 				camera.recalculate();
 				const mat4f projection = camera.projection_matrix;
 				const mat4f view = camera.view_matrix;
-				for (const object_t* object : objects) {
-					const mat4f model_mat = object->model_mat();
-
+				const mat4f view_projection = projection * view;
+				update_bvh();
+				_cull_stats = bvh.cull(camera::frustum_t::from_matrix(view_projection), visible, culler);
+				visible.insert(visible.end(), _unbounded.begin(), _unbounded.end());
+				_cull_stats.visible += _unbounded.size();
+				_cull_stats.culled -= _unbounded.size();
+				recorder.record(visible.size(), [&](command_list_t& list, size_t i) {
+					object_t& object = *objects[visible[i]];
+					object.select_lods(camera);
+					const float view_depth = -(view * object.world_mat().col(3)).z();
+					object.record(list, view_projection, view_depth / camera.projection.far_plane);
+				});
+				queue.clear();
+				if (shader_compiler && queue.fallback.program == 0)
+					queue.fallback = { shader_compiler->fallback_program(), shader_compiler->fallback_transform_location() };
+				recorder.append_to(queue);
+				begin_streams();
+				frame_uniforms.data.view_mat = view;
+				frame_uniforms.data.projection_mat = projection;
+				frame_uniforms.data.view_projection_mat = view_projection;
+				frame_uniforms.upload();
+				queue.submit();
+				geometry.clear_draws();
+				for (const uint32_t i : visible)
+					objects[i]->record_pooled(geometry, view_projection);
+				geometry.submit();
+				end_streams();
+			}
+			//adds 'object' to the scene under 'parent' (which has to be in the scene already), or as a root
+			void add(object_t& object, const object_t* parent = nullptr) {
+				object.attach(transforms, parent);
+				objects.push_back(&object);
+			}
+			/*
+				updates world matrices and brings the bvh up to date, a changed object list rebuilds it,
+				otherwise objects get a new box and a refit when their world matrix changed (moved or under something that moved)
+				or their models/meshes did. objects attached to some other graph are checked every time, that graph updates on its own
+				objects without any bounds (nothing loaded yet) are never culled, they're tracked in _unbounded until they get some
+			*/
+			void update_bvh() {
+				const bool rebuild = _indexed != objects;
+				if (rebuild) {
+					for (object_t* object : objects) {
+						if (!object->transforms)
+							object->attach(transforms);
+					}
+				}
+				transforms.update();
+				if (rebuild) {
+					_indexed = objects;
+					world_bounds.resize(objects.size());
+					_local_bounds.resize(objects.size());
+					_node_changed.assign(objects.size(), false);
+					_object_of.clear();
+					for (uint32_t i = 0; i < objects.size(); i++) {
+						_local_bounds[i] = objects[i]->local_bounds();
+						world_bounds[i] = objects[i]->world_bounds();
+						if (objects[i]->transforms == &transforms) {
+							if (_object_of.size() <= objects[i]->transform_node)
+								_object_of.resize(objects[i]->transform_node + 1, bvh_t::INVALID);
+							_object_of[objects[i]->transform_node] = i;
+						}
+					}
+					bvh.build(world_bounds);
+					collect_unbounded();
+					return;
+				}
+				for (const transform_graph_t::handle_t node : transforms.changed()) {
+					const uint32_t i = node < _object_of.size() ? _object_of[node] : bvh_t::INVALID;
+					if (i != bvh_t::INVALID)
+						_node_changed[i] = true;
+				}
+				_moved.clear();
+				bool emptiness_changed = false;
+				for (uint32_t i = 0; i < objects.size(); i++) {
+					const model::aabb_t local = objects[i]->local_bounds();
+					if (!_node_changed[i] && objects[i]->transforms == &transforms && local == _local_bounds[i])
+						continue;
+					_node_changed[i] = false;
+					_local_bounds[i] = local;
+					const model::aabb_t box = objects[i]->world_bounds();
+					if (box == world_bounds[i])
+						continue;
+					emptiness_changed |= box.empty() != world_bounds[i].empty();
+					world_bounds[i] = box;
+					_moved.push_back(i);
+				}
+				if (!_moved.empty())
+					bvh.refit(_moved, world_bounds);
+				if (emptiness_changed)
+					collect_unbounded();
+			}
+			//closest object hit by the ray, tested against its triangles (or its box when it has no CPU side models)
+			object_t* pick(const vec3f& origin, const vec3f& direction, float* distance = nullptr) {
+				update_bvh();
+				const bvh_t::hit_t hit = bvh.raycast(origin, direction, std::numeric_limits<float>::infinity(), [&](uint32_t item, float box_distance) {
+					return objects[item]->models.size() == 0 ? box_distance : objects[item]->intersect_ray(origin, direction);
+				});
+				if (distance)
+					*distance = hit.distance;
+				return hit.hit() ? objects[hit.item] : nullptr;
+			}
+			//objects whose world boxes overlap 'box'
+			void overlapping(const model::aabb_t& box, std::vector<object_t*>& out) {
+				update_bvh();
+				_query.clear();
+				bvh.overlap(box, _query);
+				for (const uint32_t i : _query)
+					out.push_back(objects[i]);
+			}
+			//object whose world box is closest to 'point'
+			object_t* nearest(const vec3f& point, float max_distance = std::numeric_limits<float>::infinity()) {
+				update_bvh();
+				const bvh_t::hit_t hit = bvh.nearest(point, max_distance);
+				return hit.hit() ? objects[hit.item] : nullptr;
+			}
+			const frustum_culler_t::stats_t& cull_stats() const {
+				return _cull_stats;
+			}
+			//state changes the last draw_with didn't have to make
+			size_t binds_skipped() const {
+				return queue.stats.binds_skipped;
+			}
+			//null until the first draw_with, and for good without glBufferStorage (the queue and pool upload into their own buffers then)
+			const GL::ring_buffer_t* stream() const {
+				return _stream ? &*_stream : nullptr;
+			}
+			const GL::ring_buffer_t* uniform_stream() const {
+				return _uniform_stream ? &*_uniform_stream : nullptr;
+			}
+		private:
+			//creates the ring buffers on the first frame (that's on the context thread) and hands them to queue and geometry
+			void begin_streams() {
+				if (!_streams_created) {
+					_streams_created = true;
+					auto create = [](std::optional<GL::ring_buffer_t>& ring, GLenum target, size_t bytes) {
+						try {
+							ring.emplace(target, bytes);
+						}
+						catch (const GL::ring_buffer_t::ring_buffer_error_t&) {
+							ring.reset();
+						}
+					};
+					create(_stream, GL_ARRAY_BUFFER, stream_bytes);
+					create(_uniform_stream, GL_UNIFORM_BUFFER, uniform_stream_bytes);
+					queue.stream = geometry.stream = _stream ? &*_stream : nullptr;
+					queue.uniform_stream = frame_uniforms.stream = _uniform_stream ? &*_uniform_stream : nullptr;
+				}
+				if (_stream)
+					_stream->begin_frame();
+				if (_uniform_stream)
+					_uniform_stream->begin_frame();
+			}
+			//after the last draw reading them, fences this frame's regions
+			void end_streams() {
+				if (_stream)
+					_stream->end_frame();
+				if (_uniform_stream)
+					_uniform_stream->end_frame();
+			}
+			//the bvh never returns an empty box, so these get drawn without culling
+			void collect_unbounded() {
+				_unbounded.clear();
+				for (uint32_t i = 0; i < world_bounds.size(); i++) {
+					if (world_bounds[i].empty())
+						_unbounded.push_back(i);
 				}
 			}
+			frustum_culler_t::stats_t _cull_stats;
+			bool _streams_created = false;
+			std::optional<GL::ring_buffer_t> _stream;
+			std::optional<GL::ring_buffer_t> _uniform_stream;
+			std::vector<object_t*> _indexed; //objects the bvh was built over
+			std::vector<uint32_t> _object_of; //transform node -> index into objects
+			std::vector<model::aabb_t> _local_bounds; //by object index, to notice models/meshes changing without a move
+			std::vector<bool> _node_changed; //by object index, which objects' nodes the last transforms.update() touched
+			std::vector<uint32_t> _unbounded;
+			std::vector<uint32_t> _moved;
+			std::vector<uint32_t> _query;
 		};
 	}
-}
\ No newline at end of file
+}
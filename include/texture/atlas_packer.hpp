@@ -0,0 +1,132 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <vector>
+namespace foton {
+	namespace texture {
+		/*
+			skyline rectangle packer for texture atlases
+
+			the packed area's top edge is kept as a list of horizontal segments (the skyline), a new rect goes where
+			its top ends up lowest (bottom-left rule, least wasted area under it breaks ties). space under the skyline
+			that a rect bridged over is never reused, which costs a few percent against MaxRects but keeps pack()
+			linear in the number of segments and the packer online, rects can be added one at a time forever
+
+			'alignment' rounds every rect's size up to a multiple of it, with a power of two alignment every rect's
+			corner lands on a multiple of it too (see texture_pool_t's mip safe mode)
+		*/
+		struct atlas_packer_t {
+			struct rect_t {
+				uint32_t x = 0;
+				uint32_t y = 0;
+				uint32_t width = 0; //after alignment
+				uint32_t height = 0;
+			};
+			atlas_packer_t(uint32_t width, uint32_t height, uint32_t alignment = 1)
+				: _width(width), _height(height), _alignment(std::max(alignment, 1u)) {
+				reset();
+			}
+			void reset() {
+				_skyline.assign(1, segment_t{ 0, 0, _width });
+				_used = 0;
+			}
+			uint32_t width() const {
+				return _width;
+			}
+			uint32_t height() const {
+				return _height;
+			}
+			//nullopt when there's no room left for it
+			std::optional<rect_t> pack(uint32_t width, uint32_t height) {
+				width = align(width);
+				height = align(height);
+				if (width == 0 || height == 0 || width > _width || height > _height)
+					return std::nullopt;
+				size_t best = _skyline.size();
+				uint32_t best_y = 0, best_top = std::numeric_limits<uint32_t>::max();
+				uint64_t best_waste = std::numeric_limits<uint64_t>::max();
+				for (size_t i = 0; i < _skyline.size(); i++) {
+					uint32_t y;
+					uint64_t waste;
+					if (!fit(i, width, height, y, waste))
+						continue;
+					if (y + height < best_top || (y + height == best_top && waste < best_waste)) {
+						best = i;
+						best_y = y;
+						best_top = y + height;
+						best_waste = waste;
+					}
+				}
+				if (best == _skyline.size())
+					return std::nullopt;
+				const rect_t rect{ _skyline[best].x, best_y, width, height };
+				place(best, rect);
+				_used += uint64_t(width) * height;
+				return rect;
+			}
+			//fraction of the atlas covered by packed rects (their aligned size)
+			float occupancy() const {
+				return static_cast<float>(double(_used) / (double(_width) * _height));
+			}
+		private:
+			struct segment_t {
+				uint32_t x;
+				uint32_t y; //top of everything packed below this segment
+				uint32_t width;
+			};
+			uint32_t align(uint32_t size) const {
+				return (size + _alignment - 1) / _alignment * _alignment;
+			}
+			//lowest y a rect starting at segment 'first' can sit at, and the area it would leave empty under itself
+			bool fit(size_t first, uint32_t width, uint32_t height, uint32_t& y, uint64_t& waste) const {
+				const uint32_t x = _skyline[first].x;
+				if (x + width > _width)
+					return false;
+				y = 0;
+				for (size_t i = first; i < _skyline.size() && _skyline[i].x < x + width; i++)
+					y = std::max(y, _skyline[i].y);
+				if (y + height > _height)
+					return false;
+				waste = 0;
+				for (size_t i = first; i < _skyline.size() && _skyline[i].x < x + width; i++) {
+					const uint32_t covered = std::min(_skyline[i].x + _skyline[i].width, x + width) - _skyline[i].x;
+					waste += uint64_t(y - _skyline[i].y) * covered;
+				}
+				return true;
+			}
+			void place(size_t first, const rect_t& rect) {
+				const uint32_t right = rect.x + rect.width;
+				_skyline.insert(_skyline.begin() + first, segment_t{ rect.x, rect.y + rect.height, rect.width });
+				//segments the rect covers shrink from the left or go away
+				for (size_t i = first + 1; i < _skyline.size();) {
+					segment_t& s = _skyline[i];
+					if (s.x >= right)
+						break;
+					const uint32_t end = s.x + s.width;
+					if (end <= right) {
+						_skyline.erase(_skyline.begin() + i);
+						continue;
+					}
+					s.width = end - right;
+					s.x = right;
+					break;
+				}
+				for (size_t i = 0; i + 1 < _skyline.size();) {
+					if (_skyline[i].y == _skyline[i + 1].y) {
+						_skyline[i].width += _skyline[i + 1].width;
+						_skyline.erase(_skyline.begin() + i + 1);
+					}
+					else
+						i++;
+				}
+			}
+			uint32_t _width;
+			uint32_t _height;
+			uint32_t _alignment;
+			std::vector<segment_t> _skyline;
+			uint64_t _used = 0;
+		};
+	}
+}
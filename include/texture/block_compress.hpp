@@ -0,0 +1,357 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include "image.hpp"
+#include "../utility/thread_pool.hpp"
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FOTON_BC_SSE
+#endif
+namespace foton {
+	namespace texture {
+		/*
+			BC1/BC3/BC5 block compression (S3TC DXT1, DXT5 and RGTC2), every 4x4 texel block on its own
+
+			BC1 (8 bytes, RGB): two 565 endpoints on the colors' principal axis (range fit), refined once by least squares
+			over the chosen indices, the better of the two fits is kept. always the 4 color mode, alpha is dropped
+			BC4 (8 bytes, one channel): the block's min and max with 6 interpolated steps between them
+			BC3 = BC4 alpha + BC1 color, BC5 = BC4 red + BC4 green (normal maps, z gets rebuilt in the shader)
+
+			compress() splits the block rows over a thread_pool_t, the nearest palette entry search does 4 texels per
+			instruction with SSE2. blocks past the right/bottom edge repeat the last texel so partial blocks don't pull
+			their endpoints toward black
+		*/
+		namespace bc {
+			struct block_compress_error_t : std::runtime_error {
+				block_compress_error_t(const char* what) : std::runtime_error(what) {}
+			};
+			enum class format_t : uint32_t {
+				bc1,
+				bc3,
+				bc5
+			};
+			inline size_t block_bytes(format_t format) {
+				return format == format_t::bc1 ? 8 : 16;
+			}
+			inline size_t compressed_size(format_t format, uint32_t width, uint32_t height) {
+				return size_t((width + 3) / 4) * ((height + 3) / 4) * block_bytes(format);
+			}
+
+			namespace detail {
+				inline uint16_t pack_565(float r, float g, float b) {
+					const auto q = [](float v, float scale) {
+						return static_cast<uint16_t>(std::clamp(std::lround(v * scale / 255.f), 0l, static_cast<long>(scale)));
+					};
+					return static_cast<uint16_t>((q(r, 31.f) << 11) | (q(g, 63.f) << 5) | q(b, 31.f));
+				}
+				inline void unpack_565(uint16_t c, uint8_t out[3]) {
+					const uint8_t r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+					out[0] = static_cast<uint8_t>((r << 3) | (r >> 2));
+					out[1] = static_cast<uint8_t>((g << 2) | (g >> 4));
+					out[2] = static_cast<uint8_t>((b << 3) | (b >> 2));
+				}
+				//4 color palette of two 565 endpoints, as the hardware decodes it when c0 > c1
+				inline void bc1_palette(uint16_t c0, uint16_t c1, float palette[4][3]) {
+					uint8_t e0[3], e1[3];
+					unpack_565(c0, e0);
+					unpack_565(c1, e1);
+					for (int c = 0; c < 3; c++) {
+						palette[0][c] = e0[c];
+						palette[1][c] = e1[c];
+						palette[2][c] = (2.f * e0[c] + e1[c]) / 3.f;
+						palette[3][c] = (e0[c] + 2.f * e1[c]) / 3.f;
+					}
+				}
+				//nearest palette entry for every texel, returns the summed squared error
+				inline float bc1_indices(const float (&rgb)[3][16], const float palette[4][3], uint8_t indices[16]) {
+#if defined(FOTON_BC_SSE)
+					__m128 total = _mm_setzero_ps();
+					for (int i = 0; i < 16; i += 4) {
+						const __m128 r = _mm_loadu_ps(&rgb[0][i]), g = _mm_loadu_ps(&rgb[1][i]), b = _mm_loadu_ps(&rgb[2][i]);
+						__m128 best = _mm_set1_ps(3.4e38f);
+						__m128i index = _mm_setzero_si128();
+						for (int p = 0; p < 4; p++) {
+							const __m128 dr = _mm_sub_ps(r, _mm_set1_ps(palette[p][0]));
+							const __m128 dg = _mm_sub_ps(g, _mm_set1_ps(palette[p][1]));
+							const __m128 db = _mm_sub_ps(b, _mm_set1_ps(palette[p][2]));
+							const __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)), _mm_mul_ps(db, db));
+							const __m128i closer = _mm_castps_si128(_mm_cmplt_ps(d, best));
+							index = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(p)), _mm_andnot_si128(closer, index));
+							best = _mm_min_ps(best, d);
+						}
+						total = _mm_add_ps(total, best);
+						alignas(16) int32_t lanes[4];
+						_mm_store_si128(reinterpret_cast<__m128i*>(lanes), index);
+						for (int l = 0; l < 4; l++)
+							indices[i + l] = static_cast<uint8_t>(lanes[l]);
+					}
+					alignas(16) float sums[4];
+					_mm_store_ps(sums, total);
+					return sums[0] + sums[1] + sums[2] + sums[3];
+#else
+					float total = 0.f;
+					for (int i = 0; i < 16; i++) {
+						float best = 3.4e38f;
+						for (int p = 0; p < 4; p++) {
+							const float dr = rgb[0][i] - palette[p][0], dg = rgb[1][i] - palette[p][1], db = rgb[2][i] - palette[p][2];
+							const float d = dr * dr + dg * dg + db * db;
+							if (d < best) {
+								best = d;
+								indices[i] = static_cast<uint8_t>(p);
+							}
+						}
+						total += best;
+					}
+					return total;
+#endif
+				}
+				//c0 > c1 keeps the block in 4 color mode, indices get picked after this so the swap is free
+				inline void bc1_order(uint16_t& c0, uint16_t& c1) {
+					if (c0 < c1)
+						std::swap(c0, c1);
+				}
+				inline void write_bc1(uint16_t c0, uint16_t c1, const uint8_t indices[16], uint8_t out[8]) {
+					uint32_t bits = 0;
+					for (int i = 0; i < 16; i++)
+						bits |= uint32_t(indices[i]) << (2 * i);
+					out[0] = static_cast<uint8_t>(c0);
+					out[1] = static_cast<uint8_t>(c0 >> 8);
+					out[2] = static_cast<uint8_t>(c1);
+					out[3] = static_cast<uint8_t>(c1 >> 8);
+					std::memcpy(out + 4, &bits, 4);
+				}
+			}
+
+			//'texels' is a 4x4 block of RGBA8, row major
+			inline void encode_bc1_block(const uint8_t texels[64], uint8_t out[8]) {
+				float rgb[3][16];
+				float mean[3] = {};
+				for (int i = 0; i < 16; i++) {
+					for (int c = 0; c < 3; c++) {
+						rgb[c][i] = texels[i * 4 + c];
+						mean[c] += rgb[c][i] / 16.f;
+					}
+				}
+				//principal axis by power iteration on the covariance
+				float cov[6] = {};
+				for (int i = 0; i < 16; i++) {
+					const float r = rgb[0][i] - mean[0], g = rgb[1][i] - mean[1], b = rgb[2][i] - mean[2];
+					cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+					cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+				}
+				//seeded with the covariance column of the channel that varies most, a fixed seed like (1, 1, 1) can be orthogonal
+				//to the spread (a red/green checker) and collapse to nothing. if even that is ~0, the bounding box diagonal
+				static constexpr int COLUMNS[3][3] = { { 0, 1, 2 }, { 1, 3, 4 }, { 2, 4, 5 } };
+				const int column = cov[0] >= cov[3] && cov[0] >= cov[5] ? 0 : cov[3] >= cov[5] ? 1 : 2;
+				float axis[3] = { cov[COLUMNS[column][0]], cov[COLUMNS[column][1]], cov[COLUMNS[column][2]] };
+				if (std::max({ std::abs(axis[0]), std::abs(axis[1]), std::abs(axis[2]) }) < 1e-6f) {
+					for (int c = 0; c < 3; c++)
+						axis[c] = *std::max_element(rgb[c], rgb[c] + 16) - *std::min_element(rgb[c], rgb[c] + 16);
+				}
+				for (int iteration = 0; iteration < 8; iteration++) {
+					const float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+					const float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+					const float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+					const float length = std::max({ std::abs(x), std::abs(y), std::abs(z) });
+					if (length < 1e-6f)
+						break;
+					axis[0] = x / length;
+					axis[1] = y / length;
+					axis[2] = z / length;
+				}
+				float low = 3.4e38f, high = -3.4e38f;
+				for (int i = 0; i < 16; i++) {
+					const float t = (rgb[0][i] - mean[0]) * axis[0] + (rgb[1][i] - mean[1]) * axis[1] + (rgb[2][i] - mean[2]) * axis[2];
+					low = std::min(low, t);
+					high = std::max(high, t);
+				}
+				const float axis_length2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+				const float scale = axis_length2 > 0.f ? 1.f / axis_length2 : 0.f;
+				uint16_t c0 = detail::pack_565(mean[0] + axis[0] * high * scale, mean[1] + axis[1] * high * scale, mean[2] + axis[2] * high * scale);
+				uint16_t c1 = detail::pack_565(mean[0] + axis[0] * low * scale, mean[1] + axis[1] * low * scale, mean[2] + axis[2] * low * scale);
+				detail::bc1_order(c0, c1);
+				float palette[4][3];
+				uint8_t indices[16];
+				detail::bc1_palette(c0, c1, palette);
+				const float error = detail::bc1_indices(rgb, palette, indices);
+
+				//least squares endpoints for those indices, texel = a * e0 + b * e1
+				static constexpr float weight[4] = { 1.f, 0.f, 2.f / 3.f, 1.f / 3.f };
+				float aa = 0.f, ab = 0.f, bb = 0.f, ax[3] = {}, bx[3] = {};
+				for (int i = 0; i < 16; i++) {
+					const float a = weight[indices[i]], b = 1.f - a;
+					aa += a * a;
+					ab += a * b;
+					bb += b * b;
+					for (int c = 0; c < 3; c++) {
+						ax[c] += a * rgb[c][i];
+						bx[c] += b * rgb[c][i];
+					}
+				}
+				const float det = aa * bb - ab * ab;
+				if (c0 != c1 && std::abs(det) > 1e-6f) {
+					float e0[3], e1[3];
+					for (int c = 0; c < 3; c++) {
+						e0[c] = (ax[c] * bb - bx[c] * ab) / det;
+						e1[c] = (bx[c] * aa - ax[c] * ab) / det;
+					}
+					uint16_t r0 = detail::pack_565(e0[0], e0[1], e0[2]);
+					uint16_t r1 = detail::pack_565(e1[0], e1[1], e1[2]);
+					detail::bc1_order(r0, r1);
+					if (r0 != r1) {
+						float refined_palette[4][3];
+						uint8_t refined[16];
+						detail::bc1_palette(r0, r1, refined_palette);
+						const float refined_error = detail::bc1_indices(rgb, refined_palette, refined);
+						if (refined_error < error) {
+							c0 = r0;
+							c1 = r1;
+							std::memcpy(indices, refined, 16);
+						}
+					}
+				}
+				if (c0 == c1)
+					std::fill(indices, indices + 16, uint8_t(0)); //3 color mode, only index 0 is safe
+				detail::write_bc1(c0, c1, indices, out);
+			}
+			//one channel of a 4x4 block, 'stride' bytes between texels (4 for a channel of RGBA8)
+			inline void encode_bc4_block(const uint8_t* values, size_t stride, uint8_t out[8]) {
+				uint8_t low = 255, high = 0;
+				for (int i = 0; i < 16; i++) {
+					low = std::min(low, values[i * stride]);
+					high = std::max(high, values[i * stride]);
+				}
+				uint64_t bits = 0;
+				if (high != low) {
+					//8 value mode: 0 = high, 1 = low, 2..7 step from high down to low
+					const float steps = 7.f / (high - low);
+					for (int i = 0; i < 16; i++) {
+						const int step = static_cast<int>((values[i * stride] - low) * steps + 0.5f);
+						const uint64_t index = step == 7 ? 0 : step == 0 ? 1 : uint64_t(8 - step);
+						bits |= index << (3 * i);
+					}
+				}
+				out[0] = high;
+				out[1] = low;
+				for (int b = 0; b < 6; b++)
+					out[2 + b] = static_cast<uint8_t>(bits >> (8 * b));
+			}
+
+			inline void decode_bc1_block(const uint8_t block[8], uint8_t texels[64]) {
+				const uint16_t c0 = static_cast<uint16_t>(block[0] | (block[1] << 8));
+				const uint16_t c1 = static_cast<uint16_t>(block[2] | (block[3] << 8));
+				uint8_t palette[4][4];
+				detail::unpack_565(c0, palette[0]);
+				detail::unpack_565(c1, palette[1]);
+				palette[0][3] = palette[1][3] = palette[2][3] = 255;
+				for (int c = 0; c < 3; c++) {
+					if (c0 > c1) {
+						palette[2][c] = static_cast<uint8_t>((2 * palette[0][c] + palette[1][c]) / 3);
+						palette[3][c] = static_cast<uint8_t>((palette[0][c] + 2 * palette[1][c]) / 3);
+					}
+					else {
+						palette[2][c] = static_cast<uint8_t>((palette[0][c] + palette[1][c]) / 2);
+						palette[3][c] = 0;
+					}
+				}
+				palette[3][3] = c0 > c1 ? 255 : 0;
+				uint32_t bits;
+				std::memcpy(&bits, block + 4, 4);
+				for (int i = 0; i < 16; i++)
+					std::memcpy(texels + i * 4, palette[(bits >> (2 * i)) & 3], 4);
+			}
+			inline void decode_bc4_block(const uint8_t block[8], uint8_t* values, size_t stride) {
+				const int a0 = block[0], a1 = block[1];
+				uint8_t palette[8] = { block[0], block[1] };
+				for (int i = 2; i < 8; i++) {
+					if (a0 > a1)
+						palette[i] = static_cast<uint8_t>(((8 - i) * a0 + (i - 1) * a1) / 7);
+					else
+						palette[i] = i == 6 ? 0 : i == 7 ? 255 : static_cast<uint8_t>(((6 - i) * a0 + (i - 1) * a1) / 5);
+				}
+				uint64_t bits = 0;
+				for (int b = 0; b < 6; b++)
+					bits |= uint64_t(block[2 + b]) << (8 * b);
+				for (int i = 0; i < 16; i++)
+					values[i * stride] = palette[(bits >> (3 * i)) & 7];
+			}
+
+			//whole image, blocks in row major order ready for glCompressedTexSubImage2D
+			inline std::vector<uint8_t> compress(const image_t& image, format_t format, thread_pool_t& pool = thread_pool_t::shared()) {
+				if (!image.valid())
+					throw block_compress_error_t("compressing an empty or truncated image");
+				const uint32_t blocks_x = (image.width + 3) / 4, blocks_y = (image.height + 3) / 4;
+				const size_t bytes = block_bytes(format);
+				std::vector<uint8_t> out(compressed_size(format, image.width, image.height));
+				pool.parallel_ranges(blocks_y, [&](size_t first, size_t last) {
+					uint8_t texels[64];
+					for (size_t by = first; by < last; by++) {
+						for (uint32_t bx = 0; bx < blocks_x; bx++) {
+							for (uint32_t y = 0; y < 4; y++) {
+								const uint32_t sy = std::min(static_cast<uint32_t>(by) * 4 + y, image.height - 1);
+								for (uint32_t x = 0; x < 4; x++)
+									std::memcpy(texels + (y * 4 + x) * 4, image.texel(std::min(bx * 4 + x, image.width - 1), sy), 4);
+							}
+							uint8_t* block = out.data() + (by * blocks_x + bx) * bytes;
+							switch (format) {
+							case format_t::bc1:
+								encode_bc1_block(texels, block);
+								break;
+							case format_t::bc3:
+								encode_bc4_block(texels + 3, 4, block);
+								encode_bc1_block(texels, block + 8);
+								break;
+							case format_t::bc5:
+								encode_bc4_block(texels, 4, block);
+								encode_bc4_block(texels + 1, 4, block + 8);
+								break;
+							}
+						}
+					}
+				});
+				return out;
+			}
+			//back to RGBA8, for checking what compress() lost. BC5 comes back with blue 0 and alpha 255
+			inline image_t decompress(const uint8_t* blocks, format_t format, uint32_t width, uint32_t height) {
+				image_t image;
+				image.width = width;
+				image.height = height;
+				image.pixels.resize(image.size_bytes());
+				const uint32_t blocks_x = (width + 3) / 4, blocks_y = (height + 3) / 4;
+				const size_t bytes = block_bytes(format);
+				uint8_t texels[64];
+				for (uint32_t by = 0; by < blocks_y; by++) {
+					for (uint32_t bx = 0; bx < blocks_x; bx++) {
+						const uint8_t* block = blocks + (size_t(by) * blocks_x + bx) * bytes;
+						switch (format) {
+						case format_t::bc1:
+							decode_bc1_block(block, texels);
+							break;
+						case format_t::bc3:
+							decode_bc1_block(block + 8, texels);
+							decode_bc4_block(block, texels + 3, 4);
+							break;
+						case format_t::bc5:
+							for (int i = 0; i < 16; i++) {
+								texels[i * 4 + 2] = 0;
+								texels[i * 4 + 3] = 255;
+							}
+							decode_bc4_block(block, texels, 4);
+							decode_bc4_block(block + 8, texels + 1, 4);
+							break;
+						}
+						for (uint32_t y = 0; y < 4 && by * 4 + y < height; y++) {
+							for (uint32_t x = 0; x < 4 && bx * 4 + x < width; x++)
+								std::memcpy(image.pixels.data() + ((size_t(by) * 4 + y) * width + bx * 4 + x) * 4, texels + (y * 4 + x) * 4, 4);
+						}
+					}
+				}
+				return image;
+			}
+		}
+	}
+}
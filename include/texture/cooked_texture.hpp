@@ -0,0 +1,178 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "block_compress.hpp"
+#include "image.hpp"
+#include "../graphics/gl/buffer.hpp"
+#include "../graphics/gl/texture.hpp"
+#include "../utility/mapped_file.hpp"
+#include "../utility/thread_pool.hpp"
+namespace foton {
+	namespace texture {
+		namespace filesystem = std::filesystem;
+		/*
+			binary "cooked" textures, the compressed counterpart of model/cooked_mesh.hpp
+
+			a cooked texture is every mip level already block compressed, finest first, each level 64 byte aligned
+			loading one is mapping the file and handing the mapped blocks to glCompressedTexSubImage2D level by level
+			into immutable storage, nothing is decoded or copied on our side
+
+			layout: header_t, level_t[header_t::levels], then the level data at the offsets the table gives
+		*/
+		namespace cooked {
+			static constexpr std::array<char, 4> MAGIC = { 'F', 'C', 'T', 'X' };
+			static constexpr uint32_t VERSION = 1; //bump on ANY layout or encoder change
+			static constexpr uint64_t LEVEL_ALIGNMENT = 64;
+			static constexpr uint32_t MAX_LEVELS = 32;
+			struct header_t {
+				std::array<char, 4> magic = MAGIC;
+				uint32_t version = VERSION;
+				bc::format_t format = bc::format_t::bc1;
+				uint32_t srgb = 0; //the blocks hold sRGB encoded colors, ignored for bc5
+				uint32_t width = 0;
+				uint32_t height = 0;
+				uint32_t levels = 0;
+				uint32_t reserved = 0;
+			};
+			struct level_t {
+				uint32_t width = 0;
+				uint32_t height = 0;
+				uint64_t offset = 0; //in bytes from the start of the file
+				uint64_t size = 0;
+			};
+			static_assert(std::is_trivially_copyable_v<header_t> && std::is_trivially_copyable_v<level_t>);
+			static_assert(sizeof(header_t) % 8 == 0 && sizeof(level_t) % 8 == 0, "no tail padding that changes between compilers");
+
+			struct cooked_texture_error_t : std::runtime_error {
+				cooked_texture_error_t(const filesystem::path& path, const char* what)
+					: std::runtime_error("cooked texture '" + path.string() + "': " + what) {}
+			};
+
+			//the sized internal format glTexStorage2D and glCompressedTexSubImage2D want for 'format'
+			inline GLenum gl_format(bc::format_t format, bool srgb) {
+				switch (format) {
+				case bc::format_t::bc1:
+					return srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+				case bc::format_t::bc3:
+					return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+				case bc::format_t::bc5:
+					return GL_COMPRESSED_RG_RGTC2;
+				}
+				return 0;
+			}
+
+			/*
+				mips 'image' down to 1x1, compresses every level and writes it to 'path'
+
+				goes through a temporary file + rename so a reader never maps a half written file
+			*/
+			inline void write(const filesystem::path& path, image_t image, bc::format_t format, bool srgb,
+				thread_pool_t& pool = thread_pool_t::shared()) {
+				const std::vector<image_t> chain = mip_chain(std::move(image));
+				header_t header;
+				header.format = format;
+				header.srgb = srgb ? 1 : 0;
+				header.width = chain.front().width;
+				header.height = chain.front().height;
+				header.levels = static_cast<uint32_t>(chain.size());
+				std::vector<level_t> levels(chain.size());
+				std::vector<std::vector<uint8_t>> blocks(chain.size());
+				uint64_t end = sizeof(header_t) + sizeof(level_t) * chain.size();
+				for (size_t l = 0; l < chain.size(); l++) {
+					blocks[l] = bc::compress(chain[l], format, pool);
+					end = (end + LEVEL_ALIGNMENT - 1) / LEVEL_ALIGNMENT * LEVEL_ALIGNMENT;
+					levels[l] = level_t{ chain[l].width, chain[l].height, end, blocks[l].size() };
+					end += blocks[l].size();
+				}
+
+				filesystem::path temporary = path;
+				temporary += ".tmp";
+				{
+					std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+					if (!out)
+						throw cooked_texture_error_t(temporary, "unable to open for writing");
+					out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+					out.write(reinterpret_cast<const char*>(levels.data()), static_cast<std::streamsize>(sizeof(level_t) * levels.size()));
+					uint64_t written = sizeof(header_t) + sizeof(level_t) * levels.size();
+					for (size_t l = 0; l < levels.size(); l++) {
+						static constexpr char padding[LEVEL_ALIGNMENT] = {};
+						out.write(padding, static_cast<std::streamsize>(levels[l].offset - written));
+						out.write(reinterpret_cast<const char*>(blocks[l].data()), static_cast<std::streamsize>(levels[l].size));
+						written = levels[l].offset + levels[l].size;
+					}
+					if (!out)
+						throw cooked_texture_error_t(temporary, "write failed");
+				}
+				filesystem::rename(temporary, path);
+			}
+
+			//a mapped cooked texture, level() is a span of blocks straight out of the mapping
+			struct cooked_texture_t {
+				cooked_texture_t() = default;
+				explicit cooked_texture_t(const filesystem::path& path) : _file(path) {
+					if (_file.size() < sizeof(header_t))
+						throw cooked_texture_error_t(path, "too small for a header");
+					std::memcpy(&_header, _file.data(), sizeof(header_t));
+					if (_header.magic != MAGIC)
+						throw cooked_texture_error_t(path, "not a cooked texture");
+					if (_header.version != VERSION)
+						throw cooked_texture_error_t(path, "cooked with a different version");
+					if (_header.format != bc::format_t::bc1 && _header.format != bc::format_t::bc3 && _header.format != bc::format_t::bc5)
+						throw cooked_texture_error_t(path, "unknown block format");
+					if (_header.levels == 0 || _header.levels > MAX_LEVELS
+						|| _file.size() < sizeof(header_t) + sizeof(level_t) * _header.levels)
+						throw cooked_texture_error_t(path, "corrupt level table");
+					_levels.resize(_header.levels);
+					std::memcpy(_levels.data(), _file.data() + sizeof(header_t), sizeof(level_t) * _header.levels);
+					for (uint32_t l = 0; l < _header.levels; l++) {
+						const level_t& level = _levels[l];
+						if (level.width != std::max(_header.width >> l, 1u) || level.height != std::max(_header.height >> l, 1u)
+							|| level.offset % LEVEL_ALIGNMENT != 0 || level.offset + level.size > _file.size()
+							|| level.size != bc::compressed_size(_header.format, level.width, level.height))
+							throw cooked_texture_error_t(path, "corrupt level table");
+					}
+				}
+				const header_t& header() const {
+					return _header;
+				}
+				uint32_t level_count() const {
+					return _header.levels;
+				}
+				const level_t& level_info(uint32_t level) const {
+					return _levels[level];
+				}
+				std::span<const uint8_t> level(uint32_t level) const {
+					const level_t& l = _levels[level];
+					return std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(_file.data() + l.offset), static_cast<size_t>(l.size));
+				}
+				GLenum gl_format() const {
+					return cooked::gl_format(_header.format, _header.srgb != 0);
+				}
+				//immutable storage for every level, then each level's blocks straight from the mapping
+				void upload(GL::texture_t& texture) const {
+					auto bind = texture.bind();
+					bind.allocate_storage(static_cast<GLsizei>(_header.width), static_cast<GLsizei>(_header.height), gl_format(), static_cast<GLsizei>(_header.levels));
+					for (uint32_t l = 0; l < _header.levels; l++) {
+						const std::span<const uint8_t> blocks = level(l);
+						bind.upload_compressed_level(static_cast<GLint>(l), gl_format(), static_cast<GLsizei>(_levels[l].width),
+							static_cast<GLsizei>(_levels[l].height), static_cast<GLsizei>(blocks.size()), blocks.data());
+					}
+					bind.set_filter();
+					GL::check_gl_errors("after cooked_texture_t::upload");
+				}
+			private:
+				mapped_file_t _file;
+				header_t _header;
+				std::vector<level_t> _levels;
+			};
+		}
+	}
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+namespace foton {
+	namespace texture {
+		//tightly packed RGBA8 rows, top row first
+		struct image_t {
+			uint32_t width = 0;
+			uint32_t height = 0;
+			std::vector<uint8_t> pixels;
+			size_t size_bytes() const {
+				return size_t(width) * height * 4;
+			}
+			bool valid() const {
+				return width > 0 && height > 0 && pixels.size() >= size_bytes();
+			}
+			const uint8_t* texel(uint32_t x, uint32_t y) const {
+				return pixels.data() + (size_t(y) * width + x) * 4;
+			}
+		};
+		//levels in a full chain down to 1x1
+		inline uint32_t mip_levels(uint32_t width, uint32_t height) {
+			uint32_t levels = 1;
+			while (width > 1 || height > 1) {
+				width = std::max(width / 2, 1u);
+				height = std::max(height / 2, 1u);
+				levels++;
+			}
+			return levels;
+		}
+		//next level down, 2x2 box filter, odd edges repeat the last texel
+		inline image_t downsample(const image_t& image) {
+			image_t out;
+			out.width = std::max(image.width / 2, 1u);
+			out.height = std::max(image.height / 2, 1u);
+			out.pixels.resize(out.size_bytes());
+			for (uint32_t y = 0; y < out.height; y++) {
+				const uint32_t y0 = std::min(2 * y, image.height - 1), y1 = std::min(2 * y + 1, image.height - 1);
+				for (uint32_t x = 0; x < out.width; x++) {
+					const uint32_t x0 = std::min(2 * x, image.width - 1), x1 = std::min(2 * x + 1, image.width - 1);
+					for (uint32_t c = 0; c < 4; c++) {
+						const uint32_t sum = image.texel(x0, y0)[c] + image.texel(x1, y0)[c] + image.texel(x0, y1)[c] + image.texel(x1, y1)[c];
+						out.pixels[(size_t(y) * out.width + x) * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+					}
+				}
+			}
+			return out;
+		}
+		//'image' followed by every smaller level, finest first like GL
+		inline std::vector<image_t> mip_chain(image_t image) {
+			std::vector<image_t> chain;
+			chain.reserve(mip_levels(image.width, image.height));
+			chain.push_back(std::move(image));
+			while (chain.back().width > 1 || chain.back().height > 1)
+				chain.push_back(downsample(chain.back()));
+			return chain;
+		}
+	}
+}
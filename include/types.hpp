@@ -157,6 +157,7 @@ namespace foton {
 	
 	using vec3f = Eigen::Vector3f;
 	using vec2f = Eigen::Vector2f;
+	using vec4f = Eigen::Vector4f;
 
 	using quatf = Eigen::Quaternionf;
 	using aff3f = Eigen::Affine3f;
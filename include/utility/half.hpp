@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+namespace foton {
+	/*
+		IEEE 754 binary16, storage only (GL_HALF_FLOAT), convert to float to do math, trivial so it can go straight into buffers
+		float -> half rounds to nearest even, overflow goes to infinity, tiny values become denormals
+	*/
+	struct half_t {
+		uint16_t bits;
+		static uint16_t from_float_bits(float value) {
+			uint32_t x;
+			std::memcpy(&x, &value, sizeof(x));
+			const uint16_t sign = static_cast<uint16_t>((x >> 16) & 0x8000);
+			const uint32_t abs = x & 0x7fffffff;
+			if (abs >= 0x7f800000) //inf or nan (keep it a nan)
+				return sign | 0x7c00 | (abs > 0x7f800000 ? 0x200 : 0);
+			if (abs >= 0x477ff000) //rounds past 65504
+				return sign | 0x7c00;
+			if (abs < 0x38800000) { //smaller than the smallest normal half, 2^-14
+				if (abs < 0x33000000) //under half the smallest denormal
+					return sign;
+				const uint32_t mantissa = (abs & 0x7fffff) | 0x800000;
+				const uint32_t shift = 126 - (abs >> 23);
+				uint32_t h = mantissa >> shift;
+				const uint32_t remainder = mantissa & ((1u << shift) - 1);
+				const uint32_t halfway = 1u << (shift - 1);
+				if (remainder > halfway || (remainder == halfway && (h & 1)))
+					h++;
+				return sign | static_cast<uint16_t>(h);
+			}
+			uint32_t h = (abs - 0x38000000) >> 13; //rebias the exponent from 127 to 15
+			const uint32_t remainder = abs & 0x1fff;
+			if (remainder > 0x1000 || (remainder == 0x1000 && (h & 1)))
+				h++;
+			return sign | static_cast<uint16_t>(h);
+		}
+		static float to_float(uint16_t h) {
+			const uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+			const uint32_t exponent = (h >> 10) & 0x1f;
+			const uint32_t mantissa = h & 0x3ff;
+			uint32_t x;
+			if (exponent == 0) {
+				if (mantissa == 0)
+					x = sign;
+				else { //denormal, mantissa * 2^-24
+					const float value = static_cast<float>(mantissa) * (1.f / 16777216.f);
+					std::memcpy(&x, &value, sizeof(x));
+					x |= sign;
+				}
+			}
+			else if (exponent == 31)
+				x = sign | 0x7f800000 | (mantissa << 13);
+			else
+				x = sign | ((exponent + 112) << 23) | (mantissa << 13);
+			float out;
+			std::memcpy(&out, &x, sizeof(out));
+			return out;
+		}
+		half_t() = default;
+		explicit half_t(float value) : bits(from_float_bits(value)) {}
+		explicit operator float() const {
+			return to_float(bits);
+		}
+	};
+	static_assert(sizeof(half_t) == 2);
+}
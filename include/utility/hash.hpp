@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+namespace foton {
+	/*
+		non cryptographic 64 bit hashing for cache keys and hash tables
+
+		NOT stable across versions of foton, anything that stores these on disk should also store a format version
+	*/
+	namespace hash {
+		inline uint64_t mix(uint64_t h) {
+			//splitmix64 finalizer
+			h ^= h >> 30;
+			h *= 0xbf58476d1ce4e5b9ull;
+			h ^= h >> 27;
+			h *= 0x94d049bb133111ebull;
+			h ^= h >> 31;
+			return h;
+		}
+		inline uint64_t combine(uint64_t seed, uint64_t value) {
+			return mix(seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2)));
+		}
+		inline uint64_t rotl(uint64_t x, int r) {
+			return (x << r) | (x >> (64 - r));
+		}
+		//4 independent lanes of 8 bytes so the multiplies pipeline, a few GB/s which is plenty next to disk reads
+		inline uint64_t bytes(const void* data, size_t size, uint64_t seed = 0) {
+			static constexpr uint64_t prime = 0x9e3779b97f4a7c15ull;
+			const unsigned char* it = static_cast<const unsigned char*>(data);
+			const uint64_t start = mix(seed ^ size);
+			uint64_t lanes[4] = { start, start ^ 0x243f6a8885a308d3ull, start ^ 0x13198a2e03707344ull, start ^ 0xa4093822299f31d0ull };
+			auto read64 = [](const unsigned char* p) {
+				uint64_t word;
+				std::memcpy(&word, p, sizeof(word));
+				return word;
+			};
+			for (; size >= 32; size -= 32, it += 32) {
+				for (int lane = 0; lane < 4; lane++)
+					lanes[lane] = rotl(lanes[lane] ^ (read64(it + lane * 8) * prime), 31) * prime;
+			}
+			uint64_t h = lanes[0];
+			for (int lane = 1; lane < 4; lane++)
+				h = combine(h, lanes[lane]);
+			for (; size >= 8; size -= 8, it += 8)
+				h = combine(h, read64(it));
+			uint64_t tail = 0;
+			std::memcpy(&tail, it, size);
+			return combine(h, tail);
+		}
+		inline uint64_t string(std::string_view text, uint64_t seed = 0) {
+			return bytes(text.data(), text.size(), seed);
+		}
+	}
+}
@@ -0,0 +1,141 @@
+#pragma once
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <filesystem>
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+namespace foton {
+	/*
+		read only view of a whole file through the OS page cache
+
+		nothing gets copied into our memory, pages get faulted in as they get touched
+		so parsers can walk the file as one big char buffer
+	*/
+	struct mapped_file_t {
+		struct mapping_error_t : std::runtime_error {
+			mapping_error_t(const std::filesystem::path& path, const char* what)
+				: std::runtime_error("unable to map '" + path.string() + "': " + what) {}
+		};
+		mapped_file_t() = default;
+		mapped_file_t(const std::filesystem::path& path) {
+#ifdef _WIN32
+			_file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+				FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+			if (_file == INVALID_HANDLE_VALUE)
+				throw mapping_error_t(path, "CreateFileW failed");
+			LARGE_INTEGER file_size = {};
+			if (!GetFileSizeEx(_file, &file_size)) {
+				close();
+				throw mapping_error_t(path, "GetFileSizeEx failed");
+			}
+			_size = static_cast<size_t>(file_size.QuadPart);
+			if (_size == 0) //can't map an empty file, but an empty view is fine
+				return;
+			_mapping = CreateFileMappingW(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (_mapping == nullptr) {
+				close();
+				throw mapping_error_t(path, "CreateFileMappingW failed");
+			}
+			_data = static_cast<const char*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+			_file = ::open(path.c_str(), O_RDONLY);
+			if (_file == -1)
+				throw mapping_error_t(path, "open failed");
+			struct stat file_stat = {};
+			if (::fstat(_file, &file_stat) != 0) {
+				close();
+				throw mapping_error_t(path, "fstat failed");
+			}
+			_size = static_cast<size_t>(file_stat.st_size);
+			if (_size == 0)
+				return;
+			void* ptr = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _file, 0);
+			_data = ptr == MAP_FAILED ? nullptr : static_cast<const char*>(ptr);
+			if (_data)
+				::madvise(ptr, _size, MADV_SEQUENTIAL);
+#endif
+			if (_data == nullptr) {
+				close();
+				throw mapping_error_t(path, "unable to map view of file");
+			}
+		}
+		mapped_file_t(const mapped_file_t&) = delete;
+		mapped_file_t& operator=(const mapped_file_t&) = delete;
+		mapped_file_t(mapped_file_t&& other) noexcept {
+			*this = std::move(other);
+		}
+		mapped_file_t& operator=(mapped_file_t&& other) noexcept {
+			if (this == &other)
+				return *this;
+			close();
+			std::swap(_data, other._data);
+			std::swap(_size, other._size);
+			std::swap(_file, other._file);
+#ifdef _WIN32
+			std::swap(_mapping, other._mapping);
+#endif
+			return *this;
+		}
+		~mapped_file_t() {
+			close();
+		}
+		const char* data() const {
+			return _data;
+		}
+		const std::byte* bytes() const {
+			return reinterpret_cast<const std::byte*>(_data);
+		}
+		size_t size() const {
+			return _size;
+		}
+		bool empty() const {
+			return size() == 0;
+		}
+		std::string_view view() const {
+			return std::string_view(_data, _size);
+		}
+		void close() {
+#ifdef _WIN32
+			if (_data)
+				UnmapViewOfFile(_data);
+			if (_mapping)
+				CloseHandle(_mapping);
+			if (_file != INVALID_HANDLE_VALUE)
+				CloseHandle(_file);
+			_mapping = nullptr;
+			_file = INVALID_HANDLE_VALUE;
+#else
+			if (_data)
+				::munmap(const_cast<char*>(_data), _size);
+			if (_file != -1)
+				::close(_file);
+			_file = -1;
+#endif
+			_data = nullptr;
+			_size = 0;
+		}
+	private:
+		const char* _data = nullptr;
+		size_t _size = 0;
+#ifdef _WIN32
+		HANDLE _file = INVALID_HANDLE_VALUE;
+		HANDLE _mapping = nullptr;
+#else
+		int _file = -1;
+#endif
+	};
+}
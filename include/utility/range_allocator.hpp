@@ -0,0 +1,80 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+namespace foton {
+	/*
+		hands out [offset, offset + size) ranges of a fixed capacity, no memory of its own (GPU buffer suballocation)
+
+		free ranges are kept sorted by offset, allocate() is first fit, free() merges with the neighbours
+		so a freed range can be handed out again whole
+	*/
+	struct range_allocator_t {
+		static constexpr uint32_t INVALID = static_cast<uint32_t>(-1);
+		explicit range_allocator_t(uint32_t capacity = 0) : _capacity(capacity) {
+			if (capacity > 0)
+				_free.push_back(range_t{ 0, capacity });
+		}
+		//offset of 'size' free units, INVALID when no free range is big enough
+		uint32_t allocate(uint32_t size) {
+			if (size == 0)
+				return INVALID;
+			for (size_t i = 0; i < _free.size(); i++) {
+				range_t& range = _free[i];
+				if (range.size < size)
+					continue;
+				const uint32_t offset = range.offset;
+				range.offset += size;
+				range.size -= size;
+				if (range.size == 0)
+					_free.erase(_free.begin() + i);
+				_used += size;
+				return offset;
+			}
+			return INVALID;
+		}
+		void free(uint32_t offset, uint32_t size) {
+			if (offset == INVALID || size == 0)
+				return;
+			auto next = std::lower_bound(_free.begin(), _free.end(), offset, [](const range_t& r, uint32_t o) {
+				return r.offset < o;
+			});
+			const bool joins_previous = next != _free.begin() && std::prev(next)->offset + std::prev(next)->size == offset;
+			const bool joins_next = next != _free.end() && offset + size == next->offset;
+			if (joins_previous && joins_next) {
+				std::prev(next)->size += size + next->size;
+				_free.erase(next);
+			}
+			else if (joins_previous)
+				std::prev(next)->size += size;
+			else if (joins_next) {
+				next->offset = offset;
+				next->size += size;
+			}
+			else
+				_free.insert(next, range_t{ offset, size });
+			_used -= size;
+		}
+		uint32_t capacity() const {
+			return _capacity;
+		}
+		uint32_t used() const {
+			return _used;
+		}
+		//biggest single allocation that would still succeed
+		uint32_t largest_free() const {
+			uint32_t out = 0;
+			for (const range_t& r : _free)
+				out = std::max(out, r.size);
+			return out;
+		}
+	private:
+		struct range_t {
+			uint32_t offset;
+			uint32_t size;
+		};
+		std::vector<range_t> _free;
+		uint32_t _capacity;
+		uint32_t _used = 0;
+	};
+}
@@ -0,0 +1,147 @@
+#pragma once
+#include <atomic>
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "../mutex.hpp"
+namespace foton {
+	/*
+		fixed set of worker threads for splitting CPU work (parsing, culling, etc) across cores
+
+		parallel_for blocks until every index is done and the calling thread helps out,
+		so it is fine to call from the render loop. only one parallel_for runs at a time,
+		a parallel_for from inside a task (on a worker or the calling thread) just runs inline instead of deadlocking
+		every call gets its own job_t, a worker that wakes up late holds on to the job it saw and finds it used up,
+		it can't take indices from the next call
+	*/
+	struct thread_pool_t {
+		static size_t default_thread_count() {
+			const size_t hardware = std::thread::hardware_concurrency();
+			return hardware > 1 ? hardware - 1 : 0; //the caller is the last thread
+		}
+		explicit thread_pool_t(size_t worker_count = default_thread_count()) {
+			_workers.reserve(worker_count);
+			for (size_t i = 0; i < worker_count; i++)
+				_workers.emplace_back([this] { worker_loop(); });
+		}
+		thread_pool_t(const thread_pool_t&) = delete;
+		thread_pool_t& operator=(const thread_pool_t&) = delete;
+		~thread_pool_t() {
+			{
+				std::lock_guard<mutex_t> lock(_mutex);
+				_stopping = true;
+			}
+			_wake.notify_all();
+			for (std::thread& worker : _workers)
+				worker.join();
+		}
+		//worker threads + the calling thread
+		size_t thread_count() const {
+			return _workers.size() + 1;
+		}
+		//calls func(i) for every i in [0, count)
+		template<class F>
+		void parallel_for(size_t count, F&& func) {
+			if (count == 0)
+				return;
+			if (count == 1 || _workers.empty() || _inside_worker()) {
+				for (size_t i = 0; i < count; i++)
+					func(i);
+				return;
+			}
+			std::lock_guard<mutex_t> submit_lock(_submit_mutex);
+			std::function<void(size_t)> task = std::ref(func);
+			const std::shared_ptr<job_t> job = std::make_shared<job_t>(&task, count);
+			{
+				std::lock_guard<mutex_t> lock(_mutex);
+				_job = job;
+				_generation++;
+			}
+			_wake.notify_all();
+			const bool was_inside = _inside_worker();
+			_inside_worker() = true; //tasks run here too, a nested parallel_for from one would wait on _submit_mutex forever
+			run_tasks(*job);
+			_inside_worker() = was_inside;
+			std::unique_lock<mutex_t> lock(_mutex);
+			_done.wait(lock, [&] { return job->finished == job->count; });
+			_job = nullptr;
+			if (job->error)
+				std::rethrow_exception(job->error);
+		}
+		//calls func(begin, end) over [0, count) split into roughly even ranges, one per thread
+		template<class F>
+		void parallel_ranges(size_t count, F&& func) {
+			const size_t ranges = std::min(count, thread_count());
+			parallel_for(ranges, [&](size_t r) {
+				func(count * r / ranges, count * (r + 1) / ranges);
+			});
+		}
+		static thread_pool_t& shared() {
+			static thread_pool_t pool;
+			return pool;
+		}
+	private:
+		static bool& _inside_worker() {
+			static thread_local bool inside = false;
+			return inside;
+		}
+		//one parallel_for call, 'task' is only touched while an index below 'count' is left
+		struct job_t {
+			job_t(std::function<void(size_t)>* task, size_t count) : task(task), count(count) {}
+			std::function<void(size_t)>* const task;
+			const size_t count;
+			std::atomic<size_t> next = 0;
+			size_t finished = 0; //under _mutex
+			std::exception_ptr error; //under _mutex
+		};
+		void run_tasks(job_t& job) {
+			size_t finished = 0;
+			for (size_t i = job.next.fetch_add(1); i < job.count; i = job.next.fetch_add(1)) {
+				try {
+					(*job.task)(i);
+				}
+				catch (...) {
+					std::lock_guard<mutex_t> lock(_mutex);
+					if (!job.error)
+						job.error = std::current_exception();
+				}
+				finished++;
+			}
+			if (finished == 0)
+				return;
+			std::lock_guard<mutex_t> lock(_mutex);
+			job.finished += finished;
+			if (job.finished == job.count)
+				_done.notify_all();
+		}
+		void worker_loop() {
+			_inside_worker() = true;
+			size_t seen_generation = 0;
+			for (;;) {
+				std::shared_ptr<job_t> job;
+				{
+					std::unique_lock<mutex_t> lock(_mutex);
+					_wake.wait(lock, [&] { return _stopping || (_generation != seen_generation && _job); });
+					if (_stopping)
+						return;
+					seen_generation = _generation;
+					job = _job;
+				}
+				run_tasks(*job);
+			}
+		}
+		std::vector<std::thread> _workers;
+		mutex_t _submit_mutex;
+		mutex_t _mutex;
+		std::condition_variable _wake;
+		std::condition_variable _done;
+		std::shared_ptr<job_t> _job; //the running call, nullptr between calls
+		size_t _generation = 0;
+		bool _stopping = false;
+	};
+}
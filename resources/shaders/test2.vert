@@ -1,7 +1,12 @@
 #version 400
 in vec3 vp;
 out vec3 vc;
-uniform float time;
+layout(std140) uniform frame_block {
+    mat4 view_mat;
+    mat4 projection_mat;
+    mat4 view_projection_mat;
+    float time;
+};
 uniform mat4 trans;
 const float PI = 3.1415926535897932384626433832795;
 void main()
@@ -0,0 +1,49 @@
+// mesh_report.cpp : prints post transform cache stats (ACMR/ATVR) for OBJ files before and after cooking
+//
+// not part of Foton.vcxproj (it has its own main), build it on its own with the same include path, eg:
+//   cl /std:c++latest /O2 /EHsc /I include /I packages\Eigen.3.3.3\build\native\include tools\mesh_report.cpp
+// usage: mesh_report [--cache-size N] model.obj [more.obj ...]
+
+#include "model/optimize.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+int main(int argc, char** argv) {
+	using namespace foton::model;
+	size_t cache_size = optimize::DEFAULT_CACHE_SIZE;
+	int first_path = 1;
+	if (argc > 2 && std::strcmp(argv[1], "--cache-size") == 0) {
+		cache_size = static_cast<size_t>(std::strtoul(argv[2], nullptr, 10));
+		first_path = 3;
+	}
+	if (first_path >= argc || cache_size == 0) {
+		std::cerr << "usage: " << argv[0] << " [--cache-size N] model.obj [more.obj ...]\n";
+		return 1;
+	}
+	std::cout << std::fixed << std::setprecision(3);
+	int failed = 0;
+	for (int i = first_path; i < argc; i++) {
+		try {
+			model_t model = OBJ_model_t::from_path(argv[i]).make_model();
+			const optimize::vertex_cache_stats_t before = optimize::analyze_vertex_cache(model.indices, model.vertices.size(), cache_size);
+			const auto start = std::chrono::steady_clock::now();
+			optimize::options_t options;
+			options.cache_size = cache_size;
+			optimize::optimize_model(model, options);
+			const auto took = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+			const optimize::vertex_cache_stats_t after = optimize::analyze_vertex_cache(model.indices, model.vertices.size(), cache_size);
+			std::cout << argv[i] << ": " << before.triangles << " triangles, " << after.vertices << " vertices, cache " << cache_size << '\n'
+				<< "  acmr " << before.acmr() << " -> " << after.acmr() << '\n'
+				<< "  atvr " << before.atvr() << " -> " << after.atvr() << '\n'
+				<< "  optimize took " << took.count() << "ms\n";
+		}
+		catch (const std::exception& e) {
+			std::cerr << argv[i] << ": " << e.what() << '\n';
+			failed++;
+		}
+	}
+	return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,201 @@
+// obj_bench.cpp : OBJ load throughput in MB/s, the old istream reader against obj::parse and obj::parse_parallel
+//
+// not part of Foton.vcxproj (it has its own main), build it on its own with the same include path, eg:
+//   cl /std:c++latest /O2 /EHsc /I include /I packages\Eigen.3.3.3\build\native\include tools\obj_bench.cpp
+// usage: obj_bench [--runs N] model.obj [more.obj ...]
+//        obj_bench [--runs N] --generate TRIANGLES out.obj   (writes a v/vt/vn grid with about that many triangles first)
+// every path gets parsed 'runs' times per loader and the best run is reported, the file is read from the page cache after the first
+
+#include "model.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <streambuf>
+
+namespace {
+	using namespace foton;
+	using model::multiindex_model_t;
+	using corner_t = multiindex_model_t::multiindex_face_t::vertex_indices_t;
+	/*
+		the OBJ_model_t(std::istream&) reader user-001 replaced, kept here only to compare against
+		operator>> per token, a std::string per opcode and a push_back per record, indices made 0 based like obj::parse
+	*/
+	std::istream& read_corner(std::istream& in, corner_t& out) {
+		out = { 0, multiindex_model_t::MISSING_INDEX, multiindex_model_t::MISSING_INDEX };
+		in >> out.vertex_i;
+		out.vertex_i--;
+		if (in.peek() != '/')
+			return in;
+		in.get();
+		if (in.peek() != '/') {
+			in >> out.texture_coords_i;
+			out.texture_coords_i--;
+		}
+		if (in.peek() != '/')
+			return in;
+		in.get();
+		in >> out.normals_i;
+		out.normals_i--;
+		return in;
+	}
+	void istream_parse(std::istream& in, multiindex_model_t& out) {
+		std::string operation;
+		auto pass = [&] {
+			in.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+		};
+		while (in >> operation) {
+			if (operation == "v") {
+				float x, y, z;
+				in >> x >> y >> z;
+				out.vertices.emplace_back(x, y, z);
+			}
+			else if (operation == "vt") {
+				float u, v;
+				in >> u >> v;
+				out.texture_coords.emplace_back(u, v);
+			}
+			else if (operation == "vn") {
+				float x, y, z;
+				in >> x >> y >> z;
+				out.normals.emplace_back(x, y, z);
+			}
+			else if (operation == "f") {
+				multiindex_model_t::multiindex_face_t face;
+				read_corner(in, face.v1);
+				read_corner(in, face.v2);
+				read_corner(in, face.v3);
+				out.faces.push_back(face);
+			}
+			else
+				pass();
+		}
+	}
+	//a side x side grid of quads split into triangles, every record type present
+	void generate(const char* path, size_t triangles) {
+		const size_t side = std::max<size_t>(1, static_cast<size_t>(std::sqrt(static_cast<double>(triangles) / 2.0)));
+		std::ofstream out(path, std::ios::binary);
+		if (!out)
+			throw std::runtime_error(std::string("can't write ") + path);
+		out << std::setprecision(6) << std::fixed << "o generated\n";
+		for (size_t y = 0; y <= side; y++) {
+			for (size_t x = 0; x <= side; x++) {
+				const float fx = static_cast<float>(x) / side, fy = static_cast<float>(y) / side;
+				out << "v " << fx << ' ' << fy << ' ' << std::sin(fx * 6.f) * std::cos(fy * 6.f) << '\n'
+					<< "vt " << fx << ' ' << fy << '\n'
+					<< "vn 0.000000 0.000000 1.000000\n";
+			}
+		}
+		auto corner = [&](size_t x, size_t y) {
+			const size_t i = y * (side + 1) + x + 1;
+			out << ' ' << i << '/' << i << '/' << i;
+		};
+		for (size_t y = 0; y < side; y++) {
+			for (size_t x = 0; x < side; x++) {
+				out << 'f';
+				corner(x, y), corner(x + 1, y), corner(x + 1, y + 1);
+				out << "\nf";
+				corner(x, y), corner(x + 1, y + 1), corner(x, y + 1);
+				out << '\n';
+			}
+		}
+	}
+	//istream over the mapped text without copying it
+	struct view_buffer_t : std::streambuf {
+		explicit view_buffer_t(std::string_view text) {
+			char* begin = const_cast<char*>(text.data());
+			setg(begin, begin, begin + text.size());
+		}
+	};
+	bool same(const multiindex_model_t& a, const multiindex_model_t& b) {
+		auto same_corner = [](const corner_t& x, const corner_t& y) {
+			return x.vertex_i == y.vertex_i && x.texture_coords_i == y.texture_coords_i && x.normals_i == y.normals_i;
+		};
+		if (a.vertices != b.vertices || a.texture_coords != b.texture_coords || a.normals != b.normals || a.faces.size() != b.faces.size())
+			return false;
+		for (size_t i = 0; i < a.faces.size(); i++) {
+			if (!same_corner(a.faces[i].v1, b.faces[i].v1) || !same_corner(a.faces[i].v2, b.faces[i].v2) || !same_corner(a.faces[i].v3, b.faces[i].v3))
+				return false;
+		}
+		return true;
+	}
+}
+
+int main(int argc, char** argv) {
+	int runs = 3;
+	int first_path = 1;
+	if (argc > 2 && std::strcmp(argv[1], "--runs") == 0) {
+		runs = std::max(1, std::atoi(argv[2]));
+		first_path = 3;
+	}
+	if (argc - first_path == 3 && std::strcmp(argv[first_path], "--generate") == 0) {
+		const size_t triangles = static_cast<size_t>(std::strtoull(argv[first_path + 1], nullptr, 10));
+		try {
+			generate(argv[first_path + 2], triangles);
+		}
+		catch (const std::exception& e) {
+			std::cerr << e.what() << '\n';
+			return 1;
+		}
+		first_path += 2;
+	}
+	if (first_path >= argc) {
+		std::cerr << "usage: " << argv[0] << " [--runs N] model.obj [more.obj ...]\n"
+			<< "       " << argv[0] << " [--runs N] --generate TRIANGLES out.obj\n";
+		return 1;
+	}
+	std::cout << std::fixed << std::setprecision(1);
+	int failed = 0;
+	for (int i = first_path; i < argc; i++) {
+		try {
+			const mapped_file_t file(argv[i]);
+			const std::string_view text = file.view();
+			const double megabytes = static_cast<double>(text.size()) / (1024.0 * 1024.0);
+			multiindex_model_t reference;
+			bool have_reference = false;
+			//best of 'runs', a fresh model every run so reserve/grow costs count
+			auto time = [&](const char* name, auto&& load) {
+				double best = std::numeric_limits<double>::infinity();
+				for (int run = 0; run < runs; run++) {
+					multiindex_model_t model;
+					const auto start = std::chrono::steady_clock::now();
+					load(model);
+					best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+					if (run != 0)
+						continue;
+					if (!have_reference) {
+						reference = std::move(model);
+						have_reference = true;
+					}
+					else if (!same(reference, model))
+						std::cout << "  " << name << " output differs from the istream reader's\n";
+				}
+				std::cout << "  " << std::left << std::setw(16) << name << std::right << std::setw(9) << megabytes / best << " MB/s "
+					<< std::setw(9) << best * 1000.0 << "ms\n";
+				return best;
+			};
+			std::cout << argv[i] << ": " << std::setprecision(2) << megabytes << std::setprecision(1) << " MB\n";
+			const double old_time = time("istream", [&](multiindex_model_t& model) {
+				view_buffer_t buffer(text); //the old path read an ifstream, reading the mapping keeps the disk out of it
+				std::istream in(&buffer);
+				istream_parse(in, model);
+			});
+			const double serial_time = time("parse", [&](multiindex_model_t& model) {
+				model::obj::parse(text, model);
+			});
+			const double parallel_time = time("parse_parallel", [&](multiindex_model_t& model) {
+				model::obj::parse_parallel(text, model);
+			});
+			std::cout << "  " << reference.vertices.size() << " vertices, " << reference.faces.size() << " triangles, speedup "
+				<< old_time / serial_time << "x serial, " << old_time / parallel_time << "x on " << thread_pool_t::shared().thread_count() << " threads\n";
+		}
+		catch (const std::exception& e) {
+			std::cerr << argv[i] << ": " << e.what() << '\n';
+			failed++;
+		}
+	}
+	return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,135 @@
+// texture_cooker.cpp : mips and block compresses images into cooked textures (.fctx, see texture/cooked_texture.hpp)
+//
+// not part of Foton.vcxproj (it has its own main), build it on its own with the same include path, eg:
+//   cl /std:c++latest /O2 /EHsc /I include /I packages\Eigen.3.3.3\build\native\include tools\texture_cooker.cpp glew32.lib opengl32.lib
+// usage: texture_cooker [--bc1|--bc3|--bc5] [--linear] image.ppm|image.pam [more ...]
+// the tree has no image decoder yet, so sources are binary PPM (P6, RGB) or PAM (P7, RGB or RGB_ALPHA), 8 bits per channel
+// writes next to each source with the extension swapped for .fctx and prints the level 0 error
+
+#include "texture/cooked_texture.hpp"
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+	using foton::texture::image_t;
+	//netpbm header token, skipping whitespace and # comments
+	std::string token(std::istream& in) {
+		std::string out;
+		while (in) {
+			const int c = in.get();
+			if (c == '#') {
+				std::string comment;
+				std::getline(in, comment);
+			}
+			else if (std::isspace(c) || c == EOF) {
+				if (!out.empty())
+					break;
+			}
+			else
+				out += static_cast<char>(c);
+		}
+		return out;
+	}
+	image_t read_netpbm(const std::filesystem::path& path) {
+		std::ifstream in(path, std::ios::binary);
+		if (!in)
+			throw std::runtime_error("unable to open");
+		const std::string magic = token(in);
+		image_t image;
+		uint32_t channels = 3, max_value = 0;
+		if (magic == "P6") {
+			image.width = std::stoul(token(in));
+			image.height = std::stoul(token(in));
+			max_value = std::stoul(token(in));
+		}
+		else if (magic == "P7") {
+			for (std::string key = token(in); key != "ENDHDR"; key = token(in)) {
+				if (!in)
+					throw std::runtime_error("truncated PAM header");
+				const std::string value = token(in); //every header line is KEY value, TUPLTYPE is implied by DEPTH
+				if (key == "WIDTH")
+					image.width = std::stoul(value);
+				else if (key == "HEIGHT")
+					image.height = std::stoul(value);
+				else if (key == "DEPTH")
+					channels = std::stoul(value);
+				else if (key == "MAXVAL")
+					max_value = std::stoul(value);
+			}
+		}
+		else
+			throw std::runtime_error("not a binary PPM (P6) or PAM (P7)");
+		if (max_value != 255 || (channels != 3 && channels != 4) || image.width == 0 || image.height == 0)
+			throw std::runtime_error("only 8 bit RGB or RGBA images are supported");
+		std::vector<uint8_t> raw(size_t(image.width) * image.height * channels);
+		in.read(reinterpret_cast<char*>(raw.data()), static_cast<std::streamsize>(raw.size()));
+		if (!in)
+			throw std::runtime_error("truncated pixel data");
+		image.pixels.resize(image.size_bytes());
+		for (size_t i = 0; i < size_t(image.width) * image.height; i++) {
+			for (uint32_t c = 0; c < 4; c++)
+				image.pixels[i * 4 + c] = c < channels ? raw[i * channels + c] : 255;
+		}
+		return image;
+	}
+}
+
+int main(int argc, char** argv) {
+	using namespace foton::texture;
+	bc::format_t format = bc::format_t::bc1;
+	bool srgb = true;
+	int first_path = 1;
+	for (; first_path < argc && argv[first_path][0] == '-'; first_path++) {
+		if (std::strcmp(argv[first_path], "--bc1") == 0)
+			format = bc::format_t::bc1;
+		else if (std::strcmp(argv[first_path], "--bc3") == 0)
+			format = bc::format_t::bc3;
+		else if (std::strcmp(argv[first_path], "--bc5") == 0)
+			format = bc::format_t::bc5;
+		else if (std::strcmp(argv[first_path], "--linear") == 0)
+			srgb = false;
+		else
+			break;
+	}
+	if (first_path >= argc) {
+		std::cerr << "usage: " << argv[0] << " [--bc1|--bc3|--bc5] [--linear] image.ppm|image.pam [more ...]\n";
+		return 1;
+	}
+	const int channels = format == bc::format_t::bc5 ? 2 : format == bc::format_t::bc3 ? 4 : 3;
+	std::cout << std::fixed << std::setprecision(3);
+	int failed = 0;
+	for (int i = first_path; i < argc; i++) {
+		try {
+			const image_t image = read_netpbm(argv[i]);
+			std::filesystem::path out = argv[i];
+			out.replace_extension(".fctx");
+			const auto start = std::chrono::steady_clock::now();
+			cooked::write(out, image, format, srgb);
+			const auto took = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+			const cooked::cooked_texture_t cooked(out);
+			const image_t decoded = bc::decompress(cooked.level(0).data(), format, image.width, image.height);
+			double error = 0.0;
+			for (size_t p = 0; p < image.pixels.size(); p += 4) {
+				for (int c = 0; c < channels; c++) {
+					const double d = double(image.pixels[p + c]) - decoded.pixels[p + c];
+					error += d * d;
+				}
+			}
+			const double rmse = std::sqrt(error / (double(image.pixels.size() / 4) * channels));
+			std::cout << argv[i] << " -> " << out.string() << ": " << image.width << 'x' << image.height << ", "
+				<< cooked.level_count() << " levels, " << std::filesystem::file_size(out) << " bytes\n"
+				<< "  level 0 rmse " << rmse << ", cooked in " << took.count() << "ms\n";
+		}
+		catch (const std::exception& e) {
+			std::cerr << argv[i] << ": " << e.what() << '\n';
+			failed++;
+		}
+	}
+	return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,128 @@
+// weld_bench.cpp : make_model time across mesh sizes for every weld_mode_t, against the old linear search on the small ones
+//
+// not part of Foton.vcxproj (it has its own main), build it on its own with the same include path, eg:
+//   cl /std:c++latest /O2 /EHsc /I include /I packages\Eigen.3.3.3\build\native\include tools\weld_bench.cpp
+// usage: weld_bench [--max TRIANGLES] [--linear-max TRIANGLES]
+// sweeps 1K, 10K, 100K, ... triangles up to --max (default 10M), the linear search only runs up to --linear-max (default 20K), it's O(n^2)
+// meshes are in memory grids with v/vt/vn per grid point, so every mode welds the same corners
+
+#include "model.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+namespace {
+	using namespace foton;
+	using model::multiindex_model_t;
+	using model::model_t;
+	//about 'triangles' triangles over a side x side grid
+	multiindex_model_t grid(size_t triangles) {
+		const size_t side = std::max<size_t>(1, static_cast<size_t>(std::sqrt(static_cast<double>(triangles) / 2.0)));
+		multiindex_model_t out;
+		const size_t points = (side + 1) * (side + 1);
+		out.vertices.reserve(points);
+		out.texture_coords.reserve(points);
+		out.normals.reserve(points);
+		for (size_t y = 0; y <= side; y++) {
+			for (size_t x = 0; x <= side; x++) {
+				const float fx = static_cast<float>(x) / side, fy = static_cast<float>(y) / side;
+				out.vertices.emplace_back(fx, fy, std::sin(fx * 6.f) * std::cos(fy * 6.f));
+				out.texture_coords.emplace_back(fx, fy);
+				out.normals.emplace_back(0.f, 0.f, 1.f);
+			}
+		}
+		auto corner = [&](size_t x, size_t y) {
+			const size_t i = y * (side + 1) + x;
+			return multiindex_model_t::multiindex_face_t::vertex_indices_t{ i, i, i };
+		};
+		out.faces.reserve(side * side * 2);
+		for (size_t y = 0; y < side; y++) {
+			for (size_t x = 0; x < side; x++) {
+				out.faces.push_back({ corner(x, y), corner(x + 1, y), corner(x + 1, y + 1) });
+				out.faces.push_back({ corner(x, y), corner(x + 1, y + 1), corner(x, y + 1) });
+			}
+		}
+		return out;
+	}
+	//the find_similar_vertex scan make_model used before user-002, kept here only to compare against
+	model_t linear_make_model(const multiindex_model_t& in) {
+		model_t out;
+		auto process = [&](const multiindex_model_t::multiindex_face_t::vertex_indices_t& v) {
+			const vec3f& position = in.vertices[v.vertex_i];
+			const vec2f uv = in.texture_coord_at(v.texture_coords_i);
+			const vec3f normal = in.normal_at(v.normals_i);
+			for (uint32_t i = 0; i < out.vertices.size(); i++) {
+				if (out.vertices[i] == position && out.texture_coords[i] == uv && out.normals[i] == normal) {
+					out.indices.push_back(i);
+					return;
+				}
+			}
+			out.vertices.push_back(position);
+			out.texture_coords.push_back(uv);
+			out.normals.push_back(normal);
+			out.indices.push_back(static_cast<uint32_t>(out.vertices.size() - 1));
+		};
+		for (const auto& face : in.faces) {
+			process(face.v1);
+			process(face.v2);
+			process(face.v3);
+		}
+		return out;
+	}
+	template<class F>
+	double milliseconds(F&& f) {
+		const auto start = std::chrono::steady_clock::now();
+		f();
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+int main(int argc, char** argv) {
+	size_t max_triangles = 10'000'000;
+	size_t linear_max = 20'000;
+	for (int i = 1; i + 1 < argc; i += 2) {
+		if (std::strcmp(argv[i], "--max") == 0)
+			max_triangles = static_cast<size_t>(std::strtoull(argv[i + 1], nullptr, 10));
+		else if (std::strcmp(argv[i], "--linear-max") == 0)
+			linear_max = static_cast<size_t>(std::strtoull(argv[i + 1], nullptr, 10));
+		else {
+			std::cerr << "usage: " << argv[0] << " [--max TRIANGLES] [--linear-max TRIANGLES]\n";
+			return 1;
+		}
+	}
+	std::cout << std::fixed << std::setprecision(2)
+		<< std::setw(10) << "triangles" << std::setw(10) << "vertices" << std::setw(12) << "indices" << std::setw(12) << "exact"
+		<< std::setw(12) << "epsilon" << std::setw(12) << "linear" << std::setw(14) << "ns/corner" << '\n';
+	int mismatches = 0;
+	for (size_t triangles = 1000; triangles <= max_triangles; triangles *= 10) {
+		multiindex_model_t mesh = grid(triangles);
+		model_t by_indices, by_exact, by_epsilon;
+		model::weld_options_t options;
+		options.mode = model::weld_mode_t::indices;
+		const double indices_time = milliseconds([&] { by_indices = mesh.make_model(options); });
+		options.mode = model::weld_mode_t::exact;
+		const double exact_time = milliseconds([&] { by_exact = mesh.make_model(options); });
+		options.mode = model::weld_mode_t::epsilon;
+		const double epsilon_time = milliseconds([&] { by_epsilon = mesh.make_model(options); });
+		if (by_indices.indices != by_exact.indices || by_epsilon.indices != by_exact.indices)
+			mismatches++;
+		std::cout << std::setw(10) << mesh.faces.size() << std::setw(10) << by_exact.vertices.size()
+			<< std::setw(10) << indices_time << "ms" << std::setw(10) << exact_time << "ms" << std::setw(10) << epsilon_time << "ms";
+		if (mesh.faces.size() <= linear_max) {
+			model_t by_scan;
+			const double linear_time = milliseconds([&] { by_scan = linear_make_model(mesh); });
+			if (by_scan.indices != by_exact.indices || by_scan.vertices != by_exact.vertices)
+				mismatches++;
+			std::cout << std::setw(10) << linear_time << "ms";
+		}
+		else
+			std::cout << std::setw(12) << "-";
+		std::cout << std::setw(14) << exact_time * 1e6 / static_cast<double>(mesh.faces.size() * 3) << '\n';
+	}
+	if (mismatches != 0)
+		std::cout << mismatches << " sizes welded differently between modes\n";
+	return mismatches == 0 ? 0 : 1;
+}